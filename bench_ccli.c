@@ -0,0 +1,270 @@
+// micro-benchmarks for ccli's hot paths.
+//
+// ccli.c is included directly, so its static helpers can be timed
+// without building a whole command line around them.
+#include "ccli.c"
+
+#include <time.h>
+#include <inttypes.h>
+#include <sys/wait.h>
+#include <regex.h>
+
+#define BENCH_ROUNDS 2000000
+
+static volatile double double_sink;
+static volatile uint64_t integer_sink;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, double elapsed, long ops) {
+  printf("  %-34s %8.2f ns/op\n", name, elapsed / ops);
+}
+
+/******************** numeric parsing ********************/
+
+static char *integers[] = {
+  "0", "7", "42", "1024", "65535", "1234567", "4294967296",
+  "9007199254740993", "1311768467463790320", "18446744073709551615"
+};
+#define INTEGER_COUNT ((int)(sizeof(integers) / sizeof(integers[0])))
+
+static void bench_numbers() {
+  printf("numeric parsing (%d values):\n", INTEGER_COUNT);
+
+  double start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    char *value = integers[round % INTEGER_COUNT];
+    if (is_number(value)) double_sink = strtod(value, NULL);
+  }
+  report("is_number + strtod (old)", now_ns() - start, BENCH_ROUNDS);
+
+  start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    double number;
+    if (parse_number(integers[round % INTEGER_COUNT], &number)) double_sink = number;
+  }
+  report("parse_number", now_ns() - start, BENCH_ROUNDS);
+
+  start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    uint64_t number;
+    if (!parse_uint64(integers[round % INTEGER_COUNT], CCLI_UNIT_NONE, &number)) integer_sink = number;
+  }
+  report("parse_uint64", now_ns() - start, BENCH_ROUNDS);
+
+  start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    uint64_t number;
+    if (!parse_uint64("2GiB", CCLI_UNIT_BYTES, &number)) integer_sink = number;
+  }
+  report("parse_uint64 '2GiB'", now_ns() - start, BENCH_ROUNDS);
+
+  // precision check: the old path can't hold 2^53 + 1
+  uint64_t exact = 0;
+  parse_uint64("9007199254740993", CCLI_UNIT_NONE, &exact);
+  printf("  2^53 + 1 -> old: %.0f, parse_uint64: %" PRIu64 "\n\n", strtod("9007199254740993", NULL), exact);
+}
+
+/******************** async output ********************/
+
+#define ASYNC_LINES 200000
+#define ASYNC_BURSTS 200
+
+// a reader that takes 16 KiB per millisecond, like a slow pipe consumer
+static pid_t slow_reader(int fds[2]) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    char chunk[16 * 1024];
+    close(fds[1]);
+    while (read(fds[0], chunk, sizeof(chunk)) > 0) usleep(1000);
+    _exit(0);
+  }
+  return pid;
+}
+
+static void bench_async_run(const char *name, bool async) {
+  int fds[2];
+  if (pipe(fds) != 0) return;
+  pid_t reader = slow_reader(fds);
+  close(fds[0]);
+
+  FILE *fp = fdopen(fds[1], "w");
+  ccli *interface = ccli_init("bench", 0, NULL);
+  ccli_set_output_stream(interface, fp);
+  if (async) ccli_set_async_output(interface, CCLI_BACKPRESSURE_GROW, 0);
+
+  double start = now_ns();
+  for (int i = 0; i < ASYNC_LINES; i++) {
+    ccli_echo(interface, "line %d of the slow reader benchmark", i);
+  }
+  double callback = now_ns() - start;
+
+  ccli_free(interface);
+  fclose(fp);
+  double total = now_ns() - start;
+  waitpid(reader, NULL, 0);
+
+  printf("  %-34s %8.2f ms callback, %8.2f ms total\n", name, callback / 1e6, total / 1e6);
+}
+
+static void bench_async() {
+  printf("echo to a throttled pipe (%d lines):\n", ASYNC_LINES);
+  bench_async_run("synchronous", false);
+  bench_async_run("async, grow", true);
+  printf("\n");
+}
+
+// a line, then a burst that fills a small ring while the writer is
+// lingering over the line. this used to leave the writer waiting for
+// room with the producer's lock held, under grow and drop.
+static void bench_async_burst(const char *name, ccli_backpressure policy) {
+  static char chunk[4096];
+  memset(chunk, 'x', sizeof(chunk) - 1);
+
+  FILE *fp = fopen("/dev/null", "w");
+  ccli *interface = ccli_init("bench", 0, NULL);
+  ccli_set_output_stream(interface, fp);
+  ccli_set_async_output(interface, policy, 64 * 1024);
+
+  double start = now_ns();
+  for (int round = 0; round < ASYNC_BURSTS; round++) {
+    ccli_echo(interface, "first line");
+    usleep(300);
+    for (int i = 0; i < 50; i++) ccli_echo(interface, "%s", chunk);
+  }
+  ccli_free(interface);
+  fclose(fp);
+
+  report(name, now_ns() - start, ASYNC_BURSTS);
+}
+
+static void bench_async_bursts() {
+  printf("bursts into a 64 KiB ring (%d bursts of 200 KiB):\n", ASYNC_BURSTS);
+  bench_async_burst("block", CCLI_BACKPRESSURE_BLOCK);
+  bench_async_burst("grow", CCLI_BACKPRESSURE_GROW);
+  bench_async_burst("drop", CCLI_BACKPRESSURE_DROP);
+  printf("\n");
+}
+
+/******************** typed writes ********************/
+
+#define WRITE_LINES 2000000
+
+static void bench_writes() {
+  printf("formatting lines to /dev/null (%d lines):\n", WRITE_LINES);
+  FILE *fp = fopen("/dev/null", "w");
+  ccli *interface = ccli_init("bench", 0, NULL);
+  ccli_set_output_stream(interface, fp);
+
+  double start = now_ns();
+  for (int i = 0; i < WRITE_LINES; i++) {
+    ccli_echo(interface, "%s: %d", "item", i);
+  }
+  report("ccli_echo \"%s: %d\"", now_ns() - start, WRITE_LINES);
+
+  start = now_ns();
+  for (int i = 0; i < WRITE_LINES; i++) {
+    ccli_write_str(interface, "item: ");
+    ccli_write_i64(interface, i);
+    ccli_write_str(interface, "\n");
+  }
+  report("ccli_write_str + ccli_write_i64", now_ns() - start, WRITE_LINES);
+
+  start = now_ns();
+  for (int i = 0; i < WRITE_LINES; i++) {
+    ccli_echo(interface, "%llx", (unsigned long long)i * 0x9e3779b97f4a7c15ull);
+  }
+  report("ccli_echo \"%llx\"", now_ns() - start, WRITE_LINES);
+
+  start = now_ns();
+  for (int i = 0; i < WRITE_LINES; i++) {
+    ccli_write_u64_hex(interface, i * 0x9e3779b97f4a7c15ull);
+    ccli_write_str(interface, "\n");
+  }
+  report("ccli_write_u64_hex", now_ns() - start, WRITE_LINES);
+
+  // %.17g is what printf needs to round trip every double
+  start = now_ns();
+  for (int i = 0; i < WRITE_LINES; i++) {
+    ccli_echo(interface, "%.17g", i / 8.0);
+  }
+  report("ccli_echo \"%.17g\"", now_ns() - start, WRITE_LINES);
+
+  start = now_ns();
+  for (int i = 0; i < WRITE_LINES; i++) {
+    ccli_write_f64(interface, i / 8.0);
+    ccli_write_str(interface, "\n");
+  }
+  report("ccli_write_f64", now_ns() - start, WRITE_LINES);
+
+  ccli_free(interface);
+  fclose(fp);
+  printf("\n");
+}
+
+/******************** value patterns ********************/
+
+#define PATTERN_SOURCE "[a-z][a-z0-9-]{2,62}"
+
+static char *pattern_values[] = {
+  "logs", "my-bucket-2024", "a", "Uppercase", "backups-eu-west-1-primary-replica",
+  "x1", "build-artifacts", "tmp_files", "release-candidate-builds-for-the-q3-train", "ok-",
+};
+#define PATTERN_VALUE_COUNT ((int)(sizeof(pattern_values) / sizeof(pattern_values[0])))
+
+static void bench_patterns() {
+  printf("matching '%s' (%d values):\n", PATTERN_SOURCE, PATTERN_VALUE_COUNT);
+
+  double start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS / 100; round++) {
+    regex_t regex;
+    regcomp(&regex, "^(" PATTERN_SOURCE ")$", REG_EXTENDED | REG_NOSUB);
+    integer_sink += regexec(&regex, pattern_values[round % PATTERN_VALUE_COUNT], 0, NULL, 0);
+    regfree(&regex);
+  }
+  report("regcomp + regexec", now_ns() - start, BENCH_ROUNDS / 100);
+
+  regex_t regex;
+  regcomp(&regex, "^(" PATTERN_SOURCE ")$", REG_EXTENDED | REG_NOSUB);
+  start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    integer_sink += regexec(&regex, pattern_values[round % PATTERN_VALUE_COUNT], 0, NULL, 0);
+  }
+  report("regexec", now_ns() - start, BENCH_ROUNDS);
+
+  const char *reason;
+  start = now_ns();
+  value_pattern *pattern = value_pattern_compile(PATTERN_SOURCE, &reason);
+  double compile = now_ns() - start;
+
+  start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    integer_sink += value_pattern_match(pattern, pattern_values[round % PATTERN_VALUE_COUNT]);
+  }
+  report("value_pattern_match", now_ns() - start, BENCH_ROUNDS);
+
+  // both have to agree on every value
+  int disagreements = 0;
+  for (int i = 0; i < PATTERN_VALUE_COUNT; i++) {
+    bool matched = !regexec(&regex, pattern_values[i], 0, NULL, 0);
+    if (matched != value_pattern_match(pattern, pattern_values[i])) disagreements++;
+  }
+  printf("  compiled once in %.1f us, %d columns, %d disagreements with regexec\n\n",
+         compile / 1000, pattern->column_count, disagreements);
+
+  value_pattern_free(pattern);
+  regfree(&regex);
+}
+
+int main(int argc, char **argv) {
+  bench_numbers();
+  bench_patterns();
+  bench_writes();
+  bench_async();
+  bench_async_bursts();
+  return 0;
+}
@@ -1,1195 +1,7487 @@
-#include <stdarg.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <string.h>
-
-#include "ccli.h"
-
-//TODO:
-// - command groups (like Click) for subcommands
-// - global options
-
-
-// POSSIBLE FEATURES:
-// - prompt user for input on arguments/options
-
-#define GROW_ARRAY_CAPACITY(cap) ((cap == 0) ? 8 : (cap) * 2)
-
-/******************** printing ********************/
-
-static void start_color_print(ccli_color color) {
-  // print color escape sequence
-  switch (color) {
-    case COLOR_RED:     printf("\033[0;31m"); break;
-    case COLOR_GREEN:   printf("\033[0;32m"); break;
-    case COLOR_YELLOW:  printf("\033[0;33m"); break;
-    case COLOR_BLUE:    printf("\033[0;34m"); break;
-    case COLOR_MAGENTA: printf("\033[0;35m"); break;
-    case COLOR_CYAN:    printf("\033[0;36m"); break;
-    default:
-      printf("invalid color code -> %d\n", color); return;
-  }
-}
-
-static void reset_color_print() {
-  printf("\033[0m");
-}
-
-static void print_color_va_args(const char *format, va_list args, ccli_color color) {
-  start_color_print(color);
-  vprintf(format, args);
-  reset_color_print();
-}
-
-static void _error(const char *func, const char *format, ...) {
-  va_list args;
-  va_start(args, format);
-  fprintf(stderr, "[ %s ] -> Error: ", func);
-  vfprintf(stderr, format, args);
-  fputc('\n', stderr);
-  va_end(args);
-  exit(1);
-}
-
-#define error(format, args...) (_error(__FUNCTION__, format, ## args))
-
-/******************** ccli_iterator ********************/
-
-typedef struct ccli_iterator {
-  void *value;
-  struct ccli_iterator *next;
-} ccli_iterator;
-
-ccli_iterator *ccli_iterator_new() {
-  ccli_iterator *iterator = malloc(sizeof(ccli_iterator));
-  iterator->value = NULL;
-  iterator->next = NULL;
-  return iterator;
-}
-
-// NOTE: using a macro here to make type-cast more readable.
-// if we expose the opaque iterator object publicly, this won't
-// work.
-#define ccli_iterator_get(iter, type) ((type)iter->value)
-
-// the iterator passed to this function should most likely be NULL.
-// if not, its value will be replaced with the given value.
-//
-// Remember to maintain a pointer to the head of the iterator
-// before using this function.
-static ccli_iterator *ccli_iterator_add(ccli_iterator *iterator, void *value) {
-  if (!iterator) return NULL;
-
-  iterator->value = value;
-  iterator->next = ccli_iterator_new();
-  return iterator->next;
-}
-
-// return true if there's another iteration
-static ccli_iterator *ccli_iterator_next(ccli_iterator *iterator) {
-  if (!iterator) return NULL;
-
-  return iterator->next;
-}
-
-static bool ccli_iterator_done(ccli_iterator *iterator) {
-  if (!iterator || !iterator->value)  {
-    free(iterator);
-    return true;
-  }
-
-  return false;
-}
-
-/******************** ccli_value ********************/
-
-typedef enum {
-  VAL_NULL,
-  VAL_NUM,
-  VAL_BOOL,
-  VAL_STRING
-} ccli_value_type;
-
-typedef struct {
-  ccli_value_type type;
-  union {
-    double number;
-    bool boolean;
-    char *string;
-  } as;
-} ccli_value;
-
-#define NULL_VAL          ((ccli_value){ VAL_NULL,   { .number = 0 } })
-#define BOOL_VAL(value)   ((ccli_value){ VAL_BOOL,   { .boolean = value } })
-#define NUM_VAL(value)    ((ccli_value){ VAL_NUM,    { .number = (double)value } })
-#define STRING_VAL(value) ((ccli_value){ VAL_STRING, { .string = value }})
-
-#define IS_NULL(value)    ((value).type == VAL_NULL)
-#define IS_NUM(value)     ((value).type == VAL_NUM)
-#define IS_BOOL(value)    ((value).type == VAL_BOOL)
-#define IS_STRING(value)  ((value).type == VAL_STRING)
-
-#define AS_INT(value)     ((int)((value).as.number))
-#define AS_DOUBLE(value)  ((value).as.number)
-#define AS_BOOL(value)    ((value).as.boolean)
-#define AS_STRING(value)  ((value).as.string)
-
-/******************** ccli_arg ********************/
-
-struct ccli_arg {
-  char *name;
-  char *description;
-  ccli_value_type type;
-  ccli_value value;
-};
-
-static ccli_arg *ccli_arg_new(char *name, ccli_value_type type) {
-  ccli_arg *arg = malloc(sizeof(ccli_arg));
-  arg->name = name;
-  arg->description = NULL;
-  arg->type = type;
-  arg->value = NULL_VAL;
-  return arg;
-}
-
-// might need this helper later, rather than just a wrapper
-// around a free call
-static void ccli_arg_free(ccli_arg *arg) {
-  free(arg);
-}
-
-void ccli_arg_set_description(ccli_arg *arg, char *description) {
-    arg->description = description;
-}
-
-/******************** arg_array ********************/
-
-typedef struct {
-  int size;
-  int capacity;
-  ccli_arg **args;
-} arg_array;
-
-static void arg_array_init(arg_array *array) {
-  array->size = 0;
-  array->capacity = 0;
-  array->args = NULL;
-}
-
-static void arg_array_free(arg_array *array) {
-  for (int i = 0; i < array->size; i++) {
-    ccli_arg_free(array->args[i]);
-  }
-
-  free(array->args);
-
-  arg_array_init(array);
-}
-
-static void arg_array_add(arg_array *array, ccli_arg *arg) {
-  if (array->size + 1 > array->capacity) {
-    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
-    array->args = realloc(array->args, sizeof(ccli_arg *) * array->capacity);
-  }
-
-  array->args[array->size++] = arg;
-}
-
-/******************** ccli_option ********************/
-
-struct ccli_option {
-  char *long_option;
-  char *short_option;
-  char *description;
-  ccli_value_type type;
-  ccli_value value;
-};
-
-static ccli_option *ccli_option_new(char *double_dash_option, char *single_dash_option, ccli_value_type type) {
-  ccli_option *option = malloc(sizeof(ccli_option));
-  option->long_option = double_dash_option;
-  option->short_option = single_dash_option;
-  option->description = NULL;
-  option->type = type;
-  option->value = NULL_VAL;
-  return option;
-}
-
-void ccli_option_set_description(ccli_option *option, char *description) {
-  option->description = description;
-}
-
-// functions to set default values
-
-void ccli_option_set_default_number(ccli_option *option, double value) {
-  if (option->type != VAL_NUM) {
-    error("can't set default number on a non-number type.");
-  }
-
-  option->value = NUM_VAL(value);
-}
-
-void ccli_option_set_default_bool(ccli_option *option, bool value) {
-  if (option->type != VAL_BOOL) {
-    error("can't set default bool on a non-bool type.");
-  }
-
-  option->value = BOOL_VAL(value);
-}
-
-void ccli_option_set_default_string(ccli_option *option, char *value) {
-  if (option->type != VAL_STRING) {
-    error("can't set default string on a non-string type");
-  }
-
-  option->value = STRING_VAL(value);
-}
-
-/******************** ccli_table ********************/
-
-// tuning
-#define TABLE_MAX_LOAD 0.75
-
-typedef struct {
-  char *chars;
-  uint32_t hash;
-} table_string;
-
-uint32_t hash_string(const char *key) {
-  uint32_t hash = 2166136261u;
-
-  for (int i = 0; i < strlen(key); i++) {
-    hash ^= key[i];
-    hash *= 16777619;
-  }
-
-  return hash;
-}
-
-table_string *table_string_new(char *chars) {
-  table_string *string = malloc(sizeof(table_string));
-  string->chars = chars;
-  string->hash = hash_string(chars);
-  return string;
-}
-
-typedef struct {
-  table_string *key;
-  ccli_option *option;
-} table_entry;
-
-typedef struct {
-  table_entry *entries;
-  int count;
-  int capacity;
-} ccli_table;
-
-void ccli_table_init(ccli_table *table) {
-  table->capacity = 0;
-  table->count = 0;
-  table->entries = NULL;
-}
-
-void ccli_table_free(ccli_table *table) {
-  for (int i = 0; i < table->capacity; i++) {
-    table_string *string = table->entries[i].key;
-    ccli_option *option = table->entries[i].option;
-    if (string) free(string);
-    if (option) free(option);
-  }
-
-  free(table->entries);
-  ccli_table_init(table);
-}
-
-// find an entry or its respective spot in the table
-static table_entry *ccli_table_find_entry(table_entry *entries, int capacity, table_string *key) {
-  if (!entries) return NULL;
-
-  uint32_t index = key->hash % capacity;
-  table_entry *tombstone = NULL;
-
-  for (;;) {
-    table_entry *entry = &entries[index];
-
-    if (!entry->key) {
-      if (!entry->option) {
-        // empty entry, return tombstone entry if found
-        return (tombstone != NULL) ? tombstone : entry;
-      } else {
-        // found a tombstone
-        if (!tombstone) tombstone = entry;
-      }
-    } else if (entry->key == key) {
-      // found the key
-      return entry;
-    }
-
-    index = (index + 1) % capacity;
-  }
-}
-
-static void ccli_table_adjust_capacity(ccli_table *table, int capacity) {
-  table_entry *entries = malloc(sizeof(table_entry) * capacity);
-  for (int i = 0; i < capacity; i++) {
-    entries[i].key = NULL;
-    entries[i].option = NULL;
-  }
-
-  // don't copy over tombstones, reset and reconstruct the table
-  table->count = 0;
-  for (int i = 0; i < table->capacity; i++) {
-    table_entry *entry = &table->entries[i];
-
-    // disregard tombstones and empty slots
-    if (!entry->key) continue;
-
-    table_entry *dest = ccli_table_find_entry(entries, capacity, entry->key);
-    dest->key = entry->key;
-    dest->option = entry->option;
-    table->count++;
-  }
-
-  free(table->entries);
-
-  table->entries = entries;
-  table->capacity = capacity;
-}
-
-bool ccli_table_get(ccli_table *table, table_string *key, ccli_option **option) {
-  if (!table->entries) return false;
-
-  table_entry *entry = ccli_table_find_entry(table->entries, table->capacity, key);
-  if (!entry->key) return false;
-
-  *option = entry->option;
-  return true;
-}
-
-static bool ccli_table_set(ccli_table *table, table_string *key, ccli_option *option) {
-  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-    int capacity = GROW_ARRAY_CAPACITY(table->capacity);
-    ccli_table_adjust_capacity(table, capacity);
-  }
-
-  table_entry *entry = ccli_table_find_entry(table->entries, table->capacity, key);
-
-  bool isNewKey = (entry->key == NULL);
-  // increment count if it isn't a real value or a tombstone
-  if (isNewKey && !entry->option) table->count++;
-
-  entry->key = key;
-  entry->option = option;
-  return isNewKey;
-}
-
-static ccli_iterator *ccli_table_values(ccli_table *table) {
-  ccli_iterator *head = ccli_iterator_new();
-  table_entry *entry = table->entries;
-
-  ccli_iterator *iter = head;
-  for (int i = 0; i < table->capacity; i++) {
-    if (entry[i].key) {
-      iter = ccli_iterator_add(iter, entry[i].option);
-    }
-  }
-
-  if (!head->value) {
-    free(head); return NULL;
-  }
-
-  return head;
-}
-
-static table_string *ccli_table_find_string(ccli_table *table, const char *chars) {
-  if (!table->entries) return NULL;
-
-  uint32_t hash = hash_string(chars);
-
-  uint32_t index = hash % table->capacity;
-
-  for (;;) {
-    table_entry *entry = &table->entries[index];
-    if (!entry->key) {
-      // stop if we find an empty, non-tombstone entry
-      if (!entry->option) return NULL;
-    } else if (!strcmp(entry->key->chars, chars)) {
-      return entry->key;
-    }
-
-    index = (index + 1) % table->capacity;
-  }
-}
-
-bool ccli_table_exists(ccli_table *table, char *name) {
-  ccli_option *option = NULL;
-  table_string *string = ccli_table_find_string(table, name);
-  if (string && ccli_table_get(table, string, &option)) {
-    if (!IS_NULL(option->value)) return true;
-  }
-
-  return false;
-}
-
-bool ccli_table_get_int(ccli_table *table, char *name, int *value) {
-  ccli_option *option = NULL;
-  table_string *string = ccli_table_find_string(table, name);
-  if (string && ccli_table_get(table, string, &option)) {
-    if (IS_NUM(option->value)) {
-      *value = AS_INT(option->value);
-      return true;
-    }
-  }
-
-  return false;
-}
-
-bool ccli_table_get_double(ccli_table *table, char *name, double *value) {
-  ccli_option *option = NULL;
-  table_string *string = ccli_table_find_string(table, name);
-  if (string && ccli_table_get(table, string, &option)) {
-    if (IS_NUM(option->value)) {
-      *value = AS_DOUBLE(option->value);
-      return true;
-    }
-  }
-
-  return false;
-}
-
-bool ccli_table_get_bool(ccli_table *table, char *name, bool *value) {
-  ccli_option *option = NULL;
-  table_string *string = ccli_table_find_string(table, name);
-  if (string && ccli_table_get(table, string, &option)) {
-    if (IS_BOOL(option->value)) {
-      *value = AS_BOOL(option->value);
-      return true;
-    }
-  }
-
-  return false;
-}
-
-bool ccli_table_get_string(ccli_table *table, char *name, char **value) {
-  ccli_option *option = NULL;
-  table_string *string = ccli_table_find_string(table, name);
-  if (string && ccli_table_get(table, string, &option)) {
-    if (IS_STRING(option->value)) {
-      *value = AS_STRING(option->value);
-      return true;
-    }
-  }
-
-  return false;
-}
-
-/******************** ccli_command ********************/
-
-struct ccli_command {
-  char *command;
-  char *description;
-  ccli_command_callback callback;
-  ccli_table options;
-  arg_array args;
-};
-
-static ccli_command *ccli_command_new(char *command, ccli_command_callback callback) {
-  ccli_command *_command = malloc(sizeof(ccli_command));
-  _command->command = command;
-  _command->description = NULL;
-  _command->callback = callback;
-  ccli_table_init(&_command->options);
-  arg_array_init(&_command->args);
-  return _command;
-}
-
-static void ccli_command_free(ccli_command *command) {
-  ccli_table_free(&command->options);
-  arg_array_free(&command->args);
-  free(command);
-}
-
-void ccli_command_set_description(ccli_command *command, char *description) {
-  command->description = description;
-}
-
-ccli_arg *ccli_command_add_number_arg(ccli_command *command, char *name) {
-  ccli_arg *arg = ccli_arg_new(name, VAL_NUM);
-  arg_array_add(&command->args, arg);
-  return arg;
-}
-
-ccli_arg *ccli_command_add_bool_arg(ccli_command *command, char *name) {
-  ccli_arg *arg = ccli_arg_new(name, VAL_BOOL);
-  arg_array_add(&command->args, arg);
-  return arg;
-}
-
-ccli_arg *ccli_command_add_string_arg(ccli_command *command, char *name) {
-  ccli_arg *arg = ccli_arg_new(name, VAL_STRING);
-  arg_array_add(&command->args, arg);
-  return arg;
-}
-
-ccli_option *ccli_command_add_option(ccli_command *command, char *double_dash_option,
-                             char *single_dash_option, ccli_value_type type) {
-  // TODO: implement global options
-  // TODO: allow single dash options on their own, too
-  if (!command || !double_dash_option) return NULL;
-
-  ccli_option *option = ccli_option_new(double_dash_option, single_dash_option, type);
-
-  table_string *string = ccli_table_find_string(&command->options, double_dash_option);
-  ccli_table_set(&command->options, (string) ? string : table_string_new(double_dash_option), option);
-
-  if (single_dash_option) {
-    string = ccli_table_find_string(&command->options, single_dash_option);
-    ccli_table_set(&command->options, (string) ? string : table_string_new(single_dash_option), option);
-  }
-
-  return option;
-}
-
-//TODO: global options
-ccli_option *ccli_add_number_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option) {
-  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_NUM);
-}
-
-ccli_option *ccli_add_bool_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option) {
-  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_BOOL);
-}
-
-ccli_option *ccli_add_string_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option) {
-  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_STRING);
-}
-
-ccli_option *ccli_add_empty_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option) {
-  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_NULL);
-}
-
-/********** command_array **********/
-
-typedef struct {
-  int size;
-  int capacity;
-  ccli_command **commands;
-} command_array;
-
-static void command_array_init(command_array *array) {
-  array->size = 0;
-  array->capacity = 0;
-  array->commands = NULL;
-}
-
-static void command_array_free(command_array *array) {
-  for (int i = 0; i < array->size; i++) {
-    ccli_command_free(array->commands[i]);
-  }
-
-  free(array->commands);
-
-  command_array_init(array);
-}
-
-static void command_array_add(command_array *array, ccli_command *command) {
-  if (array->size + 1 > array->capacity) {
-    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
-    array->commands = realloc(array->commands, sizeof(ccli_command *) * array->capacity);
-  }
-
-  array->commands[array->size++] = command;
-}
-
-/******************** command_hierarchy ********************/
-
-typedef struct command_hierarchy {
-  ccli_command *command;
-  struct command_hierarchy *next;
-  struct command_hierarchy *prev;
-} command_hierarchy;
-
-static command_hierarchy *command_hierarchy_new(ccli_command *command) {
-  command_hierarchy *hierarchy = malloc(sizeof(command_hierarchy));
-  hierarchy->command = command;
-  hierarchy->next = NULL;
-  hierarchy->prev = NULL;
-  return hierarchy;
-}
-
-// free the current pointer and everything before it
-static void command_hierarchy_free(command_hierarchy *hierarchy) {
-  if (!hierarchy) return;
-
-  command_hierarchy *prev = hierarchy->prev;
-  free(hierarchy);
-  command_hierarchy_free(prev);
-}
-
-static command_hierarchy *
-command_hierarchy_add(command_hierarchy *hierarchy, ccli_command *command) {
-  hierarchy->next = command_hierarchy_new(command);
-  hierarchy->next->prev = hierarchy;
-  return hierarchy->next;
-}
-
-/******************** ccli - main interface ********************/
-
-struct ccli {
-  char *exeName;
-  int argc;
-  int current_arg;
-  char **argv;
-  char *description;
-  FILE *fp;
-  command_array commands;
-  ccli_command *invoked_command;
-};
-
-ccli *ccli_init(char *exeName, int argc, char **argv) {
-  ccli *interface = malloc(sizeof(ccli));
-  interface->exeName = exeName;
-  interface->argc = argc;
-  interface->current_arg = 1;
-  interface->argv = argv;
-  interface->description = NULL;
-  interface->fp = stdout;
-
-  interface->invoked_command = NULL;
-  command_array_init(&interface->commands);
-  return interface;
-}
-
-void ccli_free(ccli *interface) {
-  command_array_free(&interface->commands);
-  free(interface);
-}
-
-void ccli_set_output_stream(ccli *interface, FILE *fp) {
-  interface->fp = fp;
-}
-
-void ccli_set_description(ccli *interface, char *description) {
-  interface->description = description;
-}
-
-/******************** ccli option retrieval ********************/
-
-bool ccli_option_exists(ccli *interface, char *option) {
-  if (!interface->invoked_command) return false;
-
-  return ccli_table_exists(&interface->invoked_command->options, option);
-}
-
-bool ccli_get_int_option(ccli *interface, char *option, int *value) {
-  if (!interface->invoked_command) return false;
-
-  return ccli_table_get_int(&interface->invoked_command->options, option, value);
-}
-
-bool ccli_get_double_option(ccli *interface, char *option, double *value) {
-  if (!interface->invoked_command) return false;
-
-  return ccli_table_get_double(&interface->invoked_command->options, option, value);
-}
-
-bool ccli_get_bool_option(ccli *interface, char *option, bool *value) {
-  if (!interface->invoked_command) return false;
-
-  return ccli_table_get_bool(&interface->invoked_command->options, option, value);
-}
-
-bool ccli_get_string_option(ccli *interface, char *option, char **value) {
-  if (!interface->invoked_command) return false;
-
-  return ccli_table_get_string(&interface->invoked_command->options, option, value);
-}
-
-/******************** ccli print utilities ********************/
-
-void ccli_print(ccli *interface, const char *format, ...) {
-  va_list args;
-  va_start(args, format);
-  vfprintf(interface->fp, format, args);
-  va_end(args);
-}
-
-void ccli_print_color(ccli *interface, ccli_color color, const char *format, ...) {
-  va_list args;
-  va_start(args, format);
-
-  if (interface->fp != stdout) {
-    vfprintf(interface->fp, format, args);
-    va_end(args);
-    return;
-  }
-
-  print_color_va_args(format, args, color);
-  va_end(args);
-}
-
-// print a line to the filestream and append a newline
-void ccli_echo(ccli *interface, const char *format, ...) {
-  va_list args;
-  va_start(args, format);
-  vfprintf(interface->fp, format, args);
-  va_end(args);
-  fputc('\n', interface->fp);
-}
-
-/**
- * @brief
- *  print a line to the terminal in color, and append a newline.
- *  short-circuit to no color codes if the given file stream is not stdout
- *
- * @param interface
- * @param color
- * @param format
- * @param ...
- */
-void ccli_echo_color(ccli *interface, ccli_color color, const char *format, ...) {
-  va_list args;
-  va_start(args, format);
-
-
-  if (interface->fp != stdout) {
-    vfprintf(interface->fp, format, args);
-    va_end(args);
-    fputc('\n', interface->fp);
-    return;
-  }
-
-  print_color_va_args(format, args, color);
-  va_end(args);
-  fputc('\n', interface->fp);
-}
-
-#define ccli_runtime_error(interface, format, args...)      \
-  do {                                                      \
-    ccli_print_color(interface, COLOR_RED, "Error: ");      \
-    ccli_echo_color(interface, COLOR_RED, format, ## args); \
-    exit(1);                                                \
-  } while (false)
-
-static void ccli_option_display(ccli *interface, ccli_option *option) {
-  // must supply a long (--double-dash) option
-  ccli_print_color(interface, COLOR_YELLOW, "  %s", option->long_option);
-
-  /*
-  if (option->short_option) {
-    ccli_print_color(interface, COLOR_YELLOW, ", %s", option->short_option);
-  }
-  */
-
-  switch (option->type) {
-    case VAL_NULL:   break;
-    case VAL_NUM:    ccli_print_color(interface, COLOR_CYAN, "=NUMBER"); break;
-    case VAL_BOOL:   ccli_print_color(interface, COLOR_CYAN, "=BOOLEAN"); break;
-    case VAL_STRING: ccli_print_color(interface, COLOR_CYAN, "=STRING"); break;
-    default:
-      ccli_option_display(interface, option);
-      ccli_runtime_error(interface, "invalid value type: '%d'.", option->type);
-  }
-
-  if (option->description) {
-    ccli_print_color(interface, COLOR_YELLOW, " -> %s\n", option->description);
-  }
-
-  ccli_print(interface, "\n");
-}
-
-static void ccli_display_options(ccli *interface, ccli_command *command) {
-  ccli_iterator *values = ccli_table_values(&command->options);
-
-  if (!values) return;
-
-  ccli_echo_color(interface, COLOR_YELLOW, "Options:");
-
-  for (; !ccli_iterator_done(values); values = ccli_iterator_next(values)) {
-    ccli_option *option = ccli_iterator_get(values, ccli_option *);
-    ccli_option_display(interface, option);
-  }
-
-  ccli_print(interface, "\n");
-}
-
-static void ccli_arg_display(ccli *interface, ccli_arg *arg) {
-  ccli_print_color(interface, COLOR_YELLOW, "  %s", arg->name);
-
-  switch(arg->type) {
-    case VAL_NUM: ccli_print_color(interface, COLOR_CYAN, " (NUMBER)"); break;
-    case VAL_BOOL: ccli_print_color(interface, COLOR_CYAN, " (BOOLEAN)"); break;
-    case VAL_STRING: ccli_print_color(interface, COLOR_CYAN, " (STRING)"); break;
-    default:
-      // Unreachable
-      ccli_runtime_error(interface, "unrecognized value type: '%d'.", arg->type);
-
-  }
-
-  if (arg->description) {
-    ccli_print_color(interface, COLOR_YELLOW, " -> %s", arg->description);
-  }
-
-  ccli_print(interface, "\n");
-}
-
-static void ccli_display_args(ccli *interface, ccli_command *command) {
-  arg_array *array = &command->args;
-
-  if (array->size <= 0) return;
-
-  ccli_echo_color(interface, COLOR_YELLOW, "Arguments:");
-  for (int i = 0; i < array->size; i++) {
-    ccli_print_color(interface, COLOR_YELLOW, "  %d.", i);
-    ccli_arg_display(interface, array->args[0]);
-  }
-
-  ccli_print(interface, "\n");
-}
-
-static void ccli_detailed_command_display(ccli *interface, ccli_command *command) {
-  ccli_print_color(interface, COLOR_YELLOW, "Usage: ./%s %s [OPTIONS]", interface->exeName, command->command);
-
-  for (int i = 0; i < command->args.size; i++) {
-    ccli_print_color(interface, COLOR_YELLOW, " <%s>", command->args.args[i]->name);
-  }
-
-  ccli_print(interface, "\n\n");
-
-  if (command->description) {
-    ccli_echo_color(interface, COLOR_YELLOW, "  %s\n", command->description);
-  }
-
-  ccli_display_options(interface, command);
-  ccli_display_args(interface, command);
-}
-
-static void ccli_command_display(ccli *interface, ccli_command *command) {
-  ccli_print_color(interface, COLOR_YELLOW, "%s", command->command);
-  if (command->description) {
-    ccli_print_color(interface, COLOR_YELLOW, " -> %s", command->description);
-  }
-  ccli_print(interface, "\n");
-}
-
-static void ccli_display_commands(ccli *interface) {
-  ccli_echo_color(interface, COLOR_YELLOW, "Commands:");
-  for (int i = 0; i < interface->commands.size; i++) {
-    ccli_print(interface, "  ");
-    ccli_command_display(interface, interface->commands.commands[i]);
-  }
-}
-
-static void ccli_usage(ccli *interface) {
-  ccli_echo_color(interface, COLOR_YELLOW, "Usage: ./%s [command] [options]\n", interface->exeName);
-}
-
-static void ccli_display(ccli *interface) {
-
-  ccli_usage(interface);
-
-  if (interface->description) {
-    ccli_echo_color(interface, COLOR_YELLOW, "  %s\n", interface->description);
-  }
-
-  // TODO: commands help
-  ccli_display_commands(interface);
-  ccli_print(interface, "\n");
-
-  // TODO: global options help
-}
-
-/******************** ccli_arg retrieval ********************/
-
-static void check_valid_arg_index(ccli *interface, int index) {
-  if (!interface->invoked_command) {
-    ccli_runtime_error(interface, "No command has been invoked yet.");
-  } else if (interface->invoked_command->args.size <= index) {
-    ccli_runtime_error(interface, "invalid arg index: max is %d, but you used %d.", interface->invoked_command->args.size - 1, index);
-  }
-}
-
-int ccli_get_int_arg(ccli *interface, int index) {
-  check_valid_arg_index(interface, index);
-
-  ccli_value value = interface->invoked_command->args.args[index]->value;
-  if (IS_NUM(value)) return AS_INT(value);
-  else ccli_runtime_error(interface, "argument at index %d isn't a number.", index);
-}
-
-double ccli_get_double_arg(ccli *interface, int index) {
-  check_valid_arg_index(interface, index);
-
-  ccli_value value = interface->invoked_command->args.args[index]->value;
-  if (IS_NUM(value)) return AS_DOUBLE(value);
-  else ccli_runtime_error(interface, "argument at index %d isn't a number.", index);
-}
-
-bool ccli_get_bool_arg(ccli *interface, int index) {
-  check_valid_arg_index(interface, index);
-
-  ccli_value value = interface->invoked_command->args.args[index]->value;
-  if (IS_BOOL(value)) return AS_BOOL(value);
-  else ccli_runtime_error(interface, "argument at index %d isn't a boolean.", index);
-}
-
-char *ccli_get_string_arg(ccli *interface, int index) {
-  check_valid_arg_index(interface, index);
-
-  ccli_value value = interface->invoked_command->args.args[index]->value;
-  if (IS_STRING(value)) return AS_STRING(value);
-  else ccli_runtime_error(interface, "argument at index %d isn't a string.", index);
-}
-
-/******************** ccli global interface API ********************/
-
-
-ccli_command *ccli_add_command(ccli *interface, char *command, ccli_command_callback callback) {
-  ccli_command *_command = ccli_command_new(command, callback);
-  ccli_command_add_option(_command, "--help", NULL, VAL_NULL);
-
-  command_array_add(&interface->commands, _command);
-  return _command;
-}
-
-void ccli_help(ccli *interface, ccli_command *command) {
-  if (!command) {
-    // global help
-    ccli_display(interface);
-    return;
-  }
-
-  ccli_command_display(interface, command);
-}
-
-static ccli_command *get_command(ccli *interface) {
-  for (int i = 0; i < interface->commands.size; i++) {
-    if (!strcmp(interface->argv[1], interface->commands.commands[i]->command)) {
-      interface->current_arg++;
-      return interface->commands.commands[i];
-    }
-  }
-
-  return NULL;
-}
-
-typedef struct {
-  char *name;
-  char *val;
-} parsed_option;
-
-// these helpers are mainly for readability
-#define parsed_option_new(arg, val) ((parsed_option){ arg, val })
-
-static void parsed_option_free(parsed_option *option) {
-  free(option->name);
-}
-
-static char *copy_chars(char *chars, int length) {
-  char *string = malloc(sizeof(char) * (length + 1));
-  strncpy(string, chars, length);
-  string[length] = '\0';
-  return string;
-}
-
-bool is_digit(char c) {
-  return (c >= '0' && c <= '9');
-}
-
-bool is_number(char *value) {
-  if (is_digit(value[0])) {
-    return true;
-  } else if (value[0] == '.') {
-    return (strlen(value) > 1 && is_digit(value[1]));
-  } else if (value[0] == '-') {
-    return (strlen(value) > 1 && is_digit(value[1])) ||
-           (strlen(value) > 2 && value[1] == '.' && is_digit(value[2]));
-  } else return false;
-}
-
-bool is_bool(char *value) {
-  return (!strcasecmp(value, "t") ||
-          !strcasecmp(value, "f") ||
-          !strcasecmp(value, "true") ||
-          !strcasecmp(value, "false"));
-}
-
-// returns the boolean represented by [value].
-// returns false if the value isn't valid.
-bool strtobool(char *value) {
-  return (!strcasecmp(value, "true") || !strcasecmp(value, "t"));
-}
-
-void set_option_value(ccli *interface, ccli_command *command, ccli_option *option, char *name, char *value) {
-  if (!value) {
-    if (option->type == VAL_NULL) {
-      option->value = BOOL_VAL(true);
-      return;
-    } else {
-      ccli_detailed_command_display(interface, command);
-      ccli_runtime_error(interface, "missing option parameter: '%s'.", name);
-    }
-  }
-
-  switch (option->type) {
-    case VAL_NULL: {
-      ccli_detailed_command_display(interface, command);
-      ccli_runtime_error(interface, "option doesn't take parameter: '%s=%s'.", name, value);
-    }
-    case VAL_BOOL: {
-      if (is_bool(value)) {
-        option->value = BOOL_VAL(strtobool(value));
-      } else {
-        ccli_detailed_command_display(interface, command);
-        ccli_runtime_error(interface, "invalid boolean: '%s'.", value);
-      }
-      break;
-    }
-    case VAL_NUM: {
-      if (is_number(value)) {
-        option->value = NUM_VAL(strtod(value, NULL));
-      } else {
-        ccli_detailed_command_display(interface, command);
-        ccli_runtime_error(interface, "invalid number: '%s'.", value);
-      }
-      break;
-    }
-    case VAL_STRING: {
-      option->value = STRING_VAL(value);
-      break;
-    }
-    default:
-      ccli_runtime_error(interface, "unrecognized value type: %d\n", option->type);
-      // TODO: handle this more gracefully?
-  }
-}
-
-parsed_option parse_option(char *arg) {
-  if (arg[0] != '-') return parsed_option_new(NULL, NULL);
-
-  int name_len = 0;
-
-  // TODO: handle short options
-  name_len++; name_len++;
-
-  while (arg[name_len] != '\0' && arg[name_len] != '=') {
-    name_len++;
-  }
-
-  if (arg[name_len] == '=') {
-    return parsed_option_new(copy_chars(arg, name_len), &arg[name_len + 1]);
-  } else {
-    return parsed_option_new(copy_chars(arg, name_len), NULL);
-  }
-}
-
-#undef parsed_option_new
-
-void parse_options(ccli *interface, ccli_command *command) {
-  parsed_option p_option;
-  for (; interface->current_arg < interface->argc &&
-         interface->argv[interface->current_arg][0] == '-';
-         interface->current_arg++) {
-    p_option = parse_option(interface->argv[interface->current_arg]);
-    if (!p_option.name) return;
-
-    ccli_option *option = NULL;
-    // TODO: finish parsing options
-    table_string *string = ccli_table_find_string(&command->options, p_option.name);
-    if (string && ccli_table_get(&command->options, string, &option)) {
-      // option was used
-      set_option_value(interface, command, option, p_option.name, p_option.val);
-    }
-
-    parsed_option_free(&p_option);
-  }
-}
-
-static void parse_arg(ccli *interface, ccli_command *command, ccli_arg *arg, char *value) {
-  switch (arg->type) {
-    case VAL_NUM: {
-      if (is_number(value)) {
-        arg->value = NUM_VAL(strtod(value, NULL));
-      } else {
-        ccli_detailed_command_display(interface, command);
-        ccli_runtime_error(interface, "invalid number: '%s'.", value);
-      }
-      break;
-    }
-    case VAL_BOOL: {
-      if (is_bool(value)) {
-        arg->value = BOOL_VAL(strtobool(value));
-      } else {
-        ccli_detailed_command_display(interface, command);
-        ccli_runtime_error(interface, "invalid boolean: '%s'.", value);
-      }
-      break;
-    }
-    case VAL_STRING: {
-      arg->value = STRING_VAL(value);
-      break;
-    }
-    default: {
-      // Should be unreachable
-      ccli_detailed_command_display(interface, command);
-      ccli_runtime_error(interface, "invalid value type: %d.", arg->type);
-      break;
-    }
-  }
-}
-
-static void parse_args(ccli *interface, ccli_command *command) {
-  // short-circuit for commands with no arguments
-  if (command->args.size == 0) return;
-
-  int num_ccli_args = 0;
-  for (; interface->current_arg < interface->argc && num_ccli_args < command->args.size;
-         interface->current_arg++, num_ccli_args++) {
-    ccli_arg *arg = command->args.args[num_ccli_args];
-    char *value = interface->argv[interface->current_arg];
-    parse_arg(interface, command, arg, value);
-  }
-
-  if (num_ccli_args < command->args.size) {
-    // arguments are required
-    ccli_detailed_command_display(interface, command);
-    ccli_runtime_error(interface, "command requires %d arguments, but %d were specified.",
-               command->args.size, num_ccli_args);
-  }
-}
-
-static void parse_command(ccli *interface) {
-
-}
-
-void ccli_run(ccli *interface) {
-  if (interface->argc <= 1 || !strcmp(interface->argv[interface->current_arg], "--help")) {
-    ccli_help(interface, NULL);
-    return;
-  }
-
-  ccli_command *command = get_command(interface);
-  if (!command) {
-    ccli_echo_color(interface, COLOR_RED, "Error: Unrecognized command -> '%s'\n", interface->argv[1]);
-    ccli_display_commands(interface);
-    ccli_print(interface, "\n");
-    return;
-  }
-
-  interface->invoked_command = command;
-  parse_options(interface, command);
-
-  if (ccli_option_exists(interface, "--help")) {
-    ccli_detailed_command_display(interface, command);
-    return;
-  }
-
-  parse_args(interface, command);
-
-  interface->invoked_command->callback(interface);
-}
\ No newline at end of file
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdarg.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <dirent.h>
+#include <limits.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
+#include <time.h>
+#include <inttypes.h>
+#include <math.h>
+#include <setjmp.h>
+#include <termios.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 32))
+#include <sys/single_threaded.h>
+// stdio can skip its lock until a second thread is started
+#define SINGLE_THREADED() (__libc_single_threaded)
+#else
+#define SINGLE_THREADED() false
+#endif
+
+#include "ccli.h"
+
+//TODO:
+// - command groups (like Click) for subcommands
+// - global options
+
+
+// POSSIBLE FEATURES:
+// - prompt user for input on arguments/options
+
+#define GROW_ARRAY_CAPACITY(cap) ((cap == 0) ? 8 : (cap) * 2)
+
+/******************** printing ********************/
+
+// color escape sequence, or NULL for an invalid color
+static const char *color_code(ccli_color color) {
+  switch (color) {
+    case COLOR_RED:     return "\033[0;31m";
+    case COLOR_GREEN:   return "\033[0;32m";
+    case COLOR_YELLOW:  return "\033[0;33m";
+    case COLOR_BLUE:    return "\033[0;34m";
+    case COLOR_MAGENTA: return "\033[0;35m";
+    case COLOR_CYAN:    return "\033[0;36m";
+    default:            return NULL;
+  }
+}
+
+#define COLOR_RESET "\033[0m"
+
+static void _error(const char *func, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "[ %s ] -> Error: ", func);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+  exit(1);
+}
+
+#define error(format, args...) (_error(__FUNCTION__, format, ## args))
+
+/******************** memory ********************/
+
+// every allocation carries a header with its size and category, so a
+// free knows what to take off the books. 16 bytes keeps the memory after
+// it aligned like the allocator's.
+typedef struct {
+  size_t size;
+  size_t category;
+} memory_header;
+
+static void *default_malloc(void *context, size_t size) {
+  return malloc(size);
+}
+
+static void *default_realloc(void *context, void *pointer, size_t size) {
+  return realloc(pointer, size);
+}
+
+static void default_free(void *context, void *pointer) {
+  free(pointer);
+}
+
+static ccli_malloc_fn allocator_malloc = default_malloc;
+static ccli_realloc_fn allocator_realloc = default_realloc;
+static ccli_free_fn allocator_free = default_free;
+static void *allocator_context = NULL;
+
+typedef struct {
+  _Atomic size_t live_bytes;
+  _Atomic size_t peak_bytes;
+  _Atomic uint64_t allocations;
+} memory_counters;
+
+static memory_counters memory_stats[CCLI_MEMORY_CATEGORIES];
+
+void ccli_set_allocator(ccli_malloc_fn malloc_fn, ccli_realloc_fn realloc_fn, ccli_free_fn free_fn, void *context) {
+  allocator_malloc = malloc_fn ? malloc_fn : default_malloc;
+  allocator_realloc = realloc_fn ? realloc_fn : default_realloc;
+  allocator_free = free_fn ? free_fn : default_free;
+  allocator_context = context;
+}
+
+void ccli_memory_stats(ccli_memory_usage usage[CCLI_MEMORY_CATEGORIES]) {
+  for (int i = 0; i < CCLI_MEMORY_CATEGORIES; i++) {
+    usage[i].live_bytes = atomic_load_explicit(&memory_stats[i].live_bytes, memory_order_relaxed);
+    usage[i].peak_bytes = atomic_load_explicit(&memory_stats[i].peak_bytes, memory_order_relaxed);
+    usage[i].allocations = atomic_load_explicit(&memory_stats[i].allocations, memory_order_relaxed);
+  }
+}
+
+static void memory_count(size_t category, size_t added, size_t removed, bool allocation) {
+  memory_counters *counters = &memory_stats[category];
+  if (allocation) atomic_fetch_add_explicit(&counters->allocations, 1, memory_order_relaxed);
+  if (removed) atomic_fetch_sub_explicit(&counters->live_bytes, removed, memory_order_relaxed);
+  if (!added) return;
+
+  size_t live = atomic_fetch_add_explicit(&counters->live_bytes, added, memory_order_relaxed) + added;
+  size_t peak = atomic_load_explicit(&counters->peak_bytes, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&counters->peak_bytes, &peak, live,
+                                                memory_order_relaxed, memory_order_relaxed));
+}
+
+static void *mem_alloc(ccli_memory_category category, size_t size) {
+  memory_header *header = allocator_malloc(allocator_context, sizeof(memory_header) + size);
+  if (!header) error("out of memory (%zu bytes).", size);
+
+  header->size = size;
+  header->category = category;
+  memory_count(category, size, 0, true);
+  return header + 1;
+}
+
+static void *mem_calloc(ccli_memory_category category, size_t count, size_t size) {
+  void *pointer = mem_alloc(category, count * size);
+  memset(pointer, 0, count * size);
+  return pointer;
+}
+
+// a resized allocation stays in the category it was made in
+static void *mem_realloc(ccli_memory_category category, void *pointer, size_t size) {
+  if (!pointer) return mem_alloc(category, size);
+
+  memory_header *header = (memory_header *)pointer - 1;
+  size_t old_size = header->size;
+  header = allocator_realloc(allocator_context, header, sizeof(memory_header) + size);
+  if (!header) error("out of memory (%zu bytes).", size);
+
+  header->size = size;
+  memory_count(header->category, size, old_size, false);
+  return header + 1;
+}
+
+static void mem_free(void *pointer) {
+  if (!pointer) return;
+
+  memory_header *header = (memory_header *)pointer - 1;
+  memory_count(header->category, 0, header->size, false);
+  allocator_free(allocator_context, header);
+}
+
+static char *mem_copy_string(ccli_memory_category category, const char *chars, size_t size) {
+  char *copy = mem_alloc(category, size + 1);
+  memcpy(copy, chars, size);
+  copy[size] = '\0';
+  return copy;
+}
+
+static char *mem_strndup(ccli_memory_category category, const char *chars, size_t length) {
+  return mem_copy_string(category, chars, strnlen(chars, length));
+}
+
+static char *mem_strdup(ccli_memory_category category, const char *chars) {
+  return mem_copy_string(category, chars, strlen(chars));
+}
+
+/******************** ccli_buffer ********************/
+
+// a growable run of output bytes
+typedef struct {
+  size_t size;
+  size_t capacity;
+  char *chars;
+  // where the first structured record in the buffer starts, and where
+  // its body starts after the opening (see [ccli_emit_begin]). SIZE_MAX
+  // if there isn't one.
+  size_t first_record;
+  size_t first_record_body;
+} ccli_buffer;
+
+static void buffer_init(ccli_buffer *buffer) {
+  buffer->size = 0;
+  buffer->capacity = 0;
+  buffer->chars = NULL;
+  buffer->first_record = SIZE_MAX;
+  buffer->first_record_body = SIZE_MAX;
+}
+
+static void buffer_free(ccli_buffer *buffer) {
+  mem_free(buffer->chars);
+  buffer_init(buffer);
+}
+
+static void buffer_reserve(ccli_buffer *buffer, size_t length) {
+  if (buffer->size + length <= buffer->capacity) return;
+
+  size_t capacity = GROW_ARRAY_CAPACITY(buffer->capacity);
+  while (capacity < buffer->size + length) capacity *= 2;
+  buffer->chars = mem_realloc(CCLI_MEMORY_OUTPUT, buffer->chars, capacity);
+  buffer->capacity = capacity;
+}
+
+static void buffer_append(ccli_buffer *buffer, const char *chars, size_t length) {
+  if (length == 0) return;
+
+  buffer_reserve(buffer, length);
+  memcpy(buffer->chars + buffer->size, chars, length);
+  buffer->size += length;
+}
+
+static void buffer_vprintf(ccli_buffer *buffer, const char *format, va_list args) {
+  va_list copy;
+  va_copy(copy, args);
+  int length = vsnprintf(buffer->chars + buffer->size, buffer->capacity - buffer->size, format, copy);
+  va_end(copy);
+  if (length < 0) return;
+
+  if (buffer->size + length + 1 > buffer->capacity) {
+    buffer_reserve(buffer, length + 1);
+    vsnprintf(buffer->chars + buffer->size, buffer->capacity - buffer->size, format, args);
+  }
+
+  buffer->size += length;
+}
+
+static void buffer_printf(ccli_buffer *buffer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  buffer_vprintf(buffer, format, args);
+  va_end(args);
+}
+
+/******************** number formatting ********************/
+
+// printf-free formatting for the hot output paths. each writes into [out]
+// and returns the length, without a NUL.
+
+static const char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// [out] needs 20 bytes
+static size_t format_u64(char *out, uint64_t value) {
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *start = end;
+
+  // two digits at a time, from the end
+  while (value >= 100) {
+    const char *pair = digit_pairs + (value % 100) * 2;
+    value /= 100;
+    *--start = pair[1];
+    *--start = pair[0];
+  }
+  if (value >= 10) {
+    const char *pair = digit_pairs + value * 2;
+    *--start = pair[1];
+    *--start = pair[0];
+  } else {
+    *--start = '0' + value;
+  }
+
+  memcpy(out, start, end - start);
+  return end - start;
+}
+
+// [out] needs 20 bytes
+static size_t format_i64(char *out, int64_t value) {
+  if (value >= 0) return format_u64(out, value);
+
+  out[0] = '-';
+  // negate as unsigned, so INT64_MIN doesn't overflow
+  return 1 + format_u64(out + 1, -(uint64_t)value);
+}
+
+// lowercase, no prefix. [out] needs 16 bytes.
+static size_t format_u64_hex(char *out, uint64_t value) {
+  static const char hex[] = "0123456789abcdef";
+  size_t length = value ? (64 - __builtin_clzll(value) + 3) / 4 : 1;
+
+  for (size_t i = length; i > 0; i--) {
+    out[i - 1] = hex[value & 0xf];
+    value >>= 4;
+  }
+  return length;
+}
+
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+static locale_t c_locale_value;
+
+static void c_locale_init() {
+  c_locale_value = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+// numbers are read and written with the "C" locale, so a German or French
+// environment doesn't change what '.' means
+static locale_t c_locale() {
+  pthread_once(&c_locale_once, c_locale_init);
+  return c_locale_value;
+}
+
+// the shortest decimal that reads back as the same double. [out] needs
+// 32 bytes.
+static size_t format_f64(char *out, double value) {
+  if (isnan(value)) {
+    memcpy(out, "nan", 3);
+    return 3;
+  }
+  if (isinf(value)) {
+    if (value < 0) memcpy(out, "-inf", 4);
+    else memcpy(out, "inf", 3);
+    return (value < 0) ? 4 : 3;
+  }
+
+  // whole numbers that fit in an int64 exactly don't need printf at all
+  if (fabs(value) < 1e15 && value == (double)(int64_t)value) {
+    if (value == 0 && signbit(value)) {
+      memcpy(out, "-0", 2);
+      return 2;
+    }
+    return format_i64(out, (int64_t)value);
+  }
+
+  // neither does a short decimal like 0.125. the fewest fractional
+  // digits k for which value * 10^k is a whole number m that reads back
+  // as value (both m and 10^k are exact, so m / 10^k rounds correctly)
+  // give the shortest form. %g would print the same digits in this range.
+  static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16
+  };
+  double magnitude = fabs(value);
+  if (magnitude >= 1e-4 && magnitude < 1e15) {
+    for (int k = 1; k <= 16; k++) {
+      double product = magnitude * powers_of_ten[k];
+      if (product >= 9007199254740992.0) break;
+      double scaled = (double)(uint64_t)(product + 0.5);
+      if (scaled / powers_of_ten[k] != magnitude) continue;
+
+      uint64_t whole = (uint64_t)scaled;
+      uint64_t scale = (uint64_t)powers_of_ten[k];
+      size_t length = 0;
+      if (value < 0) out[length++] = '-';
+      length += format_u64(out + length, whole / scale);
+      out[length++] = '.';
+
+      // the fraction, with its leading zeros
+      char fraction[20];
+      size_t digits = format_u64(fraction, whole % scale);
+      for (size_t i = digits; i < (size_t)k; i++) out[length++] = '0';
+      memcpy(out + length, fraction, digits);
+      return length + digits;
+    }
+  }
+
+  // a normal double that round trips in 15 digits or less has its
+  // shortest form there, with the trailing zeros stripped by %g;
+  // otherwise it's 16 or 17. subnormals have fewer digits to go on, so
+  // they start from 1.
+  locale_t saved = uselocale(c_locale());
+  int precision = (fabs(value) < 2.2250738585072014e-308) ? 1 : 15;
+  int length = 0;
+  for (; precision <= 17; precision++) {
+    length = snprintf(out, 32, "%.*g", precision, value);
+    if (precision == 17 || strtod(out, NULL) == value) break;
+  }
+  uselocale(saved);
+  return length;
+}
+
+/******************** ccli_value ********************/
+
+typedef enum {
+  VAL_NULL,
+  VAL_NUM,
+  VAL_BOOL,
+  VAL_STRING,
+  VAL_CHOICE,
+  // accumulating option kinds: every occurrence adds to the option
+  VAL_STRING_LIST,
+  VAL_NUM_LIST,
+  VAL_COUNTER,
+  VAL_RANGE_LIST,
+  // full-width integers, never squeezed through a double
+  VAL_INT64,
+  VAL_UINT64,
+  VAL_FILE,
+  // a type from ccli_register_type
+  VAL_TYPED
+} ccli_value_type;
+
+struct ccli_type {
+  char *name;
+  size_t size;
+  ccli_parse_fn parse;
+  ccli_format_fn format;
+};
+
+// where a custom-typed option or argument keeps its value, allocated
+// once with room for the type, so parsing a value never allocates
+typedef struct {
+  ccli_type *type;
+  _Alignas(16) unsigned char data[];
+} typed_slot;
+
+static typed_slot *typed_slot_new(ccli_type *type) {
+  typed_slot *slot = mem_calloc(CCLI_MEMORY_SCHEMA, 1, sizeof(typed_slot) + type->size);
+  slot->type = type;
+  return slot;
+}
+
+typedef struct {
+  ccli_value_type type;
+  union {
+    double number;
+    bool boolean;
+    char *string;
+    int choice;
+    ccli_range_list *ranges;
+    int64_t int64;
+    uint64_t uint64;
+    ccli_file *file;
+    typed_slot *typed;
+  } as;
+} ccli_value;
+
+#define NULL_VAL          ((ccli_value){ VAL_NULL,   { .number = 0 } })
+#define BOOL_VAL(value)   ((ccli_value){ VAL_BOOL,   { .boolean = value } })
+#define NUM_VAL(value)    ((ccli_value){ VAL_NUM,    { .number = (double)value } })
+#define STRING_VAL(value) ((ccli_value){ VAL_STRING, { .string = value }})
+#define CHOICE_VAL(value) ((ccli_value){ VAL_CHOICE, { .choice = value }})
+#define RANGE_VAL(value)  ((ccli_value){ VAL_RANGE_LIST, { .ranges = value }})
+#define INT64_VAL(value)  ((ccli_value){ VAL_INT64,  { .int64 = value }})
+#define UINT64_VAL(value) ((ccli_value){ VAL_UINT64, { .uint64 = value }})
+#define FILE_VAL(value)   ((ccli_value){ VAL_FILE,   { .file = value }})
+#define TYPED_VAL(value)  ((ccli_value){ VAL_TYPED,  { .typed = value }})
+
+#define IS_NULL(value)    ((value).type == VAL_NULL)
+#define IS_NUM(value)     ((value).type == VAL_NUM)
+#define IS_BOOL(value)    ((value).type == VAL_BOOL)
+#define IS_STRING(value)  ((value).type == VAL_STRING)
+#define IS_CHOICE(value)  ((value).type == VAL_CHOICE)
+#define IS_RANGE(value)   ((value).type == VAL_RANGE_LIST)
+#define IS_INT64(value)   ((value).type == VAL_INT64)
+#define IS_UINT64(value)  ((value).type == VAL_UINT64)
+#define IS_FILE(value)    ((value).type == VAL_FILE)
+#define IS_TYPED(value)   ((value).type == VAL_TYPED)
+
+#define AS_INT(value)     ((int)((value).as.number))
+#define AS_DOUBLE(value)  ((value).as.number)
+#define AS_BOOL(value)    ((value).as.boolean)
+#define AS_STRING(value)  ((value).as.string)
+#define AS_CHOICE(value)  ((value).as.choice)
+#define AS_RANGE(value)   ((value).as.ranges)
+#define AS_INT64(value)   ((value).as.int64)
+#define AS_UINT64(value)  ((value).as.uint64)
+#define AS_FILE(value)    ((value).as.file)
+#define AS_TYPED(value)   ((value).as.typed)
+
+// the placeholder shown in help for an integer value
+static const char *unit_display_name(ccli_unit unit) {
+  switch (unit) {
+    case CCLI_UNIT_BYTES:    return "SIZE";
+    case CCLI_UNIT_DURATION: return "DURATION";
+    default:                 return "INTEGER";
+  }
+}
+
+/******************** ccli_bitset ********************/
+
+// a growable set of small integers (option indices), stored as 64-bit words.
+// missing words are treated as zero, so sets of different sizes can be
+// combined without resizing either of them.
+typedef struct {
+  int words;
+  uint64_t *bits;
+} ccli_bitset;
+
+#define BITSET_WORD(index) ((index) / 64)
+#define BITSET_MASK(index) ((uint64_t)1 << ((index) % 64))
+
+static void bitset_init(ccli_bitset *set) {
+  set->words = 0;
+  set->bits = NULL;
+}
+
+static void bitset_free(ccli_bitset *set) {
+  mem_free(set->bits);
+  bitset_init(set);
+}
+
+static void bitset_set(ccli_bitset *set, int index) {
+  int word = BITSET_WORD(index);
+  if (word >= set->words) {
+    int words = word + 1;
+    set->bits = mem_realloc(CCLI_MEMORY_SCHEMA, set->bits, sizeof(uint64_t) * words);
+    memset(&set->bits[set->words], 0, sizeof(uint64_t) * (words - set->words));
+    set->words = words;
+  }
+
+  set->bits[word] |= BITSET_MASK(index);
+}
+
+static void bitset_clear(ccli_bitset *set) {
+  if (set->words) memset(set->bits, 0, sizeof(uint64_t) * set->words);
+}
+
+static void bitset_unset(ccli_bitset *set, int index) {
+  int word = BITSET_WORD(index);
+  if (word < set->words) set->bits[word] &= ~BITSET_MASK(index);
+}
+
+static bool bitset_test(ccli_bitset *set, int index) {
+  int word = BITSET_WORD(index);
+  return word < set->words && (set->bits[word] & BITSET_MASK(index));
+}
+
+// the smallest member that is >= [index], or -1 if there is none
+static int bitset_next(ccli_bitset *set, int index) {
+  int word = BITSET_WORD(index);
+  if (word >= set->words) return -1;
+
+  uint64_t bits = set->bits[word] & ~(BITSET_MASK(index) - 1);
+  for (;;) {
+    if (bits) return word * 64 + __builtin_ctzll(bits);
+    if (++word >= set->words) return -1;
+    bits = set->bits[word];
+  }
+}
+
+// true if every member of [subset] is also in [set]
+static bool bitset_covers(ccli_bitset *set, ccli_bitset *subset) {
+  for (int i = 0; i < subset->words; i++) {
+    uint64_t word = (i < set->words) ? set->bits[i] : 0;
+    if ((word & subset->bits[i]) != subset->bits[i]) return false;
+  }
+
+  return true;
+}
+
+// number of members shared by [a] and [b]
+static int bitset_count_common(ccli_bitset *a, ccli_bitset *b) {
+  int words = (a->words < b->words) ? a->words : b->words;
+  int count = 0;
+  for (int i = 0; i < words; i++) {
+    count += __builtin_popcountll(a->bits[i] & b->bits[i]);
+  }
+
+  return count;
+}
+
+#undef BITSET_WORD
+#undef BITSET_MASK
+
+/******************** value_vector ********************/
+
+// values of a repeatable option. the first few live inline in the
+// vector itself, so the common one-to-four case never allocates;
+// past that the items spill to a growing heap array.
+#define VALUE_VECTOR_INLINE 4
+
+typedef struct {
+  int size;
+  int capacity;
+  size_t item_size;
+  // NULL until the vector spills out of [inline_items]
+  void *heap;
+  uint64_t inline_items[VALUE_VECTOR_INLINE];
+} value_vector;
+
+static void value_vector_init(value_vector *vector, size_t item_size) {
+  vector->size = 0;
+  vector->capacity = VALUE_VECTOR_INLINE;
+  vector->item_size = item_size;
+  vector->heap = NULL;
+}
+
+static void value_vector_free(value_vector *vector) {
+  mem_free(vector->heap);
+  value_vector_init(vector, vector->item_size);
+}
+
+static void *value_vector_items(value_vector *vector) {
+  return vector->heap ? vector->heap : (void *)vector->inline_items;
+}
+
+static void value_vector_add(value_vector *vector, const void *item) {
+  if (vector->size + 1 > vector->capacity) {
+    int capacity = GROW_ARRAY_CAPACITY(vector->capacity);
+    if (!vector->heap) {
+      vector->heap = mem_alloc(CCLI_MEMORY_PARSE, vector->item_size * capacity);
+      memcpy(vector->heap, vector->inline_items, vector->item_size * vector->size);
+    } else {
+      vector->heap = mem_realloc(CCLI_MEMORY_PARSE, vector->heap, vector->item_size * capacity);
+    }
+    vector->capacity = capacity;
+  }
+
+  memcpy((char *)value_vector_items(vector) + vector->item_size * vector->size, item, vector->item_size);
+  vector->size++;
+}
+
+/******************** choice_table ********************/
+
+// the accepted values of a choice option. [sorted] holds choice ids
+// ordered by their strings, so a token resolves to its id with a
+// binary search instead of a strcmp against every choice.
+typedef struct {
+  char **choices;
+  int count;
+  int *sorted;
+} choice_table;
+
+static void choice_table_init(choice_table *table) {
+  table->choices = NULL;
+  table->count = 0;
+  table->sorted = NULL;
+}
+
+static void choice_table_free(choice_table *table) {
+  mem_free(table->sorted);
+  choice_table_init(table);
+}
+
+static void choice_table_build(choice_table *table, char **choices, int count) {
+  table->choices = choices;
+  table->count = count;
+  table->sorted = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(int) * count);
+
+  // choice lists are short, insertion sort is plenty
+  for (int i = 0; i < count; i++) {
+    int j = i;
+    for (; j > 0 && strcmp(choices[table->sorted[j - 1]], choices[i]) > 0; j--) {
+      table->sorted[j] = table->sorted[j - 1];
+    }
+    table->sorted[j] = i;
+  }
+
+  for (int i = 1; i < count; i++) {
+    if (!strcmp(choices[table->sorted[i - 1]], choices[table->sorted[i]])) {
+      error("duplicate choice: '%s'.", choices[table->sorted[i]]);
+    }
+  }
+}
+
+// returns the id of [value], or -1 if it isn't one of the choices
+static int choice_table_find(choice_table *table, const char *value) {
+  int low = 0;
+  int high = table->count - 1;
+
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    int id = table->sorted[mid];
+    int cmp = strcmp(value, table->choices[id]);
+
+    if (cmp == 0) return id;
+    else if (cmp < 0) high = mid - 1;
+    else low = mid + 1;
+  }
+
+  return -1;
+}
+
+/******************** ccli_range_list ********************/
+
+// a set of non-negative integers written as '0-511,600,700-1023'.
+//
+// dense sets with small members are stored as a bitset, so membership
+// is a single bit test. anything else is kept as sorted, disjoint,
+// inclusive intervals and searched with a binary search.
+#define RANGE_BITSET_LIMIT 65536
+
+typedef struct {
+  uint64_t start;
+  uint64_t end;
+} range_interval;
+
+struct ccli_range_list {
+  uint64_t count;
+  uint64_t max;
+  // exactly one of these is in use
+  bool is_bitset;
+  ccli_bitset bits;
+  int size;
+  range_interval *intervals;
+};
+
+static void range_list_free(ccli_range_list *list) {
+  if (!list) return;
+
+  bitset_free(&list->bits);
+  mem_free(list->intervals);
+  mem_free(list);
+}
+
+static const char *parse_range_bound(const char *chars, uint64_t *value) {
+  if (*chars < '0' || *chars > '9') return NULL;
+
+  uint64_t result = 0;
+  for (; *chars >= '0' && *chars <= '9'; chars++) {
+    uint64_t digit = *chars - '0';
+    if (result > (UINT64_MAX - digit) / 10) return NULL;
+    result = result * 10 + digit;
+  }
+
+  *value = result;
+  return chars;
+}
+
+static int compare_intervals(const void *a, const void *b) {
+  const range_interval *left = a;
+  const range_interval *right = b;
+  if (left->start != right->start) return (left->start < right->start) ? -1 : 1;
+  return 0;
+}
+
+// returns NULL, and points [error] at a reason, if [chars] isn't a valid range list
+static ccli_range_list *range_list_parse(const char *chars, const char **error) {
+  int capacity = 0;
+  int size = 0;
+  range_interval *intervals = NULL;
+  bool sorted = true;
+
+  for (const char *c = chars;;) {
+    range_interval interval;
+    c = parse_range_bound(c, &interval.start);
+    if (!c) {
+      *error = "expected a number";
+      mem_free(intervals);
+      return NULL;
+    }
+
+    interval.end = interval.start;
+    if (*c == '-') {
+      c = parse_range_bound(c + 1, &interval.end);
+      if (!c) {
+        *error = "expected a number after '-'";
+        mem_free(intervals);
+        return NULL;
+      } else if (interval.end < interval.start) {
+        *error = "range ends before it starts";
+        mem_free(intervals);
+        return NULL;
+      }
+    }
+
+    if (size + 1 > capacity) {
+      capacity = GROW_ARRAY_CAPACITY(capacity);
+      intervals = mem_realloc(CCLI_MEMORY_PARSE, intervals, sizeof(range_interval) * capacity);
+    }
+    if (size > 0 && interval.start <= intervals[size - 1].end) sorted = false;
+    intervals[size++] = interval;
+
+    if (*c == '\0') break;
+    if (*c != ',') {
+      *error = "expected ',' between ranges";
+      mem_free(intervals);
+      return NULL;
+    }
+    c++;
+  }
+
+  if (!sorted) qsort(intervals, size, sizeof(range_interval), compare_intervals);
+
+  // merge overlapping and adjacent intervals
+  int merged = 0;
+  for (int i = 1; i < size; i++) {
+    range_interval *last = &intervals[merged];
+    if (last->end == UINT64_MAX || intervals[i].start <= last->end + 1) {
+      if (intervals[i].end > last->end) last->end = intervals[i].end;
+    } else {
+      intervals[++merged] = intervals[i];
+    }
+  }
+  size = merged + 1;
+
+  ccli_range_list *list = mem_alloc(CCLI_MEMORY_PARSE, sizeof(ccli_range_list));
+  list->count = 0;
+  list->max = intervals[size - 1].end;
+  bitset_init(&list->bits);
+  for (int i = 0; i < size; i++) {
+    // 0-18446744073709551615 has one member too many to count
+    uint64_t span = intervals[i].end - intervals[i].start;
+    if (span >= UINT64_MAX - list->count) list->count = UINT64_MAX;
+    else list->count += span + 1;
+  }
+
+  // use a bitset when it's small, and on average every word has a member in it
+  list->is_bitset = list->max < RANGE_BITSET_LIMIT && (list->max + 1) / 64 <= list->count;
+  if (list->is_bitset) {
+    for (int i = 0; i < size; i++) {
+      for (uint64_t value = intervals[i].start; value <= intervals[i].end; value++) {
+        bitset_set(&list->bits, (int)value);
+      }
+    }
+
+    mem_free(intervals);
+    list->size = 0;
+    list->intervals = NULL;
+  } else {
+    list->size = size;
+    list->intervals = mem_realloc(CCLI_MEMORY_PARSE, intervals, sizeof(range_interval) * size);
+  }
+
+  return list;
+}
+
+// index of the first interval that ends at or after [value]
+static int range_list_search(ccli_range_list *list, uint64_t value) {
+  int low = 0;
+  int high = list->size;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (list->intervals[mid].end < value) low = mid + 1;
+    else high = mid;
+  }
+
+  return low;
+}
+
+bool ccli_range_list_contains(ccli_range_list *list, uint64_t value) {
+  if (value > list->max) return false;
+  if (list->is_bitset) return bitset_test(&list->bits, (int)value);
+
+  int index = range_list_search(list, value);
+  return index < list->size && list->intervals[index].start <= value;
+}
+
+uint64_t ccli_range_list_count(ccli_range_list *list) {
+  return list->count;
+}
+
+bool ccli_range_list_next(ccli_range_list *list, uint64_t from, uint64_t *value) {
+  if (from > list->max) return false;
+
+  if (list->is_bitset) {
+    int next = bitset_next(&list->bits, (int)from);
+    if (next < 0) return false;
+    *value = next;
+    return true;
+  }
+
+  int index = range_list_search(list, from);
+  if (index >= list->size) return false;
+  *value = (list->intervals[index].start > from) ? list->intervals[index].start : from;
+  return true;
+}
+
+bool ccli_range_list_after(ccli_range_list *list, uint64_t value, uint64_t *next) {
+  if (value == UINT64_MAX) return false;
+  return ccli_range_list_next(list, value + 1, next);
+}
+
+bool ccli_range_list_to_cpu_set(ccli_range_list *list, cpu_set_t *set) {
+  CPU_ZERO(set);
+  if (list->max >= CPU_SETSIZE) return false;
+
+  if (list->is_bitset) {
+    // glibc lays a cpu_set_t out as an array of machine words, bit i of
+    // word i / 64 being cpu i, which is exactly the bitset's layout
+    if (sizeof(unsigned long) == sizeof(uint64_t)) {
+      memcpy(set, list->bits.bits, sizeof(uint64_t) * list->bits.words);
+    } else {
+      for (int cpu = bitset_next(&list->bits, 0); cpu >= 0; cpu = bitset_next(&list->bits, cpu + 1)) {
+        CPU_SET(cpu, set);
+      }
+    }
+    return true;
+  }
+
+  for (int i = 0; i < list->size; i++) {
+    for (uint64_t cpu = list->intervals[i].start; cpu <= list->intervals[i].end; cpu++) {
+      CPU_SET(cpu, set);
+    }
+  }
+
+  return true;
+}
+
+/******************** ccli_file ********************/
+
+// an input file given on the command line. it's opened when the command
+// line is parsed, so a missing file is reported before the callback runs,
+// but its contents are only mapped in the first time they're asked for.
+// '-' reads standard input into a growing buffer instead.
+struct ccli_file {
+  char *path;
+  int fd;
+  bool is_stdin;
+  bool loaded;
+  // true if [data] is an mmap'd view rather than a heap buffer
+  bool mapped;
+  char *data;
+  size_t length;
+};
+
+// returns NULL, with errno set, if [path] can't be opened for reading
+static ccli_file *file_open(char *path) {
+  bool is_stdin = !strcmp(path, "-");
+  int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (!is_stdin) {
+    bool is_dir = false;
+    if (fstat(fd, &st) < 0 || (is_dir = S_ISDIR(st.st_mode))) {
+      if (is_dir) errno = EISDIR;
+      close(fd);
+      return NULL;
+    }
+  }
+
+  ccli_file *file = mem_alloc(CCLI_MEMORY_PARSE, sizeof(ccli_file));
+  file->path = path;
+  file->fd = fd;
+  file->is_stdin = is_stdin;
+  file->loaded = false;
+  file->mapped = false;
+  file->data = NULL;
+  file->length = 0;
+  return file;
+}
+
+static void file_free(ccli_file *file) {
+  if (!file) return;
+
+  if (file->mapped) munmap(file->data, file->length);
+  else mem_free(file->data);
+  if (!file->is_stdin) close(file->fd);
+  mem_free(file);
+}
+
+// drop the contents and open the path again, to see what's there now.
+// if it's gone, reading it fails the way any unreadable file does.
+static void file_reopen(ccli_file *file) {
+  if (file->is_stdin) return;
+
+  if (file->mapped) munmap(file->data, file->length);
+  else mem_free(file->data);
+  close(file->fd);
+
+  file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+  file->loaded = false;
+  file->mapped = false;
+  file->data = NULL;
+  file->length = 0;
+}
+
+// read the rest of [fd] into a heap buffer, for pipes and other
+// files that can't be mapped
+static bool file_read_all(ccli_file *file) {
+  size_t capacity = 0;
+  size_t length = 0;
+  char *data = NULL;
+
+  for (;;) {
+    if (length == capacity) {
+      capacity = (capacity == 0) ? 64 * 1024 : capacity * 2;
+      data = mem_realloc(CCLI_MEMORY_PARSE, data, capacity);
+    }
+
+    ssize_t count = read(file->fd, data + length, capacity - length);
+    if (count == 0) break;
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      mem_free(data);
+      return false;
+    }
+    length += count;
+  }
+
+  file->data = data;
+  file->length = length;
+  return true;
+}
+
+static bool file_load(ccli_file *file) {
+  if (file->loaded) return true;
+
+  struct stat st;
+  if (!file->is_stdin && fstat(file->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    file->length = st.st_size;
+    if (file->length == 0) {
+      // nothing to map, hand out an empty view
+      file->loaded = true;
+      return true;
+    }
+
+    void *data = mmap(NULL, file->length, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (data != MAP_FAILED) {
+      // callbacks almost always stream through their input front to back
+      madvise(data, file->length, MADV_SEQUENTIAL);
+      madvise(data, file->length, MADV_WILLNEED);
+      file->data = data;
+      file->mapped = true;
+      file->loaded = true;
+      return true;
+    }
+  }
+
+  file->length = 0;
+  if (!file_read_all(file)) return false;
+  file->loaded = true;
+  return true;
+}
+
+const char *ccli_file_data(ccli_file *file, size_t *length) {
+  if (!file_load(file)) return NULL;
+
+  *length = file->length;
+  // an empty file still gets a valid pointer
+  return file->data ? file->data : "";
+}
+
+char *ccli_file_path(ccli_file *file) {
+  return file->path;
+}
+
+/******************** value_pattern ********************/
+
+// a pattern every value of a string option has to match, in full:
+// literals, '.', [sets] (with ranges and '^'), \d \w \s and their
+// negations, (groups), '|', and the * + ? {n} {n,} {n,m} repeats.
+//
+// it's compiled once, when the option is set up, into a minimized DFA
+// whose columns are byte classes (bytes the pattern never tells apart
+// share one). checking a value is then one table lookup per byte, with
+// no backtracking.
+#define PATTERN_MAX_REPEAT 1000
+#define PATTERN_MAX_NFA_STATES 20000
+#define PATTERN_MAX_DFA_STATES 1024
+
+typedef struct {
+  char *source;
+  // byte -> column of [next]
+  uint8_t columns[256];
+  int column_count;
+  int start;
+  // state * column_count + column -> state. nothing leads out of
+  // state 0 to a match, so a value can be rejected as soon as it's there
+  uint16_t *next;
+  bool *accepting;
+} value_pattern;
+
+static void value_pattern_free(value_pattern *pattern) {
+  if (!pattern) return;
+
+  mem_free(pattern->source);
+  mem_free(pattern->next);
+  mem_free(pattern->accepting);
+  mem_free(pattern);
+}
+
+static bool value_pattern_match(const value_pattern *pattern, const char *value) {
+  const uint16_t *next = pattern->next;
+  int column_count = pattern->column_count;
+  int state = pattern->start;
+
+  for (const unsigned char *c = (const unsigned char *)value; *c; c++) {
+    state = next[state * column_count + pattern->columns[*c]];
+    if (state == 0) return false;
+  }
+
+  return pattern->accepting[state];
+}
+
+// a parsed pattern is a tree of these, linked by index
+typedef enum {
+  PATTERN_EMPTY,
+  PATTERN_SET,
+  PATTERN_CONCAT,
+  PATTERN_ALTERNATE,
+  PATTERN_REPEAT
+} pattern_node_kind;
+
+typedef struct {
+  pattern_node_kind kind;
+  int left;
+  int right;
+  // PATTERN_REPEAT: [left], at least [min] times and at most [max] (-1 for no limit)
+  int min;
+  int max;
+  // PATTERN_SET: the bytes it matches
+  uint64_t bytes[4];
+} pattern_node;
+
+// an NFA state moves on a byte in [node]'s set to [next], or if [node]
+// is -1, on nothing to [next] and [other] (-1 for neither)
+typedef struct {
+  int node;
+  int next;
+  int other;
+} pattern_nfa_state;
+
+typedef struct {
+  int start;
+  int end;
+} pattern_fragment;
+
+typedef struct {
+  const char *text;
+  // set by the first problem found
+  const char *reason;
+  pattern_node *nodes;
+  int node_count;
+  int node_capacity;
+  pattern_nfa_state *states;
+  int state_count;
+  int state_capacity;
+} pattern_compiler;
+
+static bool byte_set_test(const uint64_t *bytes, int byte) {
+  return bytes[byte >> 6] & (1ULL << (byte & 63));
+}
+
+static void byte_set_add(uint64_t *bytes, int low, int high) {
+  for (int byte = low; byte <= high; byte++) bytes[byte >> 6] |= 1ULL << (byte & 63);
+}
+
+static bool pattern_fail(pattern_compiler *compiler, const char *reason) {
+  if (!compiler->reason) compiler->reason = reason;
+  return false;
+}
+
+static int pattern_node_new(pattern_compiler *compiler, pattern_node_kind kind, int left, int right) {
+  if (compiler->node_count == compiler->node_capacity) {
+    compiler->node_capacity = GROW_ARRAY_CAPACITY(compiler->node_capacity);
+    compiler->nodes = mem_realloc(CCLI_MEMORY_SCHEMA, compiler->nodes, sizeof(pattern_node) * compiler->node_capacity);
+  }
+
+  pattern_node *node = &compiler->nodes[compiler->node_count];
+  memset(node, 0, sizeof(pattern_node));
+  node->kind = kind;
+  node->left = left;
+  node->right = right;
+  return compiler->node_count++;
+}
+
+// adds the bytes of the escape '\[c]' to [bytes]
+static bool pattern_escape(pattern_compiler *compiler, char c, uint64_t *bytes) {
+  uint64_t set[4] = { 0 };
+  switch (c) {
+    case 'd': case 'D': byte_set_add(set, '0', '9'); break;
+    case 'w': case 'W':
+      byte_set_add(set, '0', '9');
+      byte_set_add(set, 'A', 'Z');
+      byte_set_add(set, 'a', 'z');
+      byte_set_add(set, '_', '_');
+      break;
+    case 's': case 'S':
+      byte_set_add(set, '\t', '\r');
+      byte_set_add(set, ' ', ' ');
+      break;
+    case 'n': byte_set_add(set, '\n', '\n'); break;
+    case 't': byte_set_add(set, '\t', '\t'); break;
+    case '\0': return pattern_fail(compiler, "trailing '\\'");
+    default:
+      // letters and digits are saved for escapes that mean something
+      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+        return pattern_fail(compiler, "unknown escape");
+      }
+      byte_set_add(set, (unsigned char)c, (unsigned char)c);
+  }
+
+  bool negated = (c == 'D' || c == 'W' || c == 'S');
+  for (int i = 0; i < 4; i++) bytes[i] |= negated ? ~set[i] : set[i];
+  return true;
+}
+
+// one byte of a [set], where '\n', '\t' and '\]'-style escapes are plain bytes
+static int pattern_set_byte(const char **text) {
+  int c = (unsigned char)*(*text)++;
+  if (c != '\\' || !**text) return c;
+
+  c = (unsigned char)*(*text)++;
+  return (c == 'n') ? '\n' : (c == 't') ? '\t' : c;
+}
+
+// parses what follows a '['
+static bool pattern_parse_set(pattern_compiler *compiler, uint64_t *bytes) {
+  const char *text = compiler->text;
+  bool negated = (*text == '^');
+  if (negated) text++;
+
+  uint64_t set[4] = { 0 };
+  // a ']' straight after the '[' (or '[^') is just a ']'
+  const char *first = text;
+  while (*text != ']' || text == first) {
+    if (!*text) return pattern_fail(compiler, "missing ']'");
+
+    if (text[0] == '\\' && text[1] && strchr("dDwWsS", text[1])) {
+      pattern_escape(compiler, text[1], set);
+      text += 2;
+      continue;
+    }
+
+    int low = pattern_set_byte(&text);
+    int high = low;
+    if (text[0] == '-' && text[1] && text[1] != ']') {
+      text++;
+      high = pattern_set_byte(&text);
+      if (high < low) return pattern_fail(compiler, "range out of order");
+    }
+    byte_set_add(set, low, high);
+  }
+
+  compiler->text = text + 1;
+  for (int i = 0; i < 4; i++) bytes[i] = negated ? ~set[i] : set[i];
+  return true;
+}
+
+static int pattern_parse_alternate(pattern_compiler *compiler);
+
+static int pattern_parse_atom(pattern_compiler *compiler) {
+  char c = *compiler->text++;
+  if (c == '(') {
+    int node = pattern_parse_alternate(compiler);
+    if (node < 0) return -1;
+    if (*compiler->text != ')') {
+      pattern_fail(compiler, "missing ')'");
+      return -1;
+    }
+
+    compiler->text++;
+    return node;
+  }
+
+  if (strchr("*+?{", c)) {
+    pattern_fail(compiler, "nothing to repeat");
+    return -1;
+  }
+
+  int node = pattern_node_new(compiler, PATTERN_SET, -1, -1);
+  uint64_t *bytes = compiler->nodes[node].bytes;
+  bool valid = true;
+  if (c == '.') byte_set_add(bytes, 1, 255);
+  else if (c == '[') valid = pattern_parse_set(compiler, bytes);
+  else if (c == '\\') valid = pattern_escape(compiler, *compiler->text ? *compiler->text++ : '\0', bytes);
+  else byte_set_add(bytes, (unsigned char)c, (unsigned char)c);
+
+  return valid ? node : -1;
+}
+
+// a repeat count, or -1 if there's no number at [text]
+static int pattern_bound(const char **text) {
+  if (**text < '0' || **text > '9') return -1;
+
+  int value = 0;
+  for (; **text >= '0' && **text <= '9'; (*text)++) {
+    // anything past the limit is rejected, so stop counting there
+    if (value <= PATTERN_MAX_REPEAT) value = value * 10 + (**text - '0');
+  }
+  return value;
+}
+
+// parses '{n}', '{n,}' or '{n,m}'
+static bool pattern_parse_bounds(pattern_compiler *compiler, int *min, int *max) {
+  const char *text = compiler->text + 1;
+  *min = *max = pattern_bound(&text);
+  if (*min < 0) return pattern_fail(compiler, "expected a number after '{'");
+
+  if (*text == ',') {
+    text++;
+    *max = pattern_bound(&text);
+    if (*max < 0 && *text != '}') return pattern_fail(compiler, "expected a number after ','");
+  }
+
+  if (*text != '}') return pattern_fail(compiler, "missing '}'");
+  if (*min > PATTERN_MAX_REPEAT || *max > PATTERN_MAX_REPEAT) return pattern_fail(compiler, "repeat count is too large");
+  if (*max >= 0 && *max < *min) return pattern_fail(compiler, "repeat bounds out of order");
+
+  compiler->text = text + 1;
+  return true;
+}
+
+static int pattern_parse_repeat(pattern_compiler *compiler) {
+  int node = pattern_parse_atom(compiler);
+
+  while (node >= 0) {
+    int min, max;
+    char c = *compiler->text;
+    if (c == '*')      { min = 0; max = -1; }
+    else if (c == '+') { min = 1; max = -1; }
+    else if (c == '?') { min = 0; max = 1; }
+    else if (c == '{') {
+      if (!pattern_parse_bounds(compiler, &min, &max)) return -1;
+    } else {
+      break;
+    }
+    if (c != '{') compiler->text++;
+
+    node = pattern_node_new(compiler, PATTERN_REPEAT, node, -1);
+    compiler->nodes[node].min = min;
+    compiler->nodes[node].max = max;
+  }
+
+  return node;
+}
+
+static int pattern_parse_concat(pattern_compiler *compiler) {
+  int node = pattern_node_new(compiler, PATTERN_EMPTY, -1, -1);
+
+  while (*compiler->text && *compiler->text != '|' && *compiler->text != ')') {
+    int next = pattern_parse_repeat(compiler);
+    if (next < 0) return -1;
+    node = pattern_node_new(compiler, PATTERN_CONCAT, node, next);
+  }
+
+  return node;
+}
+
+static int pattern_parse_alternate(pattern_compiler *compiler) {
+  int node = pattern_parse_concat(compiler);
+
+  while (node >= 0 && *compiler->text == '|') {
+    compiler->text++;
+    int other = pattern_parse_concat(compiler);
+    if (other < 0) return -1;
+    node = pattern_node_new(compiler, PATTERN_ALTERNATE, node, other);
+  }
+
+  return node;
+}
+
+// past the state limit this hands back state 0 and sets [reason],
+// so building can unwind without checking every step
+static int pattern_state_new(pattern_compiler *compiler, int node, int next, int other) {
+  if (compiler->state_count == PATTERN_MAX_NFA_STATES) {
+    pattern_fail(compiler, "pattern is too large");
+    return 0;
+  }
+
+  if (compiler->state_count == compiler->state_capacity) {
+    compiler->state_capacity = GROW_ARRAY_CAPACITY(compiler->state_capacity);
+    compiler->states = mem_realloc(CCLI_MEMORY_SCHEMA, compiler->states, sizeof(pattern_nfa_state) * compiler->state_capacity);
+  }
+
+  compiler->states[compiler->state_count] = (pattern_nfa_state){ node, next, other };
+  return compiler->state_count++;
+}
+
+// adds an empty move. fragments end in a state with no moves yet,
+// and get at most two
+static void pattern_link(pattern_compiler *compiler, int from, int to) {
+  pattern_nfa_state *state = &compiler->states[from];
+  if (state->next < 0) state->next = to;
+  else state->other = to;
+}
+
+static pattern_fragment pattern_build(pattern_compiler *compiler, int index);
+
+static pattern_fragment pattern_build_repeat(pattern_compiler *compiler, int child, int min, int max) {
+  int start = pattern_state_new(compiler, -1, -1, -1);
+  int end = start;
+  for (int i = 0; i < min && !compiler->reason; i++) {
+    pattern_fragment copy = pattern_build(compiler, child);
+    pattern_link(compiler, end, copy.start);
+    end = copy.end;
+  }
+
+  int exit = pattern_state_new(compiler, -1, -1, -1);
+  if (max < 0) {
+    // a loop, through the child or straight on
+    pattern_fragment copy = pattern_build(compiler, child);
+    int loop = pattern_state_new(compiler, -1, copy.start, exit);
+    pattern_link(compiler, end, loop);
+    pattern_link(compiler, copy.end, loop);
+    return (pattern_fragment){ start, exit };
+  }
+
+  // each optional copy is only reachable through the one before it,
+  // so 'x{0,3}' is '(x(x(x)?)?)?' and its DFA stays a short chain
+  for (int i = min; i < max && !compiler->reason; i++) {
+    pattern_fragment copy = pattern_build(compiler, child);
+    pattern_link(compiler, end, copy.start);
+    pattern_link(compiler, end, exit);
+    end = copy.end;
+  }
+  pattern_link(compiler, end, exit);
+  return (pattern_fragment){ start, exit };
+}
+
+// Thompson's construction: an NFA fragment for the node at [index]
+static pattern_fragment pattern_build(pattern_compiler *compiler, int index) {
+  pattern_node node = compiler->nodes[index];
+
+  switch (node.kind) {
+    case PATTERN_SET: {
+      int end = pattern_state_new(compiler, -1, -1, -1);
+      int start = pattern_state_new(compiler, index, end, -1);
+      return (pattern_fragment){ start, end };
+    }
+    case PATTERN_CONCAT: {
+      pattern_fragment left = pattern_build(compiler, node.left);
+      pattern_fragment right = pattern_build(compiler, node.right);
+      pattern_link(compiler, left.end, right.start);
+      return (pattern_fragment){ left.start, right.end };
+    }
+    case PATTERN_ALTERNATE: {
+      pattern_fragment left = pattern_build(compiler, node.left);
+      pattern_fragment right = pattern_build(compiler, node.right);
+      int start = pattern_state_new(compiler, -1, left.start, right.start);
+      int end = pattern_state_new(compiler, -1, -1, -1);
+      pattern_link(compiler, left.end, end);
+      pattern_link(compiler, right.end, end);
+      return (pattern_fragment){ start, end };
+    }
+    case PATTERN_REPEAT:
+      return pattern_build_repeat(compiler, node.left, node.min, node.max);
+    default: {
+      int state = pattern_state_new(compiler, -1, -1, -1);
+      return (pattern_fragment){ state, state };
+    }
+  }
+}
+
+// splits the bytes into columns: two bytes share one unless some set
+// holds one and not the other. returns the column count.
+static int pattern_columns(pattern_compiler *compiler, uint8_t *columns) {
+  memset(columns, 0, 256);
+  int count = 1;
+
+  for (int i = 0; i < compiler->node_count; i++) {
+    pattern_node *node = &compiler->nodes[i];
+    if (node->kind != PATTERN_SET) continue;
+
+    // (old column, in the set) -> new column
+    int split[512];
+    for (int j = 0; j < 2 * count; j++) split[j] = -1;
+
+    count = 0;
+    for (int byte = 0; byte < 256; byte++) {
+      int key = columns[byte] * 2 + byte_set_test(node->bytes, byte);
+      if (split[key] < 0) split[key] = count++;
+      columns[byte] = split[key];
+    }
+  }
+
+  return count;
+}
+
+// adds every state reachable from [set] without reading a byte
+static void pattern_closure(pattern_compiler *compiler, uint64_t *set, int words, int *stack) {
+  int top = 0;
+  for (int word = 0; word < words; word++) {
+    for (uint64_t bits = set[word]; bits; bits &= bits - 1) {
+      stack[top++] = word * 64 + __builtin_ctzll(bits);
+    }
+  }
+
+  while (top > 0) {
+    pattern_nfa_state *state = &compiler->states[stack[--top]];
+    if (state->node >= 0) continue;
+
+    int targets[2] = { state->next, state->other };
+    for (int i = 0; i < 2; i++) {
+      int target = targets[i];
+      if (target < 0 || byte_set_test(set, target)) continue;
+      set[target >> 6] |= 1ULL << (target & 63);
+      stack[top++] = target;
+    }
+  }
+}
+
+// the DFA while it's built: states are sets of NFA states, [words] each
+typedef struct {
+  int words;
+  int column_count;
+  uint64_t *sets;
+  uint16_t *next;
+  int count;
+  int capacity;
+} pattern_dfa;
+
+// the state for [set], added if it's new. -1 once there are too many
+static int pattern_dfa_state(pattern_dfa *dfa, const uint64_t *set) {
+  size_t set_bytes = sizeof(uint64_t) * dfa->words;
+  for (int state = 0; state < dfa->count; state++) {
+    if (!memcmp(dfa->sets + (size_t)state * dfa->words, set, set_bytes)) return state;
+  }
+
+  if (dfa->count == PATTERN_MAX_DFA_STATES) return -1;
+  if (dfa->count == dfa->capacity) {
+    dfa->capacity = GROW_ARRAY_CAPACITY(dfa->capacity);
+    dfa->sets = mem_realloc(CCLI_MEMORY_SCHEMA, dfa->sets, set_bytes * dfa->capacity);
+    dfa->next = mem_realloc(CCLI_MEMORY_SCHEMA, dfa->next, sizeof(uint16_t) * dfa->column_count * dfa->capacity);
+  }
+
+  memcpy(dfa->sets + (size_t)dfa->count * dfa->words, set, set_bytes);
+  memset(dfa->next + (size_t)dfa->count * dfa->column_count, 0, sizeof(uint16_t) * dfa->column_count);
+  return dfa->count++;
+}
+
+// Moore's partition refinement: merges the states no value can tell
+// apart, into the finished pattern. [accept] is the NFA's final state.
+static value_pattern *pattern_minimize(pattern_dfa *dfa, const uint8_t *columns, int accept, const char *source) {
+  int column_count = dfa->column_count;
+  int *block = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(int) * dfa->count);
+  int *refined = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(int) * dfa->count);
+  for (int state = 0; state < dfa->count; state++) {
+    block[state] = byte_set_test(dfa->sets + (size_t)state * dfa->words, accept);
+  }
+
+  // split blocks until every state in one moves to the same blocks on
+  // every column. the dead state comes first, so it stays state 0.
+  int block_count = -1;
+  for (;;) {
+    int refined_count = 0;
+    for (int state = 0; state < dfa->count; state++) {
+      const uint16_t *row = dfa->next + state * column_count;
+      int other = 0;
+      for (; other < state; other++) {
+        if (block[other] != block[state]) continue;
+
+        const uint16_t *other_row = dfa->next + other * column_count;
+        int column = 0;
+        while (column < column_count && block[other_row[column]] == block[row[column]]) column++;
+        if (column == column_count) break;
+      }
+      refined[state] = (other < state) ? refined[other] : refined_count++;
+    }
+
+    int *swap = block;
+    block = refined;
+    refined = swap;
+    if (refined_count == block_count) break;
+    block_count = refined_count;
+  }
+
+  value_pattern *pattern = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(value_pattern));
+  pattern->source = mem_strdup(CCLI_MEMORY_SCHEMA, source);
+  memcpy(pattern->columns, columns, sizeof(pattern->columns));
+  pattern->column_count = column_count;
+  pattern->start = block[1];
+  pattern->next = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(uint16_t) * column_count * block_count);
+  pattern->accepting = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(bool) * block_count);
+  for (int state = 0; state < dfa->count; state++) {
+    int to = block[state];
+    for (int column = 0; column < column_count; column++) {
+      pattern->next[to * column_count + column] = block[dfa->next[state * column_count + column]];
+    }
+    pattern->accepting[to] = byte_set_test(dfa->sets + (size_t)state * dfa->words, accept);
+  }
+
+  mem_free(block);
+  mem_free(refined);
+  return pattern;
+}
+
+// subset construction: a DFA state per set of NFA states some prefix
+// of a value can leave the NFA in
+static value_pattern *pattern_build_dfa(pattern_compiler *compiler, pattern_fragment nfa, const char *source) {
+  uint8_t columns[256];
+  int column_count = pattern_columns(compiler, columns);
+  int representative[256];
+  for (int byte = 255; byte >= 0; byte--) representative[columns[byte]] = byte;
+
+  pattern_dfa dfa = { (compiler->state_count + 63) / 64, column_count, NULL, NULL, 0, 0 };
+  int words = dfa.words;
+  int *stack = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(int) * compiler->state_count);
+  uint64_t *moved = mem_calloc(CCLI_MEMORY_SCHEMA, words, sizeof(uint64_t));
+
+  // the empty set is the dead state, 0, and the start state comes next
+  pattern_dfa_state(&dfa, moved);
+  moved[nfa.start >> 6] |= 1ULL << (nfa.start & 63);
+  pattern_closure(compiler, moved, words, stack);
+  pattern_dfa_state(&dfa, moved);
+
+  for (int state = 1; state < dfa.count && !compiler->reason; state++) {
+    for (int column = 0; column < column_count; column++) {
+      const uint64_t *set = dfa.sets + (size_t)state * words;
+      int byte = representative[column];
+      memset(moved, 0, sizeof(uint64_t) * words);
+      for (int word = 0; word < words; word++) {
+        for (uint64_t bits = set[word]; bits; bits &= bits - 1) {
+          pattern_nfa_state *from = &compiler->states[word * 64 + __builtin_ctzll(bits)];
+          if (from->node >= 0 && byte_set_test(compiler->nodes[from->node].bytes, byte)) {
+            moved[from->next >> 6] |= 1ULL << (from->next & 63);
+          }
+        }
+      }
+      pattern_closure(compiler, moved, words, stack);
+
+      int target = pattern_dfa_state(&dfa, moved);
+      if (target < 0) {
+        pattern_fail(compiler, "pattern needs too many states");
+        break;
+      }
+      dfa.next[state * column_count + column] = target;
+    }
+  }
+
+  value_pattern *pattern = NULL;
+  if (!compiler->reason) pattern = pattern_minimize(&dfa, columns, nfa.end, source);
+
+  mem_free(stack);
+  mem_free(moved);
+  mem_free(dfa.sets);
+  mem_free(dfa.next);
+  return pattern;
+}
+
+// returns NULL, with [reason] set, if [source] isn't a valid pattern
+static value_pattern *value_pattern_compile(const char *source, const char **reason) {
+  // the whole value has to match anyway, so '^' and '$' anchors are
+  // allowed at the ends, and ignored
+  size_t length = strlen(source);
+  size_t start = (source[0] == '^');
+  if (length > start && source[length - 1] == '$' && (length < 2 || source[length - 2] != '\\')) length--;
+  char *text = mem_strndup(CCLI_MEMORY_SCHEMA, source + start, length - start);
+
+  pattern_compiler compiler = { .text = text };
+  int root = pattern_parse_alternate(&compiler);
+  // only an unmatched ')' stops the top level early
+  if (root >= 0 && *compiler.text) pattern_fail(&compiler, "unmatched ')'");
+
+  value_pattern *pattern = NULL;
+  if (!compiler.reason) {
+    pattern_fragment nfa = pattern_build(&compiler, root);
+    if (!compiler.reason) pattern = pattern_build_dfa(&compiler, nfa, source);
+  }
+
+  *reason = compiler.reason;
+  mem_free(compiler.nodes);
+  mem_free(compiler.states);
+  mem_free(text);
+  return pattern;
+}
+
+/******************** ccli_arg ********************/
+
+struct ccli_arg {
+  char *name;
+  char *description;
+  ccli_value_type type;
+  ccli_value value;
+  ccli_unit unit;
+  // NULL unless it's of a custom type
+  typed_slot *slot;
+};
+
+static ccli_arg *ccli_arg_new(char *name, ccli_value_type type) {
+  ccli_arg *arg = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(ccli_arg));
+  arg->name = name;
+  arg->description = NULL;
+  arg->type = type;
+  arg->value = NULL_VAL;
+  arg->unit = CCLI_UNIT_NONE;
+  arg->slot = NULL;
+  return arg;
+}
+
+static void ccli_arg_free(ccli_arg *arg) {
+  if (IS_RANGE(arg->value)) range_list_free(AS_RANGE(arg->value));
+  if (IS_FILE(arg->value)) file_free(AS_FILE(arg->value));
+  mem_free(arg->slot);
+  mem_free(arg);
+}
+
+void ccli_arg_set_description(ccli_arg *arg, char *description) {
+    arg->description = description;
+}
+
+void ccli_arg_set_unit(ccli_arg *arg, ccli_unit unit) {
+  if (arg->type != VAL_INT64 && arg->type != VAL_UINT64) {
+    error("units only apply to int64 and uint64 arguments.");
+  }
+
+  arg->unit = unit;
+}
+
+/******************** arg_array ********************/
+
+typedef struct {
+  int size;
+  int capacity;
+  ccli_arg **args;
+} arg_array;
+
+static void arg_array_init(arg_array *array) {
+  array->size = 0;
+  array->capacity = 0;
+  array->args = NULL;
+}
+
+static void arg_array_free(arg_array *array) {
+  for (int i = 0; i < array->size; i++) {
+    ccli_arg_free(array->args[i]);
+  }
+
+  mem_free(array->args);
+
+  arg_array_init(array);
+}
+
+static void arg_array_add(arg_array *array, ccli_arg *arg) {
+  if (array->size + 1 > array->capacity) {
+    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
+    array->args = mem_realloc(CCLI_MEMORY_SCHEMA, array->args, sizeof(ccli_arg *) * array->capacity);
+  }
+
+  array->args[array->size++] = arg;
+}
+
+/******************** ccli_option ********************/
+
+struct ccli_option {
+  char *long_option;
+  char *short_option;
+  char *description;
+  ccli_value_type type;
+  ccli_value value;
+  // what [value] goes back to before each ccli_invoke
+  ccli_value default_value;
+  ccli_unit unit;
+  // position in the owning command's option list, and its bit in
+  // the command's presence/constraint bitsets
+  int index;
+  ccli_command *command;
+  choice_table choices;
+  // items of VAL_STRING_LIST (char *) and VAL_NUM_LIST (double) options
+  value_vector values;
+  // for VAL_TYPED options: where parsed values go, and the default
+  typed_slot *slot;
+  typed_slot *default_slot;
+  // NULL unless values have to match a pattern
+  value_pattern *pattern;
+};
+
+static ccli_option *ccli_option_new(char *double_dash_option, char *single_dash_option, ccli_value_type type) {
+  ccli_option *option = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(ccli_option));
+  option->long_option = double_dash_option;
+  option->short_option = single_dash_option;
+  option->description = NULL;
+  option->type = type;
+  option->value = NULL_VAL;
+  option->unit = CCLI_UNIT_NONE;
+  option->index = -1;
+  option->command = NULL;
+  option->slot = NULL;
+  option->default_slot = NULL;
+  option->pattern = NULL;
+  choice_table_init(&option->choices);
+  value_vector_init(&option->values, (type == VAL_NUM_LIST) ? sizeof(double) : sizeof(char *));
+
+  // counters always have a value, so reading one never fails
+  if (type == VAL_COUNTER) option->value = NUM_VAL(0);
+  option->default_value = option->value;
+  return option;
+}
+
+// drop what the last run parsed, back to the option's default
+static void ccli_option_reset(ccli_option *option) {
+  if (IS_RANGE(option->value)) range_list_free(AS_RANGE(option->value));
+  if (IS_FILE(option->value)) file_free(AS_FILE(option->value));
+  option->value = option->default_value;
+  option->values.size = 0;
+}
+
+static void ccli_option_free(ccli_option *option) {
+  choice_table_free(&option->choices);
+  value_vector_free(&option->values);
+  if (IS_RANGE(option->value)) range_list_free(AS_RANGE(option->value));
+  if (IS_FILE(option->value)) file_free(AS_FILE(option->value));
+  mem_free(option->slot);
+  mem_free(option->default_slot);
+  value_pattern_free(option->pattern);
+  mem_free(option);
+}
+
+void ccli_option_set_description(ccli_option *option, char *description) {
+  option->description = description;
+}
+
+// functions to set default values
+
+void ccli_option_set_default_number(ccli_option *option, double value) {
+  if (option->type != VAL_NUM) {
+    error("can't set default number on a non-number type.");
+  }
+
+  option->value = option->default_value = NUM_VAL(value);
+}
+
+void ccli_option_set_default_bool(ccli_option *option, bool value) {
+  if (option->type != VAL_BOOL) {
+    error("can't set default bool on a non-bool type.");
+  }
+
+  option->value = option->default_value = BOOL_VAL(value);
+}
+
+void ccli_option_set_default_string(ccli_option *option, char *value) {
+  if (option->type != VAL_STRING) {
+    error("can't set default string on a non-string type");
+  }
+
+  option->value = option->default_value = STRING_VAL(value);
+}
+
+void ccli_option_set_default_int64(ccli_option *option, int64_t value) {
+  if (option->type != VAL_INT64) {
+    error("can't set default int64 on a non-int64 type.");
+  }
+
+  option->value = option->default_value = INT64_VAL(value);
+}
+
+void ccli_option_set_default_uint64(ccli_option *option, uint64_t value) {
+  if (option->type != VAL_UINT64) {
+    error("can't set default uint64 on a non-uint64 type.");
+  }
+
+  option->value = option->default_value = UINT64_VAL(value);
+}
+
+void ccli_option_set_default_typed(ccli_option *option, const void *value) {
+  if (option->type != VAL_TYPED) {
+    error("can't set a typed default on an option without a custom type.");
+  }
+
+  if (!option->default_slot) option->default_slot = typed_slot_new(option->slot->type);
+  memcpy(option->default_slot->data, value, option->slot->type->size);
+  option->value = option->default_value = TYPED_VAL(option->default_slot);
+}
+
+void ccli_option_set_unit(ccli_option *option, ccli_unit unit) {
+  if (option->type != VAL_INT64 && option->type != VAL_UINT64) {
+    error("units only apply to int64 and uint64 options.");
+  }
+
+  option->unit = unit;
+}
+
+void ccli_option_set_pattern(ccli_option *option, char *pattern) {
+  if (option->type != VAL_STRING && option->type != VAL_STRING_LIST) {
+    error("patterns only apply to string and string list options.");
+  }
+
+  const char *reason = NULL;
+  value_pattern *compiled = value_pattern_compile(pattern, &reason);
+  if (!compiled) {
+    error("invalid pattern for '%s': '%s' (%s).", option->long_option, pattern, reason);
+  }
+
+  value_pattern_free(option->pattern);
+  option->pattern = compiled;
+}
+
+void ccli_option_set_default_choice(ccli_option *option, int choice) {
+  if (option->type != VAL_CHOICE) {
+    error("can't set default choice on a non-choice type.");
+  } else if (choice < 0 || choice >= option->choices.count) {
+    error("invalid default choice: %d.", choice);
+  }
+
+  option->value = option->default_value = CHOICE_VAL(choice);
+}
+
+/******************** option_array ********************/
+
+typedef struct {
+  int size;
+  int capacity;
+  ccli_option **options;
+} option_array;
+
+static void option_array_init(option_array *array) {
+  array->size = 0;
+  array->capacity = 0;
+  array->options = NULL;
+}
+
+static void option_array_free(option_array *array) {
+  for (int i = 0; i < array->size; i++) {
+    ccli_option_free(array->options[i]);
+  }
+
+  mem_free(array->options);
+  option_array_init(array);
+}
+
+static void option_array_add(option_array *array, ccli_option *option) {
+  if (array->size + 1 > array->capacity) {
+    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
+    array->options = mem_realloc(CCLI_MEMORY_SCHEMA, array->options, sizeof(ccli_option *) * array->capacity);
+  }
+
+  array->options[array->size++] = option;
+}
+
+/******************** option_constraint ********************/
+
+// every constraint is compiled down to a bitmask over option indices,
+// so validating a parsed command is a handful of word operations.
+//
+// CONSTRAINT_EXCLUSIVE: at most one member of [mask] may be present
+//                       (a conflict between two options is a group of two).
+// CONSTRAINT_REQUIRES:  if [option] is present, all of [mask] must be too.
+typedef enum {
+  CONSTRAINT_EXCLUSIVE,
+  CONSTRAINT_REQUIRES
+} constraint_type;
+
+typedef struct {
+  constraint_type type;
+  int option;
+  ccli_bitset mask;
+} option_constraint;
+
+typedef struct {
+  int size;
+  int capacity;
+  option_constraint *constraints;
+} constraint_array;
+
+static void constraint_array_init(constraint_array *array) {
+  array->size = 0;
+  array->capacity = 0;
+  array->constraints = NULL;
+}
+
+static void constraint_array_free(constraint_array *array) {
+  for (int i = 0; i < array->size; i++) {
+    bitset_free(&array->constraints[i].mask);
+  }
+
+  mem_free(array->constraints);
+  constraint_array_init(array);
+}
+
+static option_constraint *constraint_array_add(constraint_array *array, constraint_type type, int option) {
+  if (array->size + 1 > array->capacity) {
+    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
+    array->constraints = mem_realloc(CCLI_MEMORY_SCHEMA, array->constraints, sizeof(option_constraint) * array->capacity);
+  }
+
+  option_constraint *constraint = &array->constraints[array->size++];
+  constraint->type = type;
+  constraint->option = option;
+  bitset_init(&constraint->mask);
+  return constraint;
+}
+
+/******************** ccli_table ********************/
+
+// tuning
+#define TABLE_MAX_LOAD 0.75
+
+typedef struct {
+  char *chars;
+  uint32_t hash;
+} table_string;
+
+uint32_t hash_string(const char *key) {
+  uint32_t hash = 2166136261u;
+
+  for (int i = 0; i < strlen(key); i++) {
+    hash ^= key[i];
+    hash *= 16777619;
+  }
+
+  return hash;
+}
+
+table_string *table_string_new(char *chars) {
+  table_string *string = mem_alloc(CCLI_MEMORY_KEYS, sizeof(table_string));
+  string->chars = chars;
+  string->hash = hash_string(chars);
+  return string;
+}
+
+typedef struct {
+  table_string *key;
+  ccli_option *option;
+} table_entry;
+
+typedef struct {
+  table_entry *entries;
+  int count;
+  int capacity;
+} ccli_table;
+
+void ccli_table_init(ccli_table *table) {
+  table->capacity = 0;
+  table->count = 0;
+  table->entries = NULL;
+}
+
+void ccli_table_free(ccli_table *table) {
+  for (int i = 0; i < table->capacity; i++) {
+    // the options are owned by the command's option list, since
+    // an option with a short alias has two entries here
+    table_string *string = table->entries[i].key;
+    if (string) mem_free(string);
+  }
+
+  mem_free(table->entries);
+  ccli_table_init(table);
+}
+
+// find an entry or its respective spot in the table
+static table_entry *ccli_table_find_entry(table_entry *entries, int capacity, table_string *key) {
+  if (!entries) return NULL;
+
+  uint32_t index = key->hash % capacity;
+  table_entry *tombstone = NULL;
+
+  for (;;) {
+    table_entry *entry = &entries[index];
+
+    if (!entry->key) {
+      if (!entry->option) {
+        // empty entry, return tombstone entry if found
+        return (tombstone != NULL) ? tombstone : entry;
+      } else {
+        // found a tombstone
+        if (!tombstone) tombstone = entry;
+      }
+    } else if (entry->key == key) {
+      // found the key
+      return entry;
+    }
+
+    index = (index + 1) % capacity;
+  }
+}
+
+static void ccli_table_adjust_capacity(ccli_table *table, int capacity) {
+  table_entry *entries = mem_alloc(CCLI_MEMORY_KEYS, sizeof(table_entry) * capacity);
+  for (int i = 0; i < capacity; i++) {
+    entries[i].key = NULL;
+    entries[i].option = NULL;
+  }
+
+  // don't copy over tombstones, reset and reconstruct the table
+  table->count = 0;
+  for (int i = 0; i < table->capacity; i++) {
+    table_entry *entry = &table->entries[i];
+
+    // disregard tombstones and empty slots
+    if (!entry->key) continue;
+
+    table_entry *dest = ccli_table_find_entry(entries, capacity, entry->key);
+    dest->key = entry->key;
+    dest->option = entry->option;
+    table->count++;
+  }
+
+  mem_free(table->entries);
+
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+bool ccli_table_get(ccli_table *table, table_string *key, ccli_option **option) {
+  if (!table->entries) return false;
+
+  table_entry *entry = ccli_table_find_entry(table->entries, table->capacity, key);
+  if (!entry->key) return false;
+
+  *option = entry->option;
+  return true;
+}
+
+static bool ccli_table_set(ccli_table *table, table_string *key, ccli_option *option) {
+  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
+    int capacity = GROW_ARRAY_CAPACITY(table->capacity);
+    ccli_table_adjust_capacity(table, capacity);
+  }
+
+  table_entry *entry = ccli_table_find_entry(table->entries, table->capacity, key);
+
+  bool isNewKey = (entry->key == NULL);
+  // increment count if it isn't a real value or a tombstone
+  if (isNewKey && !entry->option) table->count++;
+
+  entry->key = key;
+  entry->option = option;
+  return isNewKey;
+}
+
+static table_string *ccli_table_find_string(ccli_table *table, const char *chars) {
+  if (!table->entries) return NULL;
+
+  uint32_t hash = hash_string(chars);
+
+  uint32_t index = hash % table->capacity;
+
+  for (;;) {
+    table_entry *entry = &table->entries[index];
+    if (!entry->key) {
+      // stop if we find an empty, non-tombstone entry
+      if (!entry->option) return NULL;
+    } else if (!strcmp(entry->key->chars, chars)) {
+      return entry->key;
+    }
+
+    index = (index + 1) % table->capacity;
+  }
+}
+
+// look up an option by its long or short name, or NULL if it doesn't exist
+static ccli_option *ccli_table_find_option(ccli_table *table, const char *name) {
+  ccli_option *option = NULL;
+  table_string *string = ccli_table_find_string(table, name);
+  if (string && ccli_table_get(table, string, &option)) return option;
+
+  return NULL;
+}
+
+bool ccli_table_get_int(ccli_table *table, char *name, int *value) {
+  ccli_option *option = NULL;
+  table_string *string = ccli_table_find_string(table, name);
+  if (string && ccli_table_get(table, string, &option)) {
+    if (IS_NUM(option->value)) {
+      *value = AS_INT(option->value);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ccli_table_get_double(ccli_table *table, char *name, double *value) {
+  ccli_option *option = NULL;
+  table_string *string = ccli_table_find_string(table, name);
+  if (string && ccli_table_get(table, string, &option)) {
+    if (IS_NUM(option->value)) {
+      *value = AS_DOUBLE(option->value);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ccli_table_get_bool(ccli_table *table, char *name, bool *value) {
+  ccli_option *option = NULL;
+  table_string *string = ccli_table_find_string(table, name);
+  if (string && ccli_table_get(table, string, &option)) {
+    if (IS_BOOL(option->value)) {
+      *value = AS_BOOL(option->value);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ccli_table_get_choice(ccli_table *table, char *name, int *value) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && IS_CHOICE(option->value)) {
+    *value = AS_CHOICE(option->value);
+    return true;
+  }
+
+  return false;
+}
+
+// list items are handed out in place, without copying
+static bool ccli_table_get_list(ccli_table *table, char *name, ccli_value_type type, void **values, int *count) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && option->type == type) {
+    *values = value_vector_items(&option->values);
+    *count = option->values.size;
+    return true;
+  }
+
+  return false;
+}
+
+bool ccli_table_get_int64(ccli_table *table, char *name, int64_t *value) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && IS_INT64(option->value)) {
+    *value = AS_INT64(option->value);
+    return true;
+  }
+
+  return false;
+}
+
+bool ccli_table_get_uint64(ccli_table *table, char *name, uint64_t *value) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && IS_UINT64(option->value)) {
+    *value = AS_UINT64(option->value);
+    return true;
+  }
+
+  return false;
+}
+
+bool ccli_table_get_file(ccli_table *table, char *name, ccli_file **value) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && IS_FILE(option->value)) {
+    *value = AS_FILE(option->value);
+    return true;
+  }
+
+  return false;
+}
+
+bool ccli_table_get_typed(ccli_table *table, char *name, ccli_type *type, const void **value) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && IS_TYPED(option->value) && AS_TYPED(option->value)->type == type) {
+    *value = AS_TYPED(option->value)->data;
+    return true;
+  }
+
+  return false;
+}
+
+bool ccli_table_get_range(ccli_table *table, char *name, ccli_range_list **value) {
+  ccli_option *option = ccli_table_find_option(table, name);
+  if (option && IS_RANGE(option->value)) {
+    *value = AS_RANGE(option->value);
+    return true;
+  }
+
+  return false;
+}
+
+bool ccli_table_get_string(ccli_table *table, char *name, char **value) {
+  ccli_option *option = NULL;
+  table_string *string = ccli_table_find_string(table, name);
+  if (string && ccli_table_get(table, string, &option)) {
+    if (IS_STRING(option->value)) {
+      *value = AS_STRING(option->value);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/******************** ccli_command ********************/
+
+typedef struct plugin_library plugin_library;
+
+struct ccli_command {
+  char *command;
+  char *description;
+  ccli_command_callback callback;
+  ccli_table options;
+  arg_array args;
+  // options in registration order, indexed by [ccli_option.index]
+  option_array option_list;
+  // options that were given on the command line
+  ccli_bitset present;
+  ccli_bitset required;
+  constraint_array constraints;
+  // results are kept in the cache (see ccli_command_set_cacheable)
+  bool cacheable;
+  // set for a plugin's commands. they're stubs, with no callback, until
+  // the plugin is loaded
+  plugin_library *plugin;
+};
+
+static ccli_command *ccli_command_new(char *command, ccli_command_callback callback) {
+  ccli_command *_command = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(ccli_command));
+  _command->command = command;
+  _command->description = NULL;
+  _command->callback = callback;
+  ccli_table_init(&_command->options);
+  arg_array_init(&_command->args);
+  option_array_init(&_command->option_list);
+  bitset_init(&_command->present);
+  bitset_init(&_command->required);
+  constraint_array_init(&_command->constraints);
+  _command->cacheable = false;
+  _command->plugin = NULL;
+  return _command;
+}
+
+static void ccli_command_free(ccli_command *command) {
+  ccli_table_free(&command->options);
+  arg_array_free(&command->args);
+  option_array_free(&command->option_list);
+  bitset_free(&command->present);
+  bitset_free(&command->required);
+  constraint_array_free(&command->constraints);
+  mem_free(command);
+}
+
+void ccli_command_set_description(ccli_command *command, char *description) {
+  command->description = description;
+}
+
+void ccli_command_set_cacheable(ccli_command *command, bool cacheable) {
+  command->cacheable = cacheable;
+}
+
+ccli_arg *ccli_command_add_number_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_NUM);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_bool_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_BOOL);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_string_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_STRING);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_int64_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_INT64);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_uint64_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_UINT64);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_file_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_FILE);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_typed_arg(ccli_command *command, char *name, ccli_type *type) {
+  if (!type) {
+    error("typed argument '%s' needs a type.", name);
+  }
+
+  ccli_arg *arg = ccli_arg_new(name, VAL_TYPED);
+  arg->slot = typed_slot_new(type);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_arg *ccli_command_add_range_arg(ccli_command *command, char *name) {
+  ccli_arg *arg = ccli_arg_new(name, VAL_RANGE_LIST);
+  arg_array_add(&command->args, arg);
+  return arg;
+}
+
+ccli_option *ccli_command_add_option(ccli_command *command, char *double_dash_option,
+                             char *single_dash_option, ccli_value_type type) {
+  // TODO: implement global options
+  // TODO: allow single dash options on their own, too
+  if (!command || !double_dash_option) return NULL;
+
+  ccli_option *option = ccli_option_new(double_dash_option, single_dash_option, type);
+  option->command = command;
+  option->index = command->option_list.size;
+  option_array_add(&command->option_list, option);
+
+  table_string *string = ccli_table_find_string(&command->options, double_dash_option);
+  ccli_table_set(&command->options, (string) ? string : table_string_new(double_dash_option), option);
+
+  if (single_dash_option) {
+    string = ccli_table_find_string(&command->options, single_dash_option);
+    ccli_table_set(&command->options, (string) ? string : table_string_new(single_dash_option), option);
+  }
+
+  return option;
+}
+
+//TODO: global options
+ccli_option *ccli_add_number_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_NUM);
+}
+
+ccli_option *ccli_add_bool_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_BOOL);
+}
+
+ccli_option *ccli_add_string_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_STRING);
+}
+
+ccli_option *ccli_add_empty_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_NULL);
+}
+
+ccli_option *ccli_add_choice_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option,
+                                    char **choices, int count) {
+  if (!choices || count <= 0) {
+    error("choice option '%s' needs at least one choice.", double_dash_option);
+  }
+
+  ccli_option *option = ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_CHOICE);
+  if (option) choice_table_build(&option->choices, choices, count);
+  return option;
+}
+
+ccli_option *ccli_add_int64_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_INT64);
+}
+
+ccli_option *ccli_add_uint64_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_UINT64);
+}
+
+ccli_option *ccli_add_file_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_FILE);
+}
+
+ccli_option *ccli_add_typed_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option,
+                                    ccli_type *type) {
+  if (!type) {
+    error("typed option '%s' needs a type.", double_dash_option);
+  }
+
+  ccli_option *option = ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_TYPED);
+  if (option) option->slot = typed_slot_new(type);
+  return option;
+}
+
+ccli_option *ccli_add_range_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_RANGE_LIST);
+}
+
+ccli_option *ccli_add_string_list_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_STRING_LIST);
+}
+
+ccli_option *ccli_add_number_list_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_NUM_LIST);
+}
+
+ccli_option *ccli_add_counter_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option) {
+  return ccli_command_add_option(command, double_dash_option, single_dash_option, VAL_COUNTER);
+}
+
+/******************** option constraints ********************/
+
+static void check_same_command(ccli_option *a, ccli_option *b) {
+  if (a->command != b->command) {
+    error("options '%s' and '%s' belong to different commands.", a->long_option, b->long_option);
+  }
+}
+
+void ccli_option_set_required(ccli_option *option, bool required) {
+  if (required) {
+    bitset_set(&option->command->required, option->index);
+  } else {
+    bitset_unset(&option->command->required, option->index);
+  }
+}
+
+void ccli_options_conflict(ccli_option *a, ccli_option *b) {
+  check_same_command(a, b);
+
+  option_constraint *constraint = constraint_array_add(&a->command->constraints, CONSTRAINT_EXCLUSIVE, a->index);
+  bitset_set(&constraint->mask, a->index);
+  bitset_set(&constraint->mask, b->index);
+}
+
+void ccli_option_requires(ccli_option *option, ccli_option *required) {
+  check_same_command(option, required);
+
+  option_constraint *constraint = constraint_array_add(&option->command->constraints, CONSTRAINT_REQUIRES, option->index);
+  bitset_set(&constraint->mask, required->index);
+}
+
+void ccli_options_exclusive(ccli_option **options, int count) {
+  if (count < 2) return;
+
+  for (int i = 1; i < count; i++) {
+    check_same_command(options[0], options[i]);
+  }
+
+  option_constraint *constraint = constraint_array_add(&options[0]->command->constraints, CONSTRAINT_EXCLUSIVE, options[0]->index);
+  for (int i = 0; i < count; i++) {
+    bitset_set(&constraint->mask, options[i]->index);
+  }
+}
+
+/********** command_array **********/
+
+// commands in registration order, and a hash index over their names:
+// open addressing, each slot holding a position in [commands] plus one,
+// or 0 if it's empty
+#define COMMAND_INDEX_MIN_CAPACITY 16
+
+typedef struct {
+  int size;
+  int capacity;
+  ccli_command **commands;
+  int *index;
+  int index_capacity;
+} command_array;
+
+static void command_array_init(command_array *array) {
+  array->size = 0;
+  array->capacity = 0;
+  array->commands = NULL;
+  array->index = NULL;
+  array->index_capacity = 0;
+}
+
+static void command_array_free(command_array *array) {
+  for (int i = 0; i < array->size; i++) {
+    ccli_command_free(array->commands[i]);
+  }
+
+  mem_free(array->commands);
+  mem_free(array->index);
+
+  command_array_init(array);
+}
+
+// the slot holding [name], or the empty one it would go in
+static int *command_array_slot(command_array *array, const char *name) {
+  uint32_t mask = array->index_capacity - 1;
+  for (uint32_t slot = hash_string(name) & mask;; slot = (slot + 1) & mask) {
+    int position = array->index[slot];
+    if (!position || !strcmp(array->commands[position - 1]->command, name)) return &array->index[slot];
+  }
+}
+
+// indexes the command at [position]. a name registered twice keeps
+// finding the first command, as before the index
+static void command_array_index(command_array *array, int position) {
+  int *slot = command_array_slot(array, array->commands[position]->command);
+  if (!*slot) *slot = position + 1;
+}
+
+static void command_array_add(command_array *array, ccli_command *command) {
+  if (array->size + 1 > array->capacity) {
+    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
+    array->commands = mem_realloc(CCLI_MEMORY_SCHEMA, array->commands, sizeof(ccli_command *) * array->capacity);
+  }
+
+  array->commands[array->size++] = command;
+
+  // kept at most half full, so probes stay short
+  if (array->size * 2 > array->index_capacity) {
+    mem_free(array->index);
+    array->index_capacity = array->index_capacity ? array->index_capacity * 2 : COMMAND_INDEX_MIN_CAPACITY;
+    array->index = mem_calloc(CCLI_MEMORY_KEYS, array->index_capacity, sizeof(int));
+    for (int i = 0; i < array->size; i++) command_array_index(array, i);
+  } else {
+    command_array_index(array, array->size - 1);
+  }
+}
+
+static ccli_command *command_array_find(command_array *array, const char *name) {
+  if (!array->index) return NULL;
+
+  int position = *command_array_slot(array, name);
+  return position ? array->commands[position - 1] : NULL;
+}
+
+/******************** command_hierarchy ********************/
+
+typedef struct command_hierarchy {
+  ccli_command *command;
+  struct command_hierarchy *next;
+  struct command_hierarchy *prev;
+} command_hierarchy;
+
+static command_hierarchy *command_hierarchy_new(ccli_command *command) {
+  command_hierarchy *hierarchy = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(command_hierarchy));
+  hierarchy->command = command;
+  hierarchy->next = NULL;
+  hierarchy->prev = NULL;
+  return hierarchy;
+}
+
+// free the current pointer and everything before it
+static void command_hierarchy_free(command_hierarchy *hierarchy) {
+  if (!hierarchy) return;
+
+  command_hierarchy *prev = hierarchy->prev;
+  mem_free(hierarchy);
+  command_hierarchy_free(prev);
+}
+
+static command_hierarchy *
+command_hierarchy_add(command_hierarchy *hierarchy, ccli_command *command) {
+  hierarchy->next = command_hierarchy_new(command);
+  hierarchy->next->prev = hierarchy;
+  return hierarchy->next;
+}
+
+/******************** async_output ********************/
+
+// an opt-in writer thread, so a slow reader on the other end of the
+// stream doesn't stall the callback.
+//
+// output is formatted into an open block, and full blocks are published
+// to a ring that the writer drains with writev. whoever holds
+// [open_lock] owns the open block and is the ring's only producer; when
+// the ring runs dry the writer takes the lock itself and publishes
+// whatever is pending, so a quiet program's output isn't held back.
+//
+// the ring itself is single-producer/single-consumer over atomic
+// [head] and [tail]. [lock] is only taken by a side that has to sleep,
+// and by the other side when it sees the sleeper's flag.
+#define ASYNC_BLOCK_BYTES (16 * 1024)
+#define ASYNC_RING_BYTES  (1024 * 1024)
+#define ASYNC_MAX_IOV     64
+// how long the writer lets output collect after being woken
+#define ASYNC_LINGER_NS   100000
+
+typedef struct {
+  FILE *fp;
+  ccli_backpressure policy;
+
+  // the block currently being filled
+  pthread_mutex_t open_lock;
+  ccli_buffer open;
+
+  int slot_count;
+  ccli_buffer *slots;
+  // blocks [tail, head) are waiting for the writer
+  _Atomic uint64_t head;
+  _Atomic uint64_t tail;
+  _Atomic uint64_t dropped;
+  // set when the open block has output the writer hasn't seen
+  _Atomic bool pending;
+
+  // only touched when one side has to sleep
+  pthread_mutex_t lock;
+  pthread_cond_t wake_writer;
+  pthread_cond_t wake_producer;
+  _Atomic bool producer_sleeping;
+  _Atomic bool writer_sleeping;
+  bool stopping;
+  pthread_t writer;
+} async_output;
+
+// false if the writes failed partway through
+static bool write_all(int fd, struct iovec *iov, int count) {
+  while (count > 0) {
+    ssize_t written = writev(fd, iov, count);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      // the reader went away, nothing more can be delivered
+      return false;
+    }
+
+    while (count > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+static bool async_ring_empty(async_output *async) {
+  return atomic_load(&async->tail) == atomic_load(&async->head);
+}
+
+static bool async_ring_full(async_output *async) {
+  return atomic_load(&async->head) - atomic_load(&async->tail) >= (uint64_t)async->slot_count;
+}
+
+// wake the writer if it's waiting for output. the flag is read after
+// [head] or [pending] is stored, and the writer stores it before
+// looking at them, so one side always sees the other.
+static void async_wake_writer(async_output *async) {
+  if (!atomic_load(&async->writer_sleeping)) return;
+
+  pthread_mutex_lock(&async->lock);
+  pthread_cond_signal(&async->wake_writer);
+  pthread_mutex_unlock(&async->lock);
+}
+
+// hand the open block to the writer, with [open_lock] held. [force]
+// waits for room even if the policy would rather grow or drop, so the
+// writer itself must never pass it with the ring full.
+static void async_publish(async_output *async, bool force) {
+  atomic_store(&async->pending, false);
+  if (async->open.size == 0) return;
+
+  while (async_ring_full(async)) {
+    if (!force && async->policy != CCLI_BACKPRESSURE_BLOCK) return;
+
+    pthread_mutex_lock(&async->lock);
+    atomic_store(&async->producer_sleeping, true);
+    while (async_ring_full(async)) {
+      pthread_cond_wait(&async->wake_producer, &async->lock);
+    }
+    atomic_store(&async->producer_sleeping, false);
+    pthread_mutex_unlock(&async->lock);
+  }
+
+  // swap the open block into the slot, and keep the slot's old
+  // allocation to fill next
+  uint64_t head = atomic_load(&async->head);
+  ccli_buffer *slot = &async->slots[head % async->slot_count];
+  ccli_buffer spare = *slot;
+  *slot = async->open;
+  async->open = spare;
+
+  atomic_store(&async->head, head + 1);
+  async_wake_writer(async);
+}
+
+static void *async_writer_run(void *arg) {
+  async_output *async = arg;
+  int fd = fileno(async->fp);
+  struct iovec iov[ASYNC_MAX_IOV];
+
+  for (;;) {
+    uint64_t tail = atomic_load(&async->tail);
+    uint64_t head = atomic_load(&async->head);
+
+    if (tail != head) {
+      int count = 0;
+      for (uint64_t i = tail; i < head && count < ASYNC_MAX_IOV; i++, count++) {
+        ccli_buffer *block = &async->slots[i % async->slot_count];
+        iov[count].iov_base = block->chars;
+        iov[count].iov_len = block->size;
+      }
+      write_all(fd, iov, count);
+
+      for (int i = 0; i < count; i++) {
+        async->slots[(tail + i) % async->slot_count].size = 0;
+      }
+      atomic_store(&async->tail, tail + count);
+
+      if (atomic_load(&async->producer_sleeping)) {
+        pthread_mutex_lock(&async->lock);
+        pthread_cond_signal(&async->wake_producer);
+        pthread_mutex_unlock(&async->lock);
+      }
+      continue;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    atomic_store(&async->writer_sleeping, true);
+    while (async_ring_empty(async) && !atomic_load(&async->pending) && !async->stopping) {
+      pthread_cond_wait(&async->wake_writer, &async->lock);
+    }
+    atomic_store(&async->writer_sleeping, false);
+    bool stopping = async->stopping;
+    pthread_mutex_unlock(&async->lock);
+
+    if (!async_ring_empty(async)) continue;
+    // [async_output_stop] publishes the last block itself
+    if (stopping) break;
+
+    // let a burst of output collect, then take it if the producer
+    // isn't in the middle of something. the burst may have filled the
+    // ring, and only this thread can make room, so drain it first.
+    struct timespec linger = { 0, ASYNC_LINGER_NS };
+    nanosleep(&linger, NULL);
+    if (pthread_mutex_trylock(&async->open_lock) == 0) {
+      if (!async_ring_full(async)) async_publish(async, true);
+      pthread_mutex_unlock(&async->open_lock);
+    }
+  }
+
+  return NULL;
+}
+
+static async_output *async_output_start(FILE *fp, ccli_backpressure policy, size_t ring_bytes) {
+  async_output *async = mem_alloc(CCLI_MEMORY_OUTPUT, sizeof(async_output));
+  async->fp = fp;
+  async->policy = policy;
+  // blocks are allocated up front and swapped between the producer
+  // and the ring, so steady-state output doesn't allocate
+  buffer_init(&async->open);
+  buffer_reserve(&async->open, ASYNC_BLOCK_BYTES);
+
+  if (ring_bytes == 0) ring_bytes = ASYNC_RING_BYTES;
+  async->slot_count = ring_bytes / ASYNC_BLOCK_BYTES;
+  if (async->slot_count < 4) async->slot_count = 4;
+  async->slots = mem_alloc(CCLI_MEMORY_OUTPUT, sizeof(ccli_buffer) * async->slot_count);
+  for (int i = 0; i < async->slot_count; i++) {
+    buffer_init(&async->slots[i]);
+    buffer_reserve(&async->slots[i], ASYNC_BLOCK_BYTES);
+  }
+
+  atomic_init(&async->head, 0);
+  atomic_init(&async->tail, 0);
+  atomic_init(&async->dropped, 0);
+  atomic_init(&async->pending, false);
+  atomic_init(&async->producer_sleeping, false);
+  atomic_init(&async->writer_sleeping, false);
+  async->stopping = false;
+  pthread_mutex_init(&async->open_lock, NULL);
+  pthread_mutex_init(&async->lock, NULL);
+  pthread_cond_init(&async->wake_writer, NULL);
+  pthread_cond_init(&async->wake_producer, NULL);
+  pthread_create(&async->writer, NULL, async_writer_run, async);
+  return async;
+}
+
+// true if there's room for more output under the drop policy, with
+// [open_lock] held
+static bool async_output_accepts(async_output *async) {
+  if (async->policy != CCLI_BACKPRESSURE_DROP) return true;
+  if (async->open.size < ASYNC_BLOCK_BYTES || !async_ring_full(async)) return true;
+
+  atomic_fetch_add(&async->dropped, 1);
+  return false;
+}
+
+// called after each piece of output, with [open_lock] held
+static void async_output_commit(async_output *async) {
+  if (async->open.size >= ASYNC_BLOCK_BYTES) {
+    async_publish(async, false);
+    return;
+  }
+
+  // only the first write after the writer last looked has to wake it
+  if (!atomic_load_explicit(&async->pending, memory_order_relaxed) && !atomic_exchange(&async->pending, true)) {
+    async_wake_writer(async);
+  }
+}
+
+// publish everything, wait for the writer to drain it, and stop it
+static void async_output_stop(async_output *async) {
+  pthread_mutex_lock(&async->open_lock);
+  async_publish(async, true);
+  pthread_mutex_unlock(&async->open_lock);
+
+  pthread_mutex_lock(&async->lock);
+  async->stopping = true;
+  pthread_cond_signal(&async->wake_writer);
+  pthread_mutex_unlock(&async->lock);
+  pthread_join(async->writer, NULL);
+
+  buffer_free(&async->open);
+  for (int i = 0; i < async->slot_count; i++) {
+    buffer_free(&async->slots[i]);
+  }
+  mem_free(async->slots);
+  pthread_mutex_destroy(&async->open_lock);
+  pthread_mutex_destroy(&async->lock);
+  pthread_cond_destroy(&async->wake_writer);
+  pthread_cond_destroy(&async->wake_producer);
+  mem_free(async);
+}
+
+/******************** ccli - main interface ********************/
+
+typedef struct trace_session trace_session;
+
+struct ccli {
+  char *exeName;
+  int argc;
+  int current_arg;
+  char **argv;
+  char *description;
+  FILE *fp;
+  command_array commands;
+  ccli_command *invoked_command;
+  // NULL unless output is async
+  async_output *async;
+  ccli_backpressure async_policy;
+  size_t async_ring_bytes;
+  // structured output, from the invoked command's --output option
+  ccli_output_format output_format;
+  // set once the first record (and its opening) has been written
+  bool records_started;
+  // records emitted outside of a redirected thread are built here
+  ccli_buffer record;
+  // set while a progress bar is on the current line
+  _Atomic bool progress_drawn;
+  // logging: records below [log_level] are dropped
+  int log_level;
+  bool log_level_fixed;
+  bool log_timestamps;
+  bool log_to_tty;
+  pthread_mutex_t log_lock;
+  ccli_buffer log_buffer;
+  // the formatted timestamp of [log_second]
+  time_t log_second;
+  char log_stamp[32];
+  size_t log_stamp_length;
+  // NULL unless tracing
+  trace_session *trace;
+  // set by ccli_invoke: output goes to [capture], and an exit on the
+  // invoking thread jumps back to [invoke_exit] with [invoke_status]
+  bool capturing;
+  ccli_buffer capture;
+  jmp_buf *invoke_exit;
+  pthread_t invoke_thread;
+  int invoke_status;
+  // the option name parse_options is working on, freed if an error
+  // jumps out from under it
+  char *parsing_name;
+  // from --ccli-bench: timed callback runs, and untimed ones before them
+  uint64_t bench_runs;
+  uint64_t bench_warmup;
+  // from --ccli-watch: run the callback again when its inputs change,
+  // once they've been quiet for [watch_debounce_ms]
+  bool watch;
+  uint64_t watch_debounce_ms;
+  // (char *) paths from ccli_watch_path, and the ones that changed
+  // before the current run
+  value_vector watch_paths;
+  value_vector changed_paths;
+  // the result cache: where it lives (NULL until it's needed, for the
+  // default), and how big it can get
+  char *cache_dir;
+  size_t cache_max_bytes;
+  // the key of the current run, empty if it can't be cached
+  ccli_buffer cache_key;
+  // set while a cacheable callback runs, to collect its output
+  ccli_buffer *tee;
+  ccli_buffer cache_output;
+  pthread_t cache_thread;
+  // (ccli_type *) types from ccli_register_type
+  value_vector types;
+  // (plugin_library *) from ccli_add_plugin_dir, and the one whose
+  // commands are being registered
+  value_vector plugins;
+  plugin_library *loading_plugin;
+  // from ccli_set_multi_call, and set when a run took its command from
+  // the program name
+  bool multi_call;
+  bool called_by_name;
+  // from --ccli-install-links
+  char *install_dir;
+};
+
+#define CACHE_DEFAULT_MAX_BYTES (64 * 1024 * 1024)
+
+static void path_list_free(value_vector *list);
+static void plugins_free(ccli *interface);
+static void cache_finish(ccli *interface, int status);
+static void log_init(ccli *interface);
+static void log_flush(ccli *interface);
+static void log_free(ccli *interface);
+static void trace_finish(ccli *interface);
+
+ccli *ccli_init(char *exeName, int argc, char **argv) {
+  ccli *interface = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(ccli));
+  interface->exeName = exeName;
+  interface->argc = argc;
+  interface->current_arg = 1;
+  interface->argv = argv;
+  interface->description = NULL;
+  interface->fp = stdout;
+
+  interface->invoked_command = NULL;
+  interface->async = NULL;
+  interface->output_format = CCLI_OUTPUT_TEXT;
+  interface->records_started = false;
+  buffer_init(&interface->record);
+  atomic_init(&interface->progress_drawn, false);
+  log_init(interface);
+  interface->trace = NULL;
+  interface->capturing = false;
+  buffer_init(&interface->capture);
+  interface->invoke_exit = NULL;
+  interface->invoke_status = 0;
+  interface->parsing_name = NULL;
+  interface->bench_runs = 0;
+  interface->bench_warmup = 0;
+  interface->watch = false;
+  interface->watch_debounce_ms = 0;
+  value_vector_init(&interface->watch_paths, sizeof(char *));
+  value_vector_init(&interface->changed_paths, sizeof(char *));
+  interface->cache_dir = NULL;
+  interface->cache_max_bytes = CACHE_DEFAULT_MAX_BYTES;
+  buffer_init(&interface->cache_key);
+  interface->tee = NULL;
+  buffer_init(&interface->cache_output);
+  value_vector_init(&interface->types, sizeof(ccli_type *));
+  value_vector_init(&interface->plugins, sizeof(plugin_library *));
+  interface->loading_plugin = NULL;
+  interface->multi_call = false;
+  interface->called_by_name = false;
+  interface->install_dir = NULL;
+  command_array_init(&interface->commands);
+  return interface;
+}
+
+void ccli_free(ccli *interface) {
+  ccli_trace_begin(interface, "flush");
+  if (interface->async) {
+    async_output_stop(interface->async);
+    interface->async = NULL;
+  }
+  fflush(interface->fp);
+  ccli_trace_end(interface);
+
+  trace_finish(interface);
+  buffer_free(&interface->record);
+  buffer_free(&interface->capture);
+  path_list_free(&interface->watch_paths);
+  path_list_free(&interface->changed_paths);
+  mem_free(interface->cache_dir);
+  buffer_free(&interface->cache_key);
+  buffer_free(&interface->cache_output);
+  log_free(interface);
+  command_array_free(&interface->commands);
+
+  ccli_type **types = value_vector_items(&interface->types);
+  for (int i = 0; i < interface->types.size; i++) {
+    mem_free(types[i]->name);
+    mem_free(types[i]);
+  }
+  value_vector_free(&interface->types);
+  // last, the plugins' commands may point into them
+  plugins_free(interface);
+  mem_free(interface);
+}
+
+void ccli_set_output_stream(ccli *interface, FILE *fp) {
+  if (interface->async) {
+    // drain what's queued for the old stream before switching
+    async_output_stop(interface->async);
+    fflush(fp);
+    interface->async = async_output_start(fp, interface->async_policy, interface->async_ring_bytes);
+  }
+  interface->fp = fp;
+}
+
+void ccli_set_async_output(ccli *interface, ccli_backpressure policy, size_t ring_bytes) {
+  if (interface->async) async_output_stop(interface->async);
+
+  // anything already in stdio's buffer has to come out first
+  fflush(interface->fp);
+  interface->async_policy = policy;
+  interface->async_ring_bytes = ring_bytes;
+  interface->async = async_output_start(interface->fp, policy, ring_bytes);
+}
+
+uint64_t ccli_async_dropped(ccli *interface) {
+  if (!interface->async) return 0;
+  return atomic_load(&interface->async->dropped);
+}
+
+// drain async output and logs before exiting, or they'd be lost. under
+// ccli_invoke, the status is handed back to the caller instead.
+static __attribute__((noreturn)) void ccli_exit(ccli *interface, int status) {
+  cache_finish(interface, status);
+  log_flush(interface);
+  if (interface->invoke_exit && pthread_equal(pthread_self(), interface->invoke_thread)) {
+    interface->invoke_status = status;
+    longjmp(*interface->invoke_exit, 1);
+  }
+
+  if (interface->async) {
+    async_output_stop(interface->async);
+    interface->async = NULL;
+  }
+  trace_finish(interface);
+  exit(status);
+}
+
+void ccli_set_description(ccli *interface, char *description) {
+  interface->description = description;
+}
+
+ccli_type *ccli_register_type(ccli *interface, char *name, size_t size,
+                              ccli_parse_fn parse, ccli_format_fn format) {
+  if (!name || size == 0 || !parse) {
+    error("a custom type needs a name, a size and a parse function.");
+  }
+
+  ccli_type **types = value_vector_items(&interface->types);
+  for (int i = 0; i < interface->types.size; i++) {
+    if (!strcmp(types[i]->name, name)) error("type '%s' is already registered.", name);
+  }
+
+  ccli_type *type = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(ccli_type));
+  type->name = mem_strdup(CCLI_MEMORY_SCHEMA, name);
+  type->size = size;
+  type->parse = parse;
+  type->format = format;
+  value_vector_add(&interface->types, &type);
+  return type;
+}
+
+/******************** ccli option retrieval ********************/
+
+bool ccli_option_exists(ccli *interface, char *option) {
+  if (!interface->invoked_command) return false;
+
+  ccli_command *command = interface->invoked_command;
+  ccli_option *_option = ccli_table_find_option(&command->options, option);
+  return _option && bitset_test(&command->present, _option->index);
+}
+
+bool ccli_get_int_option(ccli *interface, char *option, int *value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_int(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_double_option(ccli *interface, char *option, double *value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_double(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_bool_option(ccli *interface, char *option, bool *value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_bool(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_string_option(ccli *interface, char *option, char **value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_string(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_choice_option(ccli *interface, char *option, int *value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_choice(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_int64_option(ccli *interface, char *option, int64_t *value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_int64(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_uint64_option(ccli *interface, char *option, uint64_t *value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_uint64(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_file_option(ccli *interface, char *option, ccli_file **value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_file(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_typed_option(ccli *interface, char *option, ccli_type *type, const void **value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_typed(&interface->invoked_command->options, option, type, value);
+}
+
+bool ccli_get_range_option(ccli *interface, char *option, ccli_range_list **value) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_range(&interface->invoked_command->options, option, value);
+}
+
+bool ccli_get_string_list_option(ccli *interface, char *option, char ***values, int *count) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_list(&interface->invoked_command->options, option,
+                             VAL_STRING_LIST, (void **)values, count);
+}
+
+bool ccli_get_number_list_option(ccli *interface, char *option, double **values, int *count) {
+  if (!interface->invoked_command) return false;
+
+  return ccli_table_get_list(&interface->invoked_command->options, option,
+                             VAL_NUM_LIST, (void **)values, count);
+}
+
+/******************** ccli print utilities ********************/
+
+// when set, everything printed on this thread is collected here
+// instead, to be written to the interface's stream later, in order.
+static __thread ccli_buffer *thread_output = NULL;
+
+// write straight to the stream, or to the async writer
+static void stream_send(ccli *interface, const char *chars, size_t length) {
+  if (interface->capturing) buffer_append(&interface->capture, chars, length);
+  else if (interface->async) {
+    async_output *async = interface->async;
+    pthread_mutex_lock(&async->open_lock);
+    if (async_output_accepts(async)) {
+      buffer_append(&async->open, chars, length);
+      async_output_commit(async);
+    }
+    pthread_mutex_unlock(&async->open_lock);
+  }
+  else if (SINGLE_THREADED()) fwrite_unlocked(chars, 1, length, interface->fp);
+  else fwrite(chars, 1, length, interface->fp);
+}
+
+// output that's part of the command's result, which a cacheable command
+// also keeps a copy of. progress frames are sent around this.
+static void stream_write(ccli *interface, const char *chars, size_t length) {
+  if (interface->tee) buffer_append(interface->tee, chars, length);
+  stream_send(interface, chars, length);
+}
+
+// erase a progress bar before writing over its line. it's drawn again
+// on its next frame.
+static void erase_progress(ccli *interface) {
+  if (atomic_load_explicit(&interface->progress_drawn, memory_order_relaxed) &&
+      atomic_exchange(&interface->progress_drawn, false)) {
+    stream_send(interface, "\r\033[K", 4);
+  }
+}
+
+static void output_write(ccli *interface, const char *chars, size_t length) {
+  if (thread_output) buffer_append(thread_output, chars, length);
+  else {
+    erase_progress(interface);
+    stream_write(interface, chars, length);
+  }
+}
+
+static void output_vprintf(ccli *interface, const char *format, va_list args) {
+  if (thread_output) {
+    buffer_vprintf(thread_output, format, args);
+    return;
+  }
+
+  erase_progress(interface);
+  if (interface->tee) {
+    // format once, into the copy, and send that
+    size_t start = interface->tee->size;
+    buffer_vprintf(interface->tee, format, args);
+    stream_send(interface, interface->tee->chars + start, interface->tee->size - start);
+  }
+  else if (interface->capturing) buffer_vprintf(&interface->capture, format, args);
+  else if (interface->async) {
+    async_output *async = interface->async;
+    pthread_mutex_lock(&async->open_lock);
+    if (async_output_accepts(async)) {
+      buffer_vprintf(&async->open, format, args);
+      async_output_commit(async);
+    }
+    pthread_mutex_unlock(&async->open_lock);
+  }
+  else vfprintf(interface->fp, format, args);
+}
+
+// color codes only go to stdout, never to a file or captured output
+static bool use_color(ccli *interface) {
+  return interface->fp == stdout && !interface->capturing;
+}
+
+static void output_color_vprintf(ccli *interface, ccli_color color, const char *format, va_list args) {
+  if (!use_color(interface)) {
+    output_vprintf(interface, format, args);
+    return;
+  }
+
+  const char *code = color_code(color);
+  if (!code) {
+    fprintf(interface->fp, "invalid color code -> %d\n", color);
+    code = "";
+  }
+
+  output_write(interface, code, strlen(code));
+  output_vprintf(interface, format, args);
+  output_write(interface, COLOR_RESET, sizeof(COLOR_RESET) - 1);
+}
+
+void ccli_print(ccli *interface, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  output_vprintf(interface, format, args);
+  va_end(args);
+}
+
+void ccli_print_color(ccli *interface, ccli_color color, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  output_color_vprintf(interface, color, format, args);
+  va_end(args);
+}
+
+// print a line to the filestream and append a newline.
+// the stream is locked for the whole line, so lines from other threads
+// can't end up in the middle of it.
+void ccli_echo(ccli *interface, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  if (!thread_output) flockfile(interface->fp);
+  output_vprintf(interface, format, args);
+  output_write(interface, "\n", 1);
+  if (!thread_output) funlockfile(interface->fp);
+  va_end(args);
+}
+
+/**
+ * @brief
+ *  print a line to the terminal in color, and append a newline.
+ *  short-circuit to no color codes if the given file stream is not stdout
+ *
+ * @param interface
+ * @param color
+ * @param format
+ * @param ...
+ */
+void ccli_echo_color(ccli *interface, ccli_color color, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  if (!thread_output) flockfile(interface->fp);
+  output_color_vprintf(interface, color, format, args);
+  output_write(interface, "\n", 1);
+  if (!thread_output) funlockfile(interface->fp);
+  va_end(args);
+}
+
+void ccli_write_str(ccli *interface, const char *chars) {
+  output_write(interface, chars, strlen(chars));
+}
+
+void ccli_write_strn(ccli *interface, const char *chars, size_t length) {
+  output_write(interface, chars, length);
+}
+
+void ccli_write_i64(ccli *interface, int64_t value) {
+  char digits[20];
+  output_write(interface, digits, format_i64(digits, value));
+}
+
+void ccli_write_u64(ccli *interface, uint64_t value) {
+  char digits[20];
+  output_write(interface, digits, format_u64(digits, value));
+}
+
+void ccli_write_u64_hex(ccli *interface, uint64_t value) {
+  char digits[16];
+  output_write(interface, digits, format_u64_hex(digits, value));
+}
+
+void ccli_write_f64(ccli *interface, double value) {
+  char digits[32];
+  output_write(interface, digits, format_f64(digits, value));
+}
+
+#define ccli_runtime_error(interface, format, args...)      \
+  do {                                                      \
+    ccli_print_color(interface, COLOR_RED, "Error: ");      \
+    ccli_echo_color(interface, COLOR_RED, format, ## args); \
+    ccli_exit(interface, 1);                                \
+  } while (false)
+
+static void ccli_option_display(ccli *interface, ccli_option *option) {
+  // must supply a long (--double-dash) option
+  ccli_print_color(interface, COLOR_YELLOW, "  %s", option->long_option);
+
+  /*
+  if (option->short_option) {
+    ccli_print_color(interface, COLOR_YELLOW, ", %s", option->short_option);
+  }
+  */
+
+  switch (option->type) {
+    case VAL_NULL:   break;
+    case VAL_NUM:    ccli_print_color(interface, COLOR_CYAN, "=NUMBER"); break;
+    case VAL_BOOL:   ccli_print_color(interface, COLOR_CYAN, "=BOOLEAN"); break;
+    case VAL_STRING: ccli_print_color(interface, COLOR_CYAN, "=STRING"); break;
+    case VAL_CHOICE: {
+      for (int i = 0; i < option->choices.count; i++) {
+        ccli_print_color(interface, COLOR_CYAN, "%c%s", (i == 0) ? '=' : '|', option->choices.choices[i]);
+      }
+      break;
+    }
+    case VAL_RANGE_LIST:  ccli_print_color(interface, COLOR_CYAN, "=RANGES"); break;
+    case VAL_FILE:        ccli_print_color(interface, COLOR_CYAN, "=FILE"); break;
+    case VAL_TYPED: {
+      ccli_type *type = option->slot->type;
+      ccli_print_color(interface, COLOR_CYAN, "=%s", type->name);
+      if (option->default_slot && type->format) {
+        char text[128];
+        type->format(option->default_slot->data, text, sizeof(text));
+        ccli_print_color(interface, COLOR_CYAN, " (default: %s)", text);
+      }
+      break;
+    }
+    case VAL_INT64:
+    case VAL_UINT64:      ccli_print_color(interface, COLOR_CYAN, "=%s", unit_display_name(option->unit)); break;
+    case VAL_STRING_LIST: ccli_print_color(interface, COLOR_CYAN, "=STRING..."); break;
+    case VAL_NUM_LIST:    ccli_print_color(interface, COLOR_CYAN, "=NUMBER..."); break;
+    case VAL_COUNTER:     ccli_print_color(interface, COLOR_CYAN, " (repeatable)"); break;
+    default:
+      ccli_option_display(interface, option);
+      ccli_runtime_error(interface, "invalid value type: '%d'.", option->type);
+  }
+
+  if (option->pattern) {
+    ccli_print_color(interface, COLOR_CYAN, " (matching '%s')", option->pattern->source);
+  }
+
+  if (bitset_test(&option->command->required, option->index)) {
+    ccli_print_color(interface, COLOR_RED, " (required)");
+  }
+
+  if (option->description) {
+    ccli_print_color(interface, COLOR_YELLOW, " -> %s\n", option->description);
+  }
+
+  ccli_print(interface, "\n");
+}
+
+static void ccli_display_options(ccli *interface, ccli_command *command) {
+  option_array *array = &command->option_list;
+
+  if (array->size <= 0) return;
+
+  ccli_echo_color(interface, COLOR_YELLOW, "Options:");
+
+  for (int i = 0; i < array->size; i++) {
+    ccli_option_display(interface, array->options[i]);
+  }
+
+  ccli_print(interface, "\n");
+}
+
+static void ccli_arg_display(ccli *interface, ccli_arg *arg) {
+  ccli_print_color(interface, COLOR_YELLOW, "  %s", arg->name);
+
+  switch(arg->type) {
+    case VAL_NUM: ccli_print_color(interface, COLOR_CYAN, " (NUMBER)"); break;
+    case VAL_BOOL: ccli_print_color(interface, COLOR_CYAN, " (BOOLEAN)"); break;
+    case VAL_STRING: ccli_print_color(interface, COLOR_CYAN, " (STRING)"); break;
+    case VAL_RANGE_LIST: ccli_print_color(interface, COLOR_CYAN, " (RANGES)"); break;
+    case VAL_FILE: ccli_print_color(interface, COLOR_CYAN, " (FILE)"); break;
+    case VAL_TYPED: ccli_print_color(interface, COLOR_CYAN, " (%s)", arg->slot->type->name); break;
+    case VAL_INT64:
+    case VAL_UINT64: ccli_print_color(interface, COLOR_CYAN, " (%s)", unit_display_name(arg->unit)); break;
+    default:
+      // Unreachable
+      ccli_runtime_error(interface, "unrecognized value type: '%d'.", arg->type);
+
+  }
+
+  if (arg->description) {
+    ccli_print_color(interface, COLOR_YELLOW, " -> %s", arg->description);
+  }
+
+  ccli_print(interface, "\n");
+}
+
+static void ccli_display_args(ccli *interface, ccli_command *command) {
+  arg_array *array = &command->args;
+
+  if (array->size <= 0) return;
+
+  ccli_echo_color(interface, COLOR_YELLOW, "Arguments:");
+  for (int i = 0; i < array->size; i++) {
+    ccli_print_color(interface, COLOR_YELLOW, "  %d.", i);
+    ccli_arg_display(interface, array->args[0]);
+  }
+
+  ccli_print(interface, "\n");
+}
+
+static void ccli_detailed_command_display(ccli *interface, ccli_command *command) {
+  if (interface->called_by_name) {
+    // the program name is the command
+    ccli_print_color(interface, COLOR_YELLOW, "Usage: ./%s [OPTIONS]", interface->exeName);
+  } else {
+    ccli_print_color(interface, COLOR_YELLOW, "Usage: ./%s %s [OPTIONS]", interface->exeName, command->command);
+  }
+
+  for (int i = 0; i < command->args.size; i++) {
+    ccli_print_color(interface, COLOR_YELLOW, " <%s>", command->args.args[i]->name);
+  }
+
+  ccli_print(interface, "\n\n");
+
+  if (command->description) {
+    ccli_echo_color(interface, COLOR_YELLOW, "  %s\n", command->description);
+  }
+
+  ccli_display_options(interface, command);
+  ccli_display_args(interface, command);
+}
+
+static void ccli_command_display(ccli *interface, ccli_command *command) {
+  ccli_print_color(interface, COLOR_YELLOW, "%s", command->command);
+  if (command->description) {
+    ccli_print_color(interface, COLOR_YELLOW, " -> %s", command->description);
+  }
+  ccli_print(interface, "\n");
+}
+
+static void ccli_display_commands(ccli *interface) {
+  ccli_echo_color(interface, COLOR_YELLOW, "Commands:");
+  for (int i = 0; i < interface->commands.size; i++) {
+    ccli_print(interface, "  ");
+    ccli_command_display(interface, interface->commands.commands[i]);
+  }
+}
+
+static void ccli_usage(ccli *interface) {
+  ccli_echo_color(interface, COLOR_YELLOW, "Usage: ./%s [command] [options]\n", interface->exeName);
+}
+
+static void ccli_display(ccli *interface) {
+
+  ccli_usage(interface);
+
+  if (interface->description) {
+    ccli_echo_color(interface, COLOR_YELLOW, "  %s\n", interface->description);
+  }
+
+  // TODO: commands help
+  ccli_display_commands(interface);
+  ccli_print(interface, "\n");
+
+  // TODO: global options help
+}
+
+/******************** ccli structured output ********************/
+
+static char *output_formats[] = { "text", "json", "ndjson", "csv" };
+
+// per-thread state of the record being emitted
+static __thread int record_fields = 0;
+static __thread bool record_is_first = false;
+
+// json and csv need something before the first record (the array's '['
+// or the header row) and json needs a separator between records, which
+// depend on which record reaches the stream first.
+static bool format_has_opening(ccli_output_format format) {
+  return format == CCLI_OUTPUT_JSON || format == CCLI_OUTPUT_CSV;
+}
+
+static const char *record_separator(ccli_output_format format) {
+  return (format == CCLI_OUTPUT_JSON) ? ",\n" : "";
+}
+
+// write a buffer collected on another thread. if it holds the first
+// record to reach the stream its opening goes along with it, otherwise
+// the opening is swapped for the separator between records.
+static void output_write_buffer(ccli *interface, ccli_buffer *buffer) {
+  if (buffer->first_record == SIZE_MAX || !interface->records_started) {
+    if (buffer->first_record != SIZE_MAX) interface->records_started = true;
+    output_write(interface, buffer->chars, buffer->size);
+  } else {
+    const char *separator = record_separator(interface->output_format);
+    output_write(interface, buffer->chars, buffer->first_record);
+    output_write(interface, separator, strlen(separator));
+    output_write(interface, buffer->chars + buffer->first_record_body, buffer->size - buffer->first_record_body);
+  }
+
+  buffer->first_record = SIZE_MAX;
+  buffer->first_record_body = SIZE_MAX;
+}
+
+// close the json array once the callback is done
+static void finish_records(ccli *interface) {
+  if (interface->output_format != CCLI_OUTPUT_JSON) return;
+
+  if (interface->records_started) ccli_print(interface, "\n]\n");
+  else ccli_print(interface, "[]\n");
+}
+
+static ccli_buffer *record_buffer(ccli *interface) {
+  return thread_output ? thread_output : &interface->record;
+}
+
+// length of the prefix of [chars] that a json string can hold as is:
+// everything but '"', '\\' and control characters
+static size_t json_clean_prefix(const char *chars, size_t length) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(chars + i));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+    // unsigned block <= 0x1f
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(block, control), block));
+    int mask = _mm_movemask_epi8(special);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < length; i++) {
+    unsigned char c = chars[i];
+    if (c == '"' || c == '\\' || c < 0x20) return i;
+  }
+  return length;
+}
+
+// length of the prefix of [chars] that a csv field can hold unquoted
+static size_t csv_clean_prefix(const char *chars, size_t length) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriage = _mm_set1_epi8('\r');
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(chars + i));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, quote));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, newline));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, carriage));
+    int mask = _mm_movemask_epi8(special);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < length; i++) {
+    char c = chars[i];
+    if (c == ',' || c == '"' || c == '\n' || c == '\r') return i;
+  }
+  return length;
+}
+
+static void append_json_string(ccli_buffer *buffer, const char *chars, size_t length) {
+  buffer_reserve(buffer, length + 2);
+  buffer_append(buffer, "\"", 1);
+
+  for (;;) {
+    // copy clean runs in bulk, and escape what stopped them
+    size_t clean = json_clean_prefix(chars, length);
+    buffer_append(buffer, chars, clean);
+    if (clean == length) break;
+
+    unsigned char c = chars[clean];
+    switch (c) {
+      case '"':  buffer_append(buffer, "\\\"", 2); break;
+      case '\\': buffer_append(buffer, "\\\\", 2); break;
+      case '\n': buffer_append(buffer, "\\n", 2); break;
+      case '\r': buffer_append(buffer, "\\r", 2); break;
+      case '\t': buffer_append(buffer, "\\t", 2); break;
+      case '\b': buffer_append(buffer, "\\b", 2); break;
+      case '\f': buffer_append(buffer, "\\f", 2); break;
+      default:   buffer_printf(buffer, "\\u%04x", c); break;
+    }
+    chars += clean + 1;
+    length -= clean + 1;
+  }
+
+  buffer_append(buffer, "\"", 1);
+}
+
+static void append_csv_string(ccli_buffer *buffer, const char *chars, size_t length) {
+  size_t clean = csv_clean_prefix(chars, length);
+  if (clean == length) {
+    buffer_append(buffer, chars, length);
+    return;
+  }
+
+  // quote the field, and double any quotes inside it
+  buffer_reserve(buffer, length + 2);
+  buffer_append(buffer, "\"", 1);
+  for (;;) {
+    buffer_append(buffer, chars, clean);
+    if (clean == length) break;
+
+    if (chars[clean] == '"') buffer_append(buffer, "\"\"", 2);
+    else buffer_append(buffer, chars + clean, 1);
+    chars += clean + 1;
+    length -= clean + 1;
+    clean = csv_clean_prefix(chars, length);
+  }
+  buffer_append(buffer, "\"", 1);
+}
+
+// the first csv record carries its own header row, which grows by a
+// column for each field
+static void insert_csv_header_name(ccli_buffer *buffer, const char *name) {
+  ccli_buffer column;
+  buffer_init(&column);
+  if (record_fields > 0) buffer_append(&column, ",", 1);
+  append_csv_string(&column, name, strlen(name));
+
+  // the header ends with a newline, right before the record's body
+  size_t at = buffer->first_record_body - 1;
+  buffer_reserve(buffer, column.size);
+  memmove(buffer->chars + at + column.size, buffer->chars + at, buffer->size - at);
+  memcpy(buffer->chars + at, column.chars, column.size);
+  buffer->size += column.size;
+  buffer->first_record_body += column.size;
+  buffer_free(&column);
+}
+
+void ccli_emit_begin(ccli *interface) {
+  ccli_buffer *buffer = record_buffer(interface);
+  ccli_output_format format = interface->output_format;
+  record_fields = 0;
+
+  // outside of a redirected thread, records go straight out, so only
+  // the very first needs an opening
+  bool first = buffer->first_record == SIZE_MAX;
+  if (!thread_output && interface->records_started) first = false;
+  record_is_first = first && format_has_opening(format);
+
+  if (record_is_first) {
+    buffer->first_record = buffer->size;
+    if (format == CCLI_OUTPUT_JSON) buffer_append(buffer, "[\n", 2);
+    else buffer_append(buffer, "\n", 1);
+    buffer->first_record_body = buffer->size;
+  } else {
+    const char *separator = record_separator(format);
+    buffer_append(buffer, separator, strlen(separator));
+  }
+
+  if (format == CCLI_OUTPUT_JSON || format == CCLI_OUTPUT_NDJSON) buffer_append(buffer, "{", 1);
+}
+
+// separator and name, ahead of a field's value
+static ccli_buffer *begin_field(ccli *interface, const char *name) {
+  ccli_buffer *buffer = record_buffer(interface);
+
+  switch (interface->output_format) {
+    case CCLI_OUTPUT_TEXT:
+      if (record_fields > 0) buffer_append(buffer, " ", 1);
+      buffer_append(buffer, name, strlen(name));
+      buffer_append(buffer, "=", 1);
+      break;
+    case CCLI_OUTPUT_JSON:
+    case CCLI_OUTPUT_NDJSON:
+      if (record_fields > 0) buffer_append(buffer, ",", 1);
+      append_json_string(buffer, name, strlen(name));
+      buffer_append(buffer, ":", 1);
+      break;
+    case CCLI_OUTPUT_CSV:
+      if (record_is_first) insert_csv_header_name(buffer, name);
+      if (record_fields > 0) buffer_append(buffer, ",", 1);
+      break;
+  }
+
+  record_fields++;
+  return buffer;
+}
+
+void ccli_emit_field_int(ccli *interface, const char *name, int64_t value) {
+  char digits[20];
+  buffer_append(begin_field(interface, name), digits, format_i64(digits, value));
+}
+
+void ccli_emit_field_uint(ccli *interface, const char *name, uint64_t value) {
+  char digits[20];
+  buffer_append(begin_field(interface, name), digits, format_u64(digits, value));
+}
+
+void ccli_emit_field_double(ccli *interface, const char *name, double value) {
+  ccli_buffer *buffer = begin_field(interface, name);
+  bool json = interface->output_format == CCLI_OUTPUT_JSON || interface->output_format == CCLI_OUTPUT_NDJSON;
+
+  // json has no way to spell nan or infinity
+  if (json && !isfinite(value)) {
+    buffer_append(buffer, "null", 4);
+    return;
+  }
+
+  char digits[32];
+  buffer_append(buffer, digits, format_f64(digits, value));
+}
+
+void ccli_emit_field_bool(ccli *interface, const char *name, bool value) {
+  ccli_buffer *buffer = begin_field(interface, name);
+  if (value) buffer_append(buffer, "true", 4);
+  else buffer_append(buffer, "false", 5);
+}
+
+void ccli_emit_field_strn(ccli *interface, const char *name, const char *value, size_t length) {
+  ccli_buffer *buffer = begin_field(interface, name);
+
+  switch (interface->output_format) {
+    case CCLI_OUTPUT_TEXT:
+      buffer_append(buffer, value, length);
+      break;
+    case CCLI_OUTPUT_JSON:
+    case CCLI_OUTPUT_NDJSON:
+      append_json_string(buffer, value, length);
+      break;
+    case CCLI_OUTPUT_CSV:
+      append_csv_string(buffer, value, length);
+      break;
+  }
+}
+
+void ccli_emit_field_str(ccli *interface, const char *name, const char *value) {
+  if (!value) {
+    ccli_buffer *buffer = begin_field(interface, name);
+    bool json = interface->output_format == CCLI_OUTPUT_JSON || interface->output_format == CCLI_OUTPUT_NDJSON;
+    if (json) buffer_append(buffer, "null", 4);
+    return;
+  }
+
+  ccli_emit_field_strn(interface, name, value, strlen(value));
+}
+
+void ccli_emit_end(ccli *interface) {
+  ccli_buffer *buffer = record_buffer(interface);
+
+  switch (interface->output_format) {
+    case CCLI_OUTPUT_JSON:   buffer_append(buffer, "}", 1); break;
+    case CCLI_OUTPUT_NDJSON: buffer_append(buffer, "}\n", 2); break;
+    default:                 buffer_append(buffer, "\n", 1); break;
+  }
+
+  // a redirected thread's buffer is written out by whoever redirected it
+  if (!thread_output) {
+    output_write_buffer(interface, buffer);
+    buffer->size = 0;
+  }
+}
+
+ccli_output_format ccli_get_output_format(ccli *interface) {
+  return interface->output_format;
+}
+
+/******************** ccli_table_writer ********************/
+
+#define TABLE_GAP "  "
+#define ELLIPSIS  "\xe2\x80\xa6"
+
+typedef struct {
+  char *header;
+  // 0 until it's measured, unless it was given as a hint
+  int width;
+  bool fixed;
+  bool colored;
+  ccli_color color;
+  bool align_right;
+} table_column;
+
+struct ccli_table_writer {
+  ccli *interface;
+  ccli_overflow overflow;
+  int column_count;
+  int column_capacity;
+  table_column *columns;
+
+  // the row being filled, one NUL terminated cell after another
+  ccli_buffer row;
+  int cells;
+
+  // the first rows, held back until the widths are known
+  int sample_rows;
+  int sampled;
+  ccli_buffer sample;
+  bool started;
+
+  ccli_buffer line;
+};
+
+// columns a cell takes up on a terminal: one per utf-8 code point
+static int display_width(const char *chars) {
+  int width = 0;
+  for (; *chars; chars++) {
+    if (((unsigned char)*chars & 0xc0) != 0x80) width++;
+  }
+  return width;
+}
+
+// bytes taken up by the first [width] code points of [chars]
+static size_t display_prefix(const char *chars, int width) {
+  size_t i = 0;
+  for (; chars[i]; i++) {
+    if (((unsigned char)chars[i] & 0xc0) != 0x80 && width-- == 0) break;
+  }
+  return i;
+}
+
+ccli_table_writer *ccli_table_writer_new(ccli *interface, int sample_rows, ccli_overflow overflow) {
+  ccli_table_writer *writer = mem_alloc(CCLI_MEMORY_OUTPUT, sizeof(ccli_table_writer));
+  writer->interface = interface;
+  writer->overflow = overflow;
+  writer->column_count = 0;
+  writer->column_capacity = 0;
+  writer->columns = NULL;
+  buffer_init(&writer->row);
+  writer->cells = 0;
+  writer->sample_rows = (sample_rows > 0) ? sample_rows : 0;
+  writer->sampled = 0;
+  buffer_init(&writer->sample);
+  writer->started = false;
+  buffer_init(&writer->line);
+  return writer;
+}
+
+int ccli_table_writer_add_column(ccli_table_writer *writer, char *header, int width) {
+  if (writer->started || writer->sampled > 0) {
+    error("columns have to be added before the first row.");
+  }
+
+  if (writer->column_count + 1 > writer->column_capacity) {
+    writer->column_capacity = GROW_ARRAY_CAPACITY(writer->column_capacity);
+    writer->columns = mem_realloc(CCLI_MEMORY_OUTPUT, writer->columns, sizeof(table_column) * writer->column_capacity);
+  }
+
+  table_column *column = &writer->columns[writer->column_count];
+  column->header = header;
+  column->fixed = width > 0;
+  column->width = column->fixed ? width : display_width(header);
+  column->colored = false;
+  column->align_right = false;
+  return writer->column_count++;
+}
+
+void ccli_table_writer_set_color(ccli_table_writer *writer, int column, ccli_color color) {
+  if (column < 0 || column >= writer->column_count) return;
+  writer->columns[column].colored = true;
+  writer->columns[column].color = color;
+}
+
+void ccli_table_writer_set_align_right(ccli_table_writer *writer, int column, bool align_right) {
+  if (column < 0 || column >= writer->column_count) return;
+  writer->columns[column].align_right = align_right;
+}
+
+// format one row of cells into [line] and write it out
+static void write_table_row(ccli_table_writer *writer, const char *cells, bool header) {
+  ccli_buffer *line = &writer->line;
+  // same rule as the other color output: only on stdout
+  bool color = !header && use_color(writer->interface);
+  line->size = 0;
+
+  for (int i = 0; i < writer->column_count; i++) {
+    table_column *column = &writer->columns[i];
+    const char *cell = cells;
+    cells += strlen(cells) + 1;
+
+    int width = display_width(cell);
+    size_t length = strlen(cell);
+    bool truncated = false;
+    if (width > column->width) {
+      if (writer->overflow == CCLI_OVERFLOW_GROW) {
+        column->width = width;
+      } else {
+        // keep what fits, and mark the cut with an ellipsis
+        length = (column->width > 0) ? display_prefix(cell, column->width - 1) : 0;
+        width = column->width;
+        truncated = column->width > 0;
+      }
+    }
+
+    bool last = i == writer->column_count - 1;
+    int padding = column->width - width;
+    if (i > 0) buffer_append(line, TABLE_GAP, sizeof(TABLE_GAP) - 1);
+    if (column->align_right) {
+      for (int j = 0; j < padding; j++) buffer_append(line, " ", 1);
+    }
+
+    const char *code = (color && column->colored) ? color_code(column->color) : NULL;
+    if (code) buffer_append(line, code, strlen(code));
+    buffer_append(line, cell, length);
+    if (truncated) buffer_append(line, ELLIPSIS, sizeof(ELLIPSIS) - 1);
+    if (code) buffer_append(line, COLOR_RESET, sizeof(COLOR_RESET) - 1);
+
+    // no trailing whitespace after the last column
+    if (!column->align_right && !last) {
+      for (int j = 0; j < padding; j++) buffer_append(line, " ", 1);
+    }
+  }
+
+  buffer_append(line, "\n", 1);
+  output_write(writer->interface, line->chars, line->size);
+}
+
+// the widths are settled: write the header, then the rows held back
+static void start_table(ccli_table_writer *writer) {
+  ccli_buffer headers;
+  buffer_init(&headers);
+  for (int i = 0; i < writer->column_count; i++) {
+    buffer_append(&headers, writer->columns[i].header, strlen(writer->columns[i].header) + 1);
+  }
+  write_table_row(writer, headers.chars, true);
+  buffer_free(&headers);
+
+  const char *row = writer->sample.chars;
+  for (int i = 0; i < writer->sampled; i++) {
+    write_table_row(writer, row, false);
+    for (int j = 0; j < writer->column_count; j++) row += strlen(row) + 1;
+  }
+
+  buffer_free(&writer->sample);
+  writer->started = true;
+}
+
+void ccli_table_writer_cell(ccli_table_writer *writer, const char *format, ...) {
+  // extra cells are dropped
+  if (writer->cells >= writer->column_count) return;
+
+  va_list args;
+  va_start(args, format);
+  buffer_vprintf(&writer->row, format, args);
+  va_end(args);
+  buffer_append(&writer->row, "", 1);
+  writer->cells++;
+}
+
+void ccli_table_writer_end_row(ccli_table_writer *writer) {
+  // missing cells are left blank
+  while (writer->cells < writer->column_count) {
+    buffer_append(&writer->row, "", 1);
+    writer->cells++;
+  }
+
+  if (!writer->started && writer->sampled >= writer->sample_rows) start_table(writer);
+
+  if (writer->started) {
+    write_table_row(writer, writer->row.chars, false);
+  } else {
+    // measure the row, and hold on to it until the sample is complete
+    const char *cell = writer->row.chars;
+    for (int i = 0; i < writer->column_count; i++) {
+      table_column *column = &writer->columns[i];
+      int width = display_width(cell);
+      if (!column->fixed && width > column->width) column->width = width;
+      cell += strlen(cell) + 1;
+    }
+
+    buffer_append(&writer->sample, writer->row.chars, writer->row.size);
+    if (++writer->sampled >= writer->sample_rows) start_table(writer);
+  }
+
+  writer->row.size = 0;
+  writer->cells = 0;
+}
+
+void ccli_table_writer_end(ccli_table_writer *writer) {
+  if (writer->cells > 0) ccli_table_writer_end_row(writer);
+  if (!writer->started) start_table(writer);
+
+  buffer_free(&writer->row);
+  buffer_free(&writer->sample);
+  buffer_free(&writer->line);
+  mem_free(writer->columns);
+  mem_free(writer);
+}
+
+/******************** ccli_progress ********************/
+
+#define PROGRESS_FRAMES_PER_SECOND 10
+#define PROGRESS_BAR_WIDTH         30
+// weight of the newest frame in the smoothed rate
+#define PROGRESS_RATE_SMOOTHING    0.3
+
+static const char progress_spinner[] = "|/-\\";
+
+struct ccli_progress {
+  ccli *interface;
+  const char *label;
+  _Atomic uint64_t done;
+  _Atomic uint64_t total;
+  // false if the stream isn't a terminal; counting still works
+  bool live;
+
+  double started;
+  double last_time;
+  uint64_t last_done;
+  double rate;
+  int frame;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool stopping;
+  pthread_t renderer;
+  ccli_buffer line;
+};
+
+static double monotonic_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 1234567 -> 1.2M
+static void append_si(ccli_buffer *buffer, double value) {
+  static const char suffixes[] = " kMGTP";
+  int i = 0;
+  while (value >= 1000 && i < 5) {
+    value /= 1000;
+    i++;
+  }
+
+  if (i == 0) buffer_printf(buffer, "%.0f", value);
+  else buffer_printf(buffer, "%.1f%c", value, suffixes[i]);
+}
+
+static void append_duration(ccli_buffer *buffer, double seconds) {
+  uint64_t total = (seconds > 0) ? (uint64_t)seconds : 0;
+  uint64_t hours = total / 3600, minutes = total / 60 % 60;
+  if (hours) buffer_printf(buffer, "%" PRIu64 ":%02" PRIu64 ":%02" PRIu64, hours, minutes, total % 60);
+  else buffer_printf(buffer, "%02" PRIu64 ":%02" PRIu64, minutes, total % 60);
+}
+
+// draw one frame over the current line, in a single write
+static void render_progress(ccli_progress *progress, bool final) {
+  ccli *interface = progress->interface;
+  ccli_buffer *line = &progress->line;
+  double now = monotonic_seconds();
+  uint64_t done = atomic_load_explicit(&progress->done, memory_order_relaxed);
+  uint64_t total = atomic_load_explicit(&progress->total, memory_order_relaxed);
+
+  double elapsed = now - progress->last_time;
+  if (elapsed > 0) {
+    double rate = (done - progress->last_done) / elapsed;
+    progress->rate = (progress->rate == 0) ? rate : progress->rate + PROGRESS_RATE_SMOOTHING * (rate - progress->rate);
+  }
+  progress->last_time = now;
+  progress->last_done = done;
+
+  line->size = 0;
+  buffer_append(line, "\r", 1);
+  if (!final) buffer_printf(line, "%c ", progress_spinner[progress->frame % 4]);
+  if (progress->label) buffer_printf(line, "%s ", progress->label);
+
+  if (total > 0) {
+    uint64_t shown = (done < total) ? done : total;
+    int filled = (int)(PROGRESS_BAR_WIDTH * shown / total);
+    buffer_append(line, "[", 1);
+    for (int i = 0; i < PROGRESS_BAR_WIDTH; i++) {
+      buffer_append(line, (i < filled) ? "=" : (i == filled) ? ">" : " ", 1);
+    }
+    buffer_printf(line, "] %3d%% ", (int)(100 * shown / total));
+    append_si(line, done);
+    buffer_append(line, "/", 1);
+    append_si(line, total);
+  } else {
+    append_si(line, done);
+  }
+
+  buffer_append(line, "  ", 2);
+  if (final) {
+    // the average over the whole run, and how long it took
+    double seconds = now - progress->started;
+    append_si(line, (seconds > 0) ? done / seconds : 0);
+    buffer_append(line, "/s  ", 4);
+    append_duration(line, seconds);
+  } else {
+    append_si(line, progress->rate);
+    buffer_append(line, "/s", 2);
+    if (total > 0 && done < total && progress->rate > 0) {
+      buffer_append(line, "  ETA ", 6);
+      append_duration(line, (total - done) / progress->rate);
+    }
+  }
+  // clear what's left of a longer, earlier frame
+  buffer_append(line, "\033[K", 3);
+  if (final) buffer_append(line, "\n", 1);
+  progress->frame++;
+
+  flockfile(interface->fp);
+  atomic_store(&interface->progress_drawn, false);
+  stream_send(interface, line->chars, line->size);
+  if (!interface->async) fflush(interface->fp);
+  atomic_store(&interface->progress_drawn, !final);
+  funlockfile(interface->fp);
+}
+
+static void *progress_renderer_run(void *arg) {
+  ccli_progress *progress = arg;
+
+  pthread_mutex_lock(&progress->lock);
+  while (!progress->stopping) {
+    pthread_mutex_unlock(&progress->lock);
+    render_progress(progress, false);
+    pthread_mutex_lock(&progress->lock);
+
+    // sleep until the next frame, unless the progress is finished first
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 1000000000 / PROGRESS_FRAMES_PER_SECOND;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    while (!progress->stopping &&
+           pthread_cond_timedwait(&progress->wake, &progress->lock, &deadline) != ETIMEDOUT);
+  }
+  pthread_mutex_unlock(&progress->lock);
+
+  return NULL;
+}
+
+ccli_progress *ccli_progress_start(ccli *interface, const char *label, uint64_t total) {
+  ccli_progress *progress = mem_alloc(CCLI_MEMORY_OUTPUT, sizeof(ccli_progress));
+  progress->interface = interface;
+  progress->label = label;
+  atomic_init(&progress->done, 0);
+  atomic_init(&progress->total, total);
+  progress->started = progress->last_time = monotonic_seconds();
+  progress->last_done = 0;
+  progress->rate = 0;
+  progress->frame = 0;
+  progress->stopping = false;
+  buffer_init(&progress->line);
+
+  // same rule as the colored output: only draw on stdout, and only if
+  // that's a terminal
+  progress->live = use_color(interface) && isatty(fileno(stdout));
+  if (progress->live) {
+    pthread_mutex_init(&progress->lock, NULL);
+    pthread_cond_init(&progress->wake, NULL);
+    pthread_create(&progress->renderer, NULL, progress_renderer_run, progress);
+  }
+  return progress;
+}
+
+void ccli_progress_add(ccli_progress *progress, uint64_t amount) {
+  atomic_fetch_add_explicit(&progress->done, amount, memory_order_relaxed);
+}
+
+void ccli_progress_set_total(ccli_progress *progress, uint64_t total) {
+  atomic_store_explicit(&progress->total, total, memory_order_relaxed);
+}
+
+uint64_t ccli_progress_done(ccli_progress *progress) {
+  return atomic_load_explicit(&progress->done, memory_order_relaxed);
+}
+
+void ccli_progress_finish(ccli_progress *progress) {
+  if (progress->live) {
+    pthread_mutex_lock(&progress->lock);
+    progress->stopping = true;
+    pthread_cond_signal(&progress->wake);
+    pthread_mutex_unlock(&progress->lock);
+    pthread_join(progress->renderer, NULL);
+
+    render_progress(progress, true);
+    pthread_mutex_destroy(&progress->lock);
+    pthread_cond_destroy(&progress->wake);
+  }
+
+  buffer_free(&progress->line);
+  mem_free(progress);
+}
+
+/******************** ccli logging ********************/
+
+// log records are collected here and written to stderr with one write
+// per flush, apart from interface->fp
+#define LOG_BUFFER_BYTES 4096
+
+static const char *log_level_names[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+
+static void log_init(ccli *interface) {
+  interface->log_level = CCLI_LOG_WARN;
+  interface->log_level_fixed = false;
+  interface->log_timestamps = false;
+  // a terminal gets each record as it's logged
+  interface->log_to_tty = isatty(STDERR_FILENO);
+  pthread_mutex_init(&interface->log_lock, NULL);
+  buffer_init(&interface->log_buffer);
+  interface->log_second = 0;
+  interface->log_stamp_length = 0;
+}
+
+// with [log_lock] held
+static void log_flush_locked(ccli *interface) {
+  ccli_buffer *buffer = &interface->log_buffer;
+  size_t written = 0;
+  while (written < buffer->size) {
+    ssize_t result = write(STDERR_FILENO, buffer->chars + written, buffer->size - written);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) break;
+    written += result;
+  }
+  buffer->size = 0;
+}
+
+static void log_flush(ccli *interface) {
+  pthread_mutex_lock(&interface->log_lock);
+  log_flush_locked(interface);
+  pthread_mutex_unlock(&interface->log_lock);
+}
+
+static void log_free(ccli *interface) {
+  log_flush(interface);
+  buffer_free(&interface->log_buffer);
+  pthread_mutex_destroy(&interface->log_lock);
+}
+
+// the runtime level, from the invoked command's --verbose and --quiet
+static void set_log_level(ccli *interface, ccli_command *command) {
+  if (interface->log_level_fixed) return;
+
+  int verbose = 0, quiet = 0;
+  ccli_table_get_int(&command->options, "--verbose", &verbose);
+  ccli_table_get_int(&command->options, "--quiet", &quiet);
+
+  int level = CCLI_LOG_WARN - verbose + quiet;
+  if (level < CCLI_LOG_TRACE) level = CCLI_LOG_TRACE;
+  // past ERROR, nothing is logged at all
+  if (level > CCLI_LOG_ERROR + 1) level = CCLI_LOG_ERROR + 1;
+  interface->log_level = level;
+}
+
+// every command takes -v/--verbose and -q/--quiet, unless it already
+// has options by those names. a command's own --verbose counter works.
+static void register_log_options(ccli *interface, ccli_command *command) {
+  char *names[][2] = { { "--verbose", "-v" }, { "--quiet", "-q" } };
+  char *descriptions[] = { "log more, once per use", "log less, once per use" };
+
+  for (int i = 0; i < 2; i++) {
+    if (ccli_table_find_option(&command->options, names[i][0])) continue;
+
+    char *short_name = ccli_table_find_option(&command->options, names[i][1]) ? NULL : names[i][1];
+    ccli_option *option = ccli_add_counter_option(interface, command, names[i][0], short_name);
+    ccli_option_set_description(option, descriptions[i]);
+  }
+}
+
+// the local time to the second, formatted again only when the second
+// changes. with [log_lock] held.
+static void append_log_timestamp(ccli *interface) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME_COARSE, &now);
+
+  if (now.tv_sec != interface->log_second || interface->log_stamp_length == 0) {
+    struct tm local;
+    localtime_r(&now.tv_sec, &local);
+    interface->log_stamp_length = strftime(interface->log_stamp, sizeof(interface->log_stamp), "%Y-%m-%d %H:%M:%S", &local);
+    interface->log_second = now.tv_sec;
+  }
+
+  buffer_append(&interface->log_buffer, interface->log_stamp, interface->log_stamp_length);
+  buffer_printf(&interface->log_buffer, ".%03d ", (int)(now.tv_nsec / 1000000));
+}
+
+bool ccli_log_enabled(ccli *interface, int level) {
+  return level >= interface->log_level;
+}
+
+void ccli_log_write(ccli *interface, int level, const char *format, ...) {
+  if (level < CCLI_LOG_TRACE || level > CCLI_LOG_ERROR) return;
+
+  pthread_mutex_lock(&interface->log_lock);
+  if (interface->log_timestamps) append_log_timestamp(interface);
+  buffer_printf(&interface->log_buffer, "%-5s ", log_level_names[level]);
+
+  va_list args;
+  va_start(args, format);
+  buffer_vprintf(&interface->log_buffer, format, args);
+  va_end(args);
+  buffer_append(&interface->log_buffer, "\n", 1);
+
+  // warnings and errors shouldn't wait behind a buffer
+  if (interface->log_to_tty || level >= CCLI_LOG_WARN || interface->log_buffer.size >= LOG_BUFFER_BYTES) {
+    log_flush_locked(interface);
+  }
+  pthread_mutex_unlock(&interface->log_lock);
+}
+
+void ccli_log_set_level(ccli *interface, int level) {
+  interface->log_level = level;
+  interface->log_level_fixed = true;
+}
+
+void ccli_log_set_timestamps(ccli *interface, bool timestamps) {
+  interface->log_timestamps = timestamps;
+}
+
+void ccli_log_flush(ccli *interface) {
+  log_flush(interface);
+}
+
+/******************** ccli tracing ********************/
+
+// spans and instant events, kept per thread and written out as Chrome
+// trace event json (for Perfetto or chrome://tracing) when the
+// interface is freed.
+//
+// each thread writes to its own ring, so recording takes no lock; a full
+// ring overwrites its oldest events.
+#define TRACE_RING_EVENTS 16384
+
+typedef enum {
+  TRACE_BEGIN,
+  TRACE_END,
+  TRACE_INSTANT
+} trace_event_type;
+
+typedef struct {
+  uint64_t timestamp;
+  const char *name;
+  trace_event_type type;
+} trace_event;
+
+typedef struct trace_ring {
+  int thread;
+  // events written, including overwritten ones
+  uint64_t written;
+  trace_event *events;
+  struct trace_ring *next;
+} trace_ring;
+
+struct trace_session {
+  // tells sessions apart, so a thread never writes to a stale ring
+  uint64_t id;
+  char *path;
+  uint64_t started;
+  pthread_mutex_t lock;
+  trace_ring *rings;
+  int threads;
+};
+
+static _Atomic uint64_t trace_session_ids = 1;
+static __thread trace_ring *thread_ring = NULL;
+static __thread uint64_t thread_ring_session = 0;
+
+static uint64_t trace_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void ccli_trace_start(ccli *interface, const char *path) {
+  if (interface->trace) return;
+
+  trace_session *trace = mem_alloc(CCLI_MEMORY_OTHER, sizeof(trace_session));
+  trace->id = atomic_fetch_add(&trace_session_ids, 1);
+  trace->path = mem_strdup(CCLI_MEMORY_OTHER, path);
+  trace->started = trace_now();
+  pthread_mutex_init(&trace->lock, NULL);
+  trace->rings = NULL;
+  trace->threads = 0;
+  interface->trace = trace;
+}
+
+static trace_ring *current_trace_ring(trace_session *trace) {
+  if (thread_ring && thread_ring_session == trace->id) return thread_ring;
+
+  trace_ring *ring = mem_alloc(CCLI_MEMORY_OTHER, sizeof(trace_ring));
+  ring->written = 0;
+  ring->events = mem_alloc(CCLI_MEMORY_OTHER, sizeof(trace_event) * TRACE_RING_EVENTS);
+
+  pthread_mutex_lock(&trace->lock);
+  ring->thread = ++trace->threads;
+  ring->next = trace->rings;
+  trace->rings = ring;
+  pthread_mutex_unlock(&trace->lock);
+
+  thread_ring = ring;
+  thread_ring_session = trace->id;
+  return ring;
+}
+
+static void trace_record(ccli *interface, const char *name, trace_event_type type) {
+  if (!interface->trace) return;
+
+  trace_ring *ring = current_trace_ring(interface->trace);
+  trace_event *event = &ring->events[ring->written++ % TRACE_RING_EVENTS];
+  event->timestamp = trace_now();
+  event->name = name;
+  event->type = type;
+}
+
+void ccli_trace_begin(ccli *interface, const char *name) {
+  trace_record(interface, name, TRACE_BEGIN);
+}
+
+void ccli_trace_end(ccli *interface) {
+  trace_record(interface, NULL, TRACE_END);
+}
+
+void ccli_trace_instant(ccli *interface, const char *name) {
+  trace_record(interface, name, TRACE_INSTANT);
+}
+
+static void write_trace_event(FILE *fp, ccli_buffer *line, trace_session *trace, int thread, trace_event *event) {
+  static const char phases[] = { 'B', 'E', 'i' };
+  uint64_t since = event->timestamp - trace->started;
+
+  line->size = 0;
+  buffer_append(line, ",\n{\"ph\":\"", 9);
+  buffer_append(line, &phases[event->type], 1);
+  buffer_printf(line, "\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 ".%03" PRIu64,
+                (int)getpid(), thread, since / 1000, since % 1000);
+  if (event->name) {
+    buffer_append(line, ",\"name\":", 8);
+    append_json_string(line, event->name, strlen(event->name));
+  }
+  // instant events are scoped to their thread
+  if (event->type == TRACE_INSTANT) buffer_append(line, ",\"s\":\"t\"", 8);
+  buffer_append(line, "}", 1);
+  fwrite(line->chars, 1, line->size, fp);
+}
+
+// write the trace out and stop tracing
+static void trace_finish(ccli *interface) {
+  trace_session *trace = interface->trace;
+  if (!trace) return;
+  interface->trace = NULL;
+
+  FILE *fp = fopen(trace->path, "w");
+  if (!fp) {
+    fprintf(stderr, "can't write trace to '%s': %s\n", trace->path, strerror(errno));
+  } else {
+    ccli_buffer line;
+    buffer_init(&line);
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":", (int)getpid());
+    append_json_string(&line, interface->exeName, strlen(interface->exeName));
+    fwrite(line.chars, 1, line.size, fp);
+    fprintf(fp, "}}");
+
+    for (trace_ring *ring = trace->rings; ring; ring = ring->next) {
+      fprintf(fp, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"thread %d\"}}",
+              (int)getpid(), ring->thread, ring->thread);
+
+      // oldest first
+      uint64_t first = (ring->written > TRACE_RING_EVENTS) ? ring->written - TRACE_RING_EVENTS : 0;
+      for (uint64_t i = first; i < ring->written; i++) {
+        write_trace_event(fp, &line, trace, ring->thread, &ring->events[i % TRACE_RING_EVENTS]);
+      }
+    }
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    buffer_free(&line);
+  }
+
+  trace_ring *ring = trace->rings;
+  while (ring) {
+    trace_ring *next = ring->next;
+    mem_free(ring->events);
+    mem_free(ring);
+    ring = next;
+  }
+  pthread_mutex_destroy(&trace->lock);
+  mem_free(trace->path);
+  mem_free(trace);
+}
+
+/******************** ccli bench ********************/
+
+// latencies are counted in log-linear buckets, like an HDR histogram: 64
+// linear sub-buckets per power of two keep each bucket within 1.6% of
+// the values in it, over the whole range of a uint64_t.
+#define BENCH_SUB_BITS 6
+#define BENCH_SUB_COUNT (1 << BENCH_SUB_BITS)
+#define BENCH_BUCKETS ((64 - BENCH_SUB_BITS) * BENCH_SUB_COUNT + BENCH_SUB_COUNT)
+
+static int bench_bucket(uint64_t nanoseconds) {
+  if (nanoseconds < 2 * BENCH_SUB_COUNT) return (int)nanoseconds;
+
+  int shift = 63 - __builtin_clzll(nanoseconds) - BENCH_SUB_BITS;
+  return shift * BENCH_SUB_COUNT + (int)(nanoseconds >> shift);
+}
+
+// the largest value that lands in [bucket]
+static uint64_t bench_bucket_max(int bucket) {
+  int shift = (bucket < 2 * BENCH_SUB_COUNT) ? 0 : bucket / BENCH_SUB_COUNT - 1;
+  uint64_t sub = bucket - shift * BENCH_SUB_COUNT;
+  return ((sub + 1) << shift) - 1;
+}
+
+// [permille] of 500 is the median
+static uint64_t bench_percentile(uint64_t *counts, uint64_t runs, uint64_t permille, uint64_t max) {
+  uint64_t rank = (runs * permille + 999) / 1000;
+  if (rank == 0) rank = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < BENCH_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) return (bench_bucket_max(i) < max) ? bench_bucket_max(i) : max;
+  }
+  return max;
+}
+
+static void print_bench_latency(const char *label, uint64_t nanoseconds) {
+  if (nanoseconds < 1000) fprintf(stderr, "  %-10s %8" PRIu64 " ns\n", label, nanoseconds);
+  else if (nanoseconds < 1000000) fprintf(stderr, "  %-10s %8.2f us\n", label, nanoseconds / 1e3);
+  else if (nanoseconds < 1000000000) fprintf(stderr, "  %-10s %8.2f ms\n", label, nanoseconds / 1e6);
+  else fprintf(stderr, "  %-10s %8.2f s\n", label, nanoseconds / 1e9);
+}
+
+// one run, as if the command were invoked fresh
+static void bench_callback(ccli *interface, size_t kept) {
+  interface->capture.size = kept;
+  interface->records_started = false;
+  interface->invoked_command->callback(interface);
+  finish_records(interface);
+}
+
+// call the invoked command's callback over and over, with everything it
+// prints thrown away, and report its latencies to stderr
+static void run_bench(ccli *interface) {
+  // output is still formatted, so that's part of what's measured, but
+  // it's dropped after each run
+  bool capturing = interface->capturing;
+  size_t kept = interface->capture.size;
+  interface->capturing = true;
+
+  for (uint64_t i = 0; i < interface->bench_warmup; i++) bench_callback(interface, kept);
+
+  uint64_t *counts = mem_calloc(CCLI_MEMORY_OTHER, BENCH_BUCKETS, sizeof(uint64_t));
+  uint64_t min = UINT64_MAX, max = 0;
+  uint64_t started = trace_now();
+  for (uint64_t i = 0; i < interface->bench_runs; i++) {
+    uint64_t start = trace_now();
+    bench_callback(interface, kept);
+    uint64_t latency = trace_now() - start;
+
+    counts[bench_bucket(latency)]++;
+    if (latency < min) min = latency;
+    if (latency > max) max = latency;
+  }
+  uint64_t elapsed = trace_now() - started;
+
+  interface->capture.size = kept;
+  interface->capturing = capturing;
+
+  uint64_t runs = interface->bench_runs;
+  fprintf(stderr, "bench: %s, %" PRIu64 " runs after %" PRIu64 " warmup\n",
+          interface->invoked_command->command, runs, interface->bench_warmup);
+  print_bench_latency("min", min);
+  print_bench_latency("median", bench_percentile(counts, runs, 500, max));
+  print_bench_latency("p90", bench_percentile(counts, runs, 900, max));
+  print_bench_latency("p99", bench_percentile(counts, runs, 990, max));
+  print_bench_latency("max", max);
+  fprintf(stderr, "  %-10s %8.0f runs/s\n", "throughput", runs / (elapsed / 1e9));
+  mem_free(counts);
+}
+
+/******************** ccli watch ********************/
+
+#define WATCH_DEFAULT_DEBOUNCE_MS 100
+// an event storm can hold off a run for at most this many intervals
+#define WATCH_MAX_DEBOUNCES 10
+
+// adds a copy of [path] unless it's already there
+static void path_list_add(value_vector *list, const char *path) {
+  char **paths = value_vector_items(list);
+  for (int i = 0; i < list->size; i++) {
+    if (!strcmp(paths[i], path)) return;
+  }
+
+  char *copy = mem_strdup(CCLI_MEMORY_OTHER, path);
+  value_vector_add(list, &copy);
+}
+
+static void path_list_clear(value_vector *list) {
+  char **paths = value_vector_items(list);
+  for (int i = 0; i < list->size; i++) mem_free(paths[i]);
+  list->size = 0;
+}
+
+static void path_list_free(value_vector *list) {
+  path_list_clear(list);
+  value_vector_free(list);
+}
+
+void ccli_watch_path(ccli *interface, const char *path) {
+  path_list_add(&interface->watch_paths, path);
+}
+
+bool ccli_get_changed_paths(ccli *interface, char ***paths, int *count) {
+  if (!interface->watch || interface->changed_paths.size == 0) return false;
+
+  *paths = value_vector_items(&interface->changed_paths);
+  *count = interface->changed_paths.size;
+  return true;
+}
+
+// a file is watched through its directory, so it's still seen when an
+// editor saves by writing a new file and renaming it over the old one
+typedef struct {
+  int wd;
+  char *path;
+  // the file's name in the watched directory, NULL if [path] is a
+  // directory that's watched as a whole
+  char *name;
+} watch_entry;
+
+typedef struct {
+  int fd;
+  int size;
+  int capacity;
+  watch_entry *entries;
+} watch_set;
+
+static void watch_set_clear(watch_set *set) {
+  for (int i = 0; i < set->size; i++) {
+    mem_free(set->entries[i].path);
+    mem_free(set->entries[i].name);
+  }
+  set->size = 0;
+}
+
+static void watch_set_add(ccli *interface, watch_set *set, const char *path) {
+  struct stat st;
+  bool is_dir = stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+  const char *slash = strrchr(path, '/');
+
+  char *dir, *name = NULL;
+  if (is_dir) {
+    dir = mem_strdup(CCLI_MEMORY_OTHER, path);
+  } else {
+    if (!slash) dir = mem_strdup(CCLI_MEMORY_OTHER, ".");
+    else if (slash == path) dir = mem_strdup(CCLI_MEMORY_OTHER, "/");
+    else dir = mem_strndup(CCLI_MEMORY_OTHER, path, slash - path);
+    name = mem_strdup(CCLI_MEMORY_OTHER, slash ? slash + 1 : path);
+  }
+
+  uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+  int wd = inotify_add_watch(set->fd, dir, mask);
+  mem_free(dir);
+  if (wd < 0) {
+    ccli_log(interface, WARN, "can't watch '%s': %s", path, strerror(errno));
+    mem_free(name);
+    return;
+  }
+
+  if (set->size + 1 > set->capacity) {
+    set->capacity = GROW_ARRAY_CAPACITY(set->capacity);
+    set->entries = mem_realloc(CCLI_MEMORY_OTHER, set->entries, sizeof(watch_entry) * set->capacity);
+  }
+  set->entries[set->size++] = (watch_entry){ wd, mem_strdup(CCLI_MEMORY_OTHER, path), name };
+}
+
+static void watch_file_value(ccli *interface, watch_set *set, ccli_value value) {
+  if (IS_FILE(value) && !AS_FILE(value)->is_stdin) watch_set_add(interface, set, AS_FILE(value)->path);
+}
+
+// the command's file arguments and options, and the paths the program
+// asked for. watches that are already there are just looked up again.
+static void watch_set_build(ccli *interface, watch_set *set) {
+  ccli_command *command = interface->invoked_command;
+  watch_set_clear(set);
+
+  for (int i = 0; i < command->args.size; i++) watch_file_value(interface, set, command->args.args[i]->value);
+  for (int i = 0; i < command->option_list.size; i++) {
+    watch_file_value(interface, set, command->option_list.options[i]->value);
+  }
+
+  char **paths = value_vector_items(&interface->watch_paths);
+  for (int i = 0; i < interface->watch_paths.size; i++) watch_set_add(interface, set, paths[i]);
+}
+
+static void watch_event(ccli *interface, watch_set *set, struct inotify_event *event) {
+  // the kernel dropped events, so anything could have changed
+  if (event->mask & IN_Q_OVERFLOW) {
+    for (int i = 0; i < set->size; i++) path_list_add(&interface->changed_paths, set->entries[i].path);
+    return;
+  }
+
+  for (int i = 0; i < set->size; i++) {
+    watch_entry *entry = &set->entries[i];
+    if (entry->wd != event->wd) continue;
+
+    if (!entry->name) {
+      if (event->len == 0) {
+        path_list_add(&interface->changed_paths, entry->path);
+      } else {
+        ccli_buffer path;
+        buffer_init(&path);
+        buffer_printf(&path, "%s/%s", entry->path, event->name);
+        path_list_add(&interface->changed_paths, path.chars);
+        buffer_free(&path);
+      }
+    } else if (event->len > 0 && !strcmp(entry->name, event->name)) {
+      path_list_add(&interface->changed_paths, entry->path);
+    }
+  }
+}
+
+// block until a watched path changes, then keep collecting changes until
+// they stop for the debounce interval, so a save that touches a file
+// several times, or a checkout that touches hundreds, is one run
+static void watch_wait(ccli *interface, watch_set *set) {
+  char events[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+  uint64_t debounce = interface->watch_debounce_ms;
+  uint64_t deadline = 0;
+
+  for (;;) {
+    int timeout = -1;
+    if (deadline) {
+      uint64_t now = trace_now();
+      if (now >= deadline) return;
+      uint64_t left = (deadline - now) / 1000000;
+      timeout = (int)((left < debounce) ? left : debounce);
+    }
+
+    struct pollfd poll_fd = { set->fd, POLLIN, 0 };
+    int ready = poll(&poll_fd, 1, timeout);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready < 0) ccli_runtime_error(interface, "can't wait for changes: %s.", strerror(errno));
+    // quiet for a whole interval
+    if (ready == 0) return;
+
+    ssize_t length = read(set->fd, events, sizeof(events));
+    if (length < 0 && errno == EINTR) continue;
+    if (length < 0) ccli_runtime_error(interface, "can't read changes: %s.", strerror(errno));
+
+    for (char *at = events; at < events + length;) {
+      struct inotify_event *event = (struct inotify_event *)at;
+      watch_event(interface, set, event);
+      at += sizeof(struct inotify_event) + event->len;
+    }
+
+    if (interface->changed_paths.size > 0 && !deadline) {
+      deadline = trace_now() + WATCH_MAX_DEBOUNCES * debounce * 1000000;
+    }
+  }
+}
+
+static void reopen_file_value(ccli_value value) {
+  if (IS_FILE(value)) file_reopen(AS_FILE(value));
+}
+
+static void watch_callback(ccli *interface) {
+  interface->records_started = false;
+  interface->invoked_command->callback(interface);
+  finish_records(interface);
+  fflush(interface->fp);
+}
+
+// run the callback, then again each time its inputs change, until the
+// process is stopped
+static void run_watch(ccli *interface) {
+  ccli_command *command = interface->invoked_command;
+  watch_set set = { inotify_init1(IN_CLOEXEC), 0, 0, NULL };
+  if (set.fd < 0) ccli_runtime_error(interface, "can't watch for changes: %s.", strerror(errno));
+
+  // changes made while the callback runs are queued, not missed
+  watch_set_build(interface, &set);
+  for (;;) {
+    watch_callback(interface);
+    // the callback may have asked for more paths
+    watch_set_build(interface, &set);
+
+    path_list_clear(&interface->changed_paths);
+    watch_wait(interface, &set);
+    ccli_log(interface, INFO, "%d paths changed, running again", interface->changed_paths.size);
+
+    for (int i = 0; i < command->args.size; i++) reopen_file_value(command->args.args[i]->value);
+    for (int i = 0; i < command->option_list.size; i++) reopen_file_value(command->option_list.options[i]->value);
+  }
+}
+
+/******************** ccli cache ********************/
+
+// a cacheable command's result is stored under a hash of everything it
+// can depend on: its name, every option and argument value (defaults
+// included), and the identity, size and mtime of its input files. an
+// entry is a header, the full key (so a hash collision is a miss), and
+// the output. the least recently used entries are dropped once the
+// directory outgrows its bound.
+#define CACHE_MAGIC 0x3145484341434343ull
+
+typedef struct {
+  uint64_t magic;
+  uint64_t key_length;
+  uint64_t output_length;
+  int64_t status;
+} cache_header;
+
+void ccli_set_cache(ccli *interface, const char *dir, size_t max_bytes) {
+  mem_free(interface->cache_dir);
+  interface->cache_dir = dir ? mem_strdup(CCLI_MEMORY_OTHER, dir) : NULL;
+  interface->cache_max_bytes = max_bytes ? max_bytes : CACHE_DEFAULT_MAX_BYTES;
+}
+
+// $XDG_CACHE_HOME/NAME or ~/.cache/NAME, unless one was set
+static const char *cache_dir(ccli *interface) {
+  if (interface->cache_dir) return interface->cache_dir;
+
+  const char *name = strrchr(interface->exeName, '/');
+  name = name ? name + 1 : interface->exeName;
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+
+  ccli_buffer dir;
+  buffer_init(&dir);
+  if (xdg && *xdg) buffer_printf(&dir, "%s/%s", xdg, name);
+  else if (home && *home) buffer_printf(&dir, "%s/.cache/%s", home, name);
+  else return NULL;
+
+  interface->cache_dir = dir.chars;
+  return interface->cache_dir;
+}
+
+static uint64_t hash_bytes(const char *chars, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)chars[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static void key_append(ccli_buffer *key, const void *bytes, size_t length) {
+  buffer_append(key, bytes, length);
+}
+
+static void key_append_string(ccli_buffer *key, const char *string) {
+  uint64_t length = string ? strlen(string) : UINT64_MAX;
+  key_append(key, &length, sizeof(length));
+  if (string) key_append(key, string, length);
+}
+
+// false if [value] can't be part of a key, like a file on stdin
+static bool key_append_value(ccli_buffer *key, ccli_value value) {
+  char type = value.type;
+  key_append(key, &type, 1);
+
+  switch (value.type) {
+    case VAL_NUM:    key_append(key, &AS_DOUBLE(value), sizeof(double)); break;
+    case VAL_BOOL:   key_append(key, &AS_BOOL(value), sizeof(bool)); break;
+    case VAL_STRING: key_append_string(key, AS_STRING(value)); break;
+    case VAL_CHOICE: key_append(key, &AS_CHOICE(value), sizeof(int)); break;
+    case VAL_INT64:  key_append(key, &AS_INT64(value), sizeof(int64_t)); break;
+    case VAL_UINT64: key_append(key, &AS_UINT64(value), sizeof(uint64_t)); break;
+    case VAL_TYPED: {
+      typed_slot *slot = AS_TYPED(value);
+      key_append_string(key, slot->type->name);
+      key_append(key, slot->data, slot->type->size);
+      break;
+    }
+    case VAL_RANGE_LIST: {
+      ccli_range_list *ranges = AS_RANGE(value);
+      key_append(key, &ranges->count, sizeof(uint64_t));
+      key_append(key, &ranges->is_bitset, sizeof(bool));
+      if (ranges->is_bitset) key_append(key, ranges->bits.bits, sizeof(uint64_t) * ranges->bits.words);
+      else key_append(key, ranges->intervals, sizeof(range_interval) * ranges->size);
+      break;
+    }
+    case VAL_FILE: {
+      ccli_file *file = AS_FILE(value);
+      struct stat st;
+      if (file->is_stdin || fstat(file->fd, &st) < 0) return false;
+
+      // a changed file almost always has a new size or mtime, and
+      // checking is far cheaper than hashing its contents
+      key_append_string(key, file->path);
+      uint64_t fingerprint[5] = { st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec };
+      key_append(key, fingerprint, sizeof(fingerprint));
+      break;
+    }
+    default:
+      break;
+  }
+
+  return true;
+}
+
+static bool build_cache_key(ccli *interface, ccli_buffer *key) {
+  ccli_command *command = interface->invoked_command;
+  key_append_string(key, interface->exeName);
+  key_append_string(key, command->command);
+  // colored output isn't replayed where it shouldn't be
+  bool color = use_color(interface);
+  key_append(key, &color, sizeof(bool));
+  key_append(key, &interface->output_format, sizeof(ccli_output_format));
+
+  for (int i = 0; i < command->option_list.size; i++) {
+    ccli_option *option = command->option_list.options[i];
+    bool present = bitset_test(&command->present, i);
+    key_append(key, &present, sizeof(bool));
+    if (!key_append_value(key, option->value)) return false;
+
+    if (option->type == VAL_STRING_LIST) {
+      char **items = value_vector_items(&option->values);
+      key_append(key, &option->values.size, sizeof(int));
+      for (int j = 0; j < option->values.size; j++) key_append_string(key, items[j]);
+    } else if (option->type == VAL_NUM_LIST) {
+      key_append(key, &option->values.size, sizeof(int));
+      key_append(key, value_vector_items(&option->values), sizeof(double) * option->values.size);
+    }
+  }
+
+  for (int i = 0; i < command->args.size; i++) {
+    if (!key_append_value(key, command->args.args[i]->value)) return false;
+  }
+
+  return true;
+}
+
+static void cache_entry_path(ccli_buffer *path, const char *dir, ccli_buffer *key) {
+  buffer_printf(path, "%s/%016" PRIx64, dir, hash_bytes(key->chars, key->size));
+}
+
+// write out the stored result of an identical earlier run, if there is
+// one. a stored error exits with its status, like the run did.
+static bool cache_replay(ccli *interface) {
+  interface->cache_key.size = 0;
+  if (!interface->invoked_command->cacheable || interface->bench_runs || interface->watch) return false;
+
+  const char *dir = cache_dir(interface);
+  if (!dir || !build_cache_key(interface, &interface->cache_key)) {
+    interface->cache_key.size = 0;
+    return false;
+  }
+
+  ccli_buffer path;
+  buffer_init(&path);
+  cache_entry_path(&path, dir, &interface->cache_key);
+  int fd = open(path.chars, O_RDONLY | O_CLOEXEC);
+  buffer_free(&path);
+  if (fd < 0) return false;
+
+  cache_header header;
+  struct stat st;
+  ccli_buffer *key = &interface->cache_key;
+  bool hit = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+             header.magic == CACHE_MAGIC && header.key_length == key->size &&
+             (uint64_t)st.st_size == sizeof(header) + header.key_length + header.output_length;
+
+  char *entry = MAP_FAILED;
+  if (hit) {
+    entry = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    hit = entry != MAP_FAILED && !memcmp(entry + sizeof(header), key->chars, key->size);
+  }
+
+  if (hit) {
+    // the mtime is when the entry was last used
+    futimens(fd, NULL);
+    output_write(interface, entry + sizeof(header) + header.key_length, header.output_length);
+  }
+
+  if (entry != MAP_FAILED) munmap(entry, st.st_size);
+  close(fd);
+  if (hit && header.status != 0) {
+    // already stored, don't store it again on the way out
+    interface->cache_key.size = 0;
+    ccli_exit(interface, (int)header.status);
+  }
+  return hit;
+}
+
+static void cache_begin(ccli *interface) {
+  if (interface->cache_key.size == 0) return;
+
+  interface->cache_output.size = 0;
+  interface->tee = &interface->cache_output;
+  interface->cache_thread = pthread_self();
+}
+
+static bool make_dirs(const char *path) {
+  char *copy = mem_strdup(CCLI_MEMORY_OTHER, path);
+  for (char *slash = strchr(copy + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(copy, 0755);
+    *slash = '/';
+  }
+
+  bool made = mkdir(copy, 0755) == 0 || errno == EEXIST;
+  mem_free(copy);
+  return made;
+}
+
+typedef struct {
+  char name[17];
+  struct timespec used;
+  off_t size;
+} cache_file;
+
+static int compare_cache_files(const void *a, const void *b) {
+  const cache_file *left = a;
+  const cache_file *right = b;
+  if (left->used.tv_sec != right->used.tv_sec) return (left->used.tv_sec < right->used.tv_sec) ? -1 : 1;
+  if (left->used.tv_nsec != right->used.tv_nsec) return (left->used.tv_nsec < right->used.tv_nsec) ? -1 : 1;
+  return 0;
+}
+
+// drop the least recently used entries until the cache fits its bound
+static void cache_evict(ccli *interface, const char *path) {
+  DIR *dir = opendir(path);
+  if (!dir) return;
+
+  int size = 0, capacity = 0;
+  cache_file *files = NULL;
+  uint64_t total = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    struct stat st;
+    // entries are named by their 16 digit hash, anything else isn't ours
+    if (strlen(entry->d_name) != 16 || fstatat(dirfd(dir), entry->d_name, &st, 0) < 0) continue;
+
+    if (size + 1 > capacity) {
+      capacity = GROW_ARRAY_CAPACITY(capacity);
+      files = mem_realloc(CCLI_MEMORY_OTHER, files, sizeof(cache_file) * capacity);
+    }
+    memcpy(files[size].name, entry->d_name, 17);
+    files[size].used = st.st_mtim;
+    files[size].size = st.st_size;
+    total += st.st_size;
+    size++;
+  }
+
+  if (total > interface->cache_max_bytes) {
+    qsort(files, size, sizeof(cache_file), compare_cache_files);
+    for (int i = 0; i < size && total > interface->cache_max_bytes; i++) {
+      if (unlinkat(dirfd(dir), files[i].name, 0) == 0) total -= files[i].size;
+    }
+  }
+
+  mem_free(files);
+  closedir(dir);
+}
+
+// store what the callback printed, and how it ended. runs after the
+// callback, or on its way out through an error.
+static void cache_finish(ccli *interface, int status) {
+  if (!interface->tee || !pthread_equal(pthread_self(), interface->cache_thread)) return;
+  interface->tee = NULL;
+
+  const char *dir = cache_dir(interface);
+  ccli_buffer *key = &interface->cache_key;
+  ccli_buffer *output = &interface->cache_output;
+  if (!make_dirs(dir)) return;
+
+  ccli_buffer path, temporary;
+  buffer_init(&path);
+  buffer_init(&temporary);
+  cache_entry_path(&path, dir, key);
+  // written aside and renamed into place, so a reader never sees half of it
+  buffer_printf(&temporary, "%s.%d.tmp", path.chars, (int)getpid());
+
+  cache_header header = { CACHE_MAGIC, key->size, output->size, status };
+  int fd = open(temporary.chars, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd >= 0) {
+    struct iovec iov[3] = {
+      { &header, sizeof(header) },
+      { key->chars, key->size },
+      { output->chars, output->size },
+    };
+    bool written = write_all(fd, iov, 3);
+    close(fd);
+    if (!written || rename(temporary.chars, path.chars) < 0) unlink(temporary.chars);
+    else cache_evict(interface, dir);
+  }
+
+  buffer_free(&path);
+  buffer_free(&temporary);
+}
+
+/******************** ccli_arg retrieval ********************/
+
+static void check_valid_arg_index(ccli *interface, int index) {
+  if (!interface->invoked_command) {
+    ccli_runtime_error(interface, "No command has been invoked yet.");
+  } else if (interface->invoked_command->args.size <= index) {
+    ccli_runtime_error(interface, "invalid arg index: max is %d, but you used %d.", interface->invoked_command->args.size - 1, index);
+  }
+}
+
+int ccli_get_int_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_NUM(value)) return AS_INT(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a number.", index);
+}
+
+double ccli_get_double_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_NUM(value)) return AS_DOUBLE(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a number.", index);
+}
+
+bool ccli_get_bool_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_BOOL(value)) return AS_BOOL(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a boolean.", index);
+}
+
+char *ccli_get_string_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_STRING(value)) return AS_STRING(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a string.", index);
+}
+
+int64_t ccli_get_int64_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_INT64(value)) return AS_INT64(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't an int64.", index);
+}
+
+uint64_t ccli_get_uint64_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_UINT64(value)) return AS_UINT64(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a uint64.", index);
+}
+
+ccli_file *ccli_get_file_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_FILE(value)) return AS_FILE(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a file.", index);
+}
+
+const void *ccli_get_typed_arg(ccli *interface, int index, ccli_type *type) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_TYPED(value) && AS_TYPED(value)->type == type) return AS_TYPED(value)->data;
+  else ccli_runtime_error(interface, "argument at index %d isn't a %s.", index, type->name);
+}
+
+ccli_range_list *ccli_get_range_arg(ccli *interface, int index) {
+  check_valid_arg_index(interface, index);
+
+  ccli_value value = interface->invoked_command->args.args[index]->value;
+  if (IS_RANGE(value)) return AS_RANGE(value);
+  else ccli_runtime_error(interface, "argument at index %d isn't a range list.", index);
+}
+
+/******************** ccli_for_each_line ********************/
+
+// worker count for the parallel helpers: the invoked command's --jobs
+// option if it has one and it was given, otherwise one per online cpu
+static int resolve_jobs(ccli *interface) {
+  ccli_command *command = interface->invoked_command;
+  if (command) {
+    ccli_option *jobs = ccli_table_find_option(&command->options, "--jobs");
+    if (jobs && bitset_test(&command->present, jobs->index)) {
+      if (IS_NUM(jobs->value) && AS_INT(jobs->value) > 0) return AS_INT(jobs->value);
+      if (IS_INT64(jobs->value) && AS_INT64(jobs->value) > 0) return (int)AS_INT64(jobs->value);
+      if (IS_UINT64(jobs->value) && AS_UINT64(jobs->value) > 0) return (int)AS_UINT64(jobs->value);
+    }
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return (cpus > 0) ? (int)cpus : 1;
+}
+
+#define LINE_CHUNK_SIZE (1024 * 1024)
+
+typedef struct {
+  const char *data;
+  size_t length;
+  // streamed chunks own their bytes, mapped ones point into the file
+  char *owned;
+  ccli_buffer output;
+  bool done;
+} line_chunk;
+
+typedef struct {
+  ccli *interface;
+  ccli_line_callback callback;
+  void *context;
+  size_t chunk_size;
+
+  // input that's already in memory, split in place
+  const char *data;
+  size_t length;
+  size_t offset;
+
+  // input that's read as it goes, with the partial last line of
+  // each read carried over to the next chunk
+  int fd;
+  bool streaming;
+  char *carry;
+  size_t carry_length;
+
+  bool input_done;
+  bool failed;
+  // one worker reads at a time, without the lock, since a read from a
+  // pipe can block for as long as the other end takes to fill a chunk
+  bool reading;
+
+  // chunks [next_write, next_read) are in flight. each one has a slot
+  // in a ring of [window] slots, so at most [window] chunks of input
+  // and output are held in memory at once.
+  pthread_mutex_t lock;
+  pthread_cond_t chunk_done;
+  pthread_cond_t slot_free;
+  long next_read;
+  long next_write;
+  int window;
+  line_chunk *slots;
+} line_pipeline;
+
+static void run_lines(line_pipeline *pipeline, const char *data, size_t length) {
+  const char *end = data + length;
+  while (data < end) {
+    const char *newline = memchr(data, '\n', end - data);
+    size_t line_length = (newline ? newline : end) - data;
+    pipeline->callback(pipeline->interface, data, line_length, pipeline->context);
+    data += line_length + 1;
+  }
+}
+
+// read the next newline-aligned chunk of a stream. returns false at the
+// end of input.
+static bool read_stream_chunk(line_pipeline *pipeline, line_chunk *chunk) {
+  size_t capacity = pipeline->chunk_size + pipeline->carry_length;
+  char *data = mem_alloc(CCLI_MEMORY_PARSE, capacity);
+  size_t length = pipeline->carry_length;
+  if (pipeline->carry_length) memcpy(data, pipeline->carry, pipeline->carry_length);
+  pipeline->carry_length = 0;
+
+  bool eof = false;
+  const char *last_newline = NULL;
+  for (;;) {
+    while (length < capacity) {
+      ssize_t count = read(pipeline->fd, data + length, capacity - length);
+      if (count < 0 && errno == EINTR) continue;
+      if (count <= 0) {
+        if (count < 0) pipeline->failed = true;
+        eof = true;
+        break;
+      }
+      length += count;
+    }
+
+    if (eof) break;
+    last_newline = memrchr(data, '\n', length);
+    if (last_newline) break;
+
+    // a single line longer than the chunk, keep reading until it ends
+    capacity *= 2;
+    data = mem_realloc(CCLI_MEMORY_PARSE, data, capacity);
+  }
+
+  if (length == 0) {
+    mem_free(data);
+    return false;
+  }
+
+  chunk->owned = data;
+  chunk->data = data;
+  chunk->length = length;
+
+  if (!eof) {
+    size_t keep = last_newline - data + 1;
+    pipeline->carry_length = length - keep;
+    if (pipeline->carry_length) {
+      pipeline->carry = mem_realloc(CCLI_MEMORY_PARSE, pipeline->carry, pipeline->carry_length);
+      memcpy(pipeline->carry, data + keep, pipeline->carry_length);
+    }
+    chunk->length = keep;
+  }
+
+  return true;
+}
+
+static bool read_mapped_chunk(line_pipeline *pipeline, line_chunk *chunk) {
+  if (pipeline->offset >= pipeline->length) return false;
+
+  size_t start = pipeline->offset;
+  size_t end = start + pipeline->chunk_size;
+  if (end >= pipeline->length) {
+    end = pipeline->length;
+  } else {
+    const char *newline = memchr(pipeline->data + end, '\n', pipeline->length - end);
+    end = newline ? (size_t)(newline - pipeline->data) + 1 : pipeline->length;
+  }
+
+  chunk->owned = NULL;
+  chunk->data = pipeline->data + start;
+  chunk->length = end - start;
+  pipeline->offset = end;
+  return true;
+}
+
+static bool read_chunk(line_pipeline *pipeline, line_chunk *chunk) {
+  return pipeline->streaming ? read_stream_chunk(pipeline, chunk) : read_mapped_chunk(pipeline, chunk);
+}
+
+static void *line_worker(void *arg) {
+  line_pipeline *pipeline = arg;
+
+  pthread_mutex_lock(&pipeline->lock);
+  for (;;) {
+    while (!pipeline->input_done &&
+           (pipeline->reading || pipeline->next_read - pipeline->next_write >= pipeline->window)) {
+      pthread_cond_wait(&pipeline->slot_free, &pipeline->lock);
+    }
+    if (pipeline->input_done) break;
+
+    // the slot stays out of the writer's sight until next_read moves past it
+    line_chunk *chunk = &pipeline->slots[pipeline->next_read % pipeline->window];
+    pipeline->reading = true;
+    pthread_mutex_unlock(&pipeline->lock);
+    bool more = read_chunk(pipeline, chunk);
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->reading = false;
+
+    if (!more) {
+      pipeline->input_done = true;
+      pthread_cond_broadcast(&pipeline->slot_free);
+      pthread_cond_broadcast(&pipeline->chunk_done);
+      break;
+    }
+
+    chunk->done = false;
+    pipeline->next_read++;
+    pthread_cond_broadcast(&pipeline->slot_free);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    thread_output = &chunk->output;
+    run_lines(pipeline, chunk->data, chunk->length);
+    thread_output = NULL;
+
+    pthread_mutex_lock(&pipeline->lock);
+    chunk->done = true;
+    pthread_cond_broadcast(&pipeline->chunk_done);
+  }
+  pthread_mutex_unlock(&pipeline->lock);
+
+  return NULL;
+}
+
+// emit finished chunks in input order, until every chunk is written
+static void write_chunks(line_pipeline *pipeline) {
+  pthread_mutex_lock(&pipeline->lock);
+  for (;;) {
+    line_chunk *chunk = &pipeline->slots[pipeline->next_write % pipeline->window];
+    while (!(pipeline->next_write < pipeline->next_read && chunk->done) &&
+           !(pipeline->input_done && pipeline->next_write == pipeline->next_read)) {
+      pthread_cond_wait(&pipeline->chunk_done, &pipeline->lock);
+    }
+
+    if (pipeline->next_write == pipeline->next_read) break;
+    pthread_mutex_unlock(&pipeline->lock);
+
+    output_write_buffer(pipeline->interface, &chunk->output);
+    chunk->output.size = 0;
+    mem_free(chunk->owned);
+    chunk->owned = NULL;
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->next_write++;
+    pthread_cond_broadcast(&pipeline->slot_free);
+  }
+  pthread_mutex_unlock(&pipeline->lock);
+}
+
+bool ccli_for_each_line(ccli *interface, ccli_file *source, ccli_line_callback callback, ccli_line_options *options) {
+  line_pipeline pipeline;
+  pipeline.interface = interface;
+  pipeline.callback = callback;
+  pipeline.context = options ? options->context : NULL;
+  pipeline.chunk_size = (options && options->chunk_size) ? options->chunk_size : LINE_CHUNK_SIZE;
+  pipeline.fd = source->fd;
+  pipeline.carry = NULL;
+  pipeline.carry_length = 0;
+  pipeline.input_done = false;
+  pipeline.failed = false;
+  pipeline.reading = false;
+  pipeline.offset = 0;
+
+  int threads = (options && options->threads > 0) ? options->threads : resolve_jobs(interface);
+
+  // regular files are split in place, anything else is streamed
+  struct stat st;
+  pipeline.streaming = !source->loaded &&
+                       (source->is_stdin || fstat(source->fd, &st) < 0 || !S_ISREG(st.st_mode));
+  if (!pipeline.streaming) {
+    pipeline.data = ccli_file_data(source, &pipeline.length);
+    if (!pipeline.data) return false;
+  }
+
+  if (threads == 1) {
+    // no workers to hand off to, run the lines right here
+    line_chunk chunk;
+    while (read_chunk(&pipeline, &chunk)) {
+      run_lines(&pipeline, chunk.data, chunk.length);
+      mem_free(chunk.owned);
+    }
+    mem_free(pipeline.carry);
+    return !pipeline.failed;
+  }
+
+  pipeline.next_read = 0;
+  pipeline.next_write = 0;
+  pipeline.window = threads * 2;
+  pipeline.slots = mem_alloc(CCLI_MEMORY_PARSE, sizeof(line_chunk) * pipeline.window);
+  for (int i = 0; i < pipeline.window; i++) {
+    pipeline.slots[i].owned = NULL;
+    pipeline.slots[i].done = false;
+    buffer_init(&pipeline.slots[i].output);
+  }
+  pthread_mutex_init(&pipeline.lock, NULL);
+  pthread_cond_init(&pipeline.chunk_done, NULL);
+  pthread_cond_init(&pipeline.slot_free, NULL);
+
+  pthread_t *workers = mem_alloc(CCLI_MEMORY_PARSE, sizeof(pthread_t) * threads);
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, line_worker, &pipeline);
+  }
+
+  write_chunks(&pipeline);
+
+  for (int i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  mem_free(workers);
+
+  for (int i = 0; i < pipeline.window; i++) {
+    buffer_free(&pipeline.slots[i].output);
+  }
+  mem_free(pipeline.slots);
+  mem_free(pipeline.carry);
+  pthread_mutex_destroy(&pipeline.lock);
+  pthread_cond_destroy(&pipeline.chunk_done);
+  pthread_cond_destroy(&pipeline.slot_free);
+
+  return !pipeline.failed;
+}
+
+/******************** ccli_parallel_for ********************/
+
+// each worker owns a contiguous range of item indices and takes items
+// from its front. a worker that runs dry steals the back half of
+// another worker's range, so uneven items still keep every core busy.
+typedef struct {
+  pthread_mutex_t lock;
+  size_t next;
+  size_t end;
+} task_range;
+
+typedef struct {
+  ccli *interface;
+  ccli_task_callback callback;
+  void *context;
+  int workers;
+  task_range *ranges;
+
+  // per-item output, written out in item order by the calling thread
+  ccli_buffer *outputs;
+  bool *done;
+  pthread_mutex_t lock;
+  pthread_cond_t task_done;
+} task_pool;
+
+typedef struct {
+  task_pool *pool;
+  int worker;
+} task_worker;
+
+static bool take_task(task_pool *pool, int worker, size_t *index) {
+  task_range *own = &pool->ranges[worker];
+
+  pthread_mutex_lock(&own->lock);
+  if (own->next < own->end) {
+    *index = own->next++;
+    pthread_mutex_unlock(&own->lock);
+    return true;
+  }
+  pthread_mutex_unlock(&own->lock);
+
+  for (int i = 1; i < pool->workers; i++) {
+    task_range *victim = &pool->ranges[(worker + i) % pool->workers];
+
+    pthread_mutex_lock(&victim->lock);
+    size_t remaining = victim->end - victim->next;
+    if (remaining == 0) {
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+
+    size_t stolen = (remaining + 1) / 2;
+    size_t start = victim->end - stolen;
+    victim->end = start;
+    pthread_mutex_unlock(&victim->lock);
+
+    // run the first stolen item now, keep the rest
+    pthread_mutex_lock(&own->lock);
+    own->next = start + 1;
+    own->end = start + stolen;
+    pthread_mutex_unlock(&own->lock);
+
+    *index = start;
+    return true;
+  }
+
+  return false;
+}
+
+static void *task_worker_run(void *arg) {
+  task_worker *worker = arg;
+  task_pool *pool = worker->pool;
+
+  size_t index;
+  while (take_task(pool, worker->worker, &index)) {
+    thread_output = &pool->outputs[index];
+    pool->callback(pool->interface, index, pool->context);
+    thread_output = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->done[index] = true;
+    pthread_cond_signal(&pool->task_done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+void ccli_parallel_for(ccli *interface, size_t count, ccli_task_callback callback, void *context) {
+  if (count == 0) return;
+
+  int workers = resolve_jobs(interface);
+  if ((size_t)workers > count) workers = (int)count;
+
+  if (workers == 1) {
+    for (size_t i = 0; i < count; i++) {
+      callback(interface, i, context);
+    }
+    return;
+  }
+
+  task_pool pool;
+  pool.interface = interface;
+  pool.callback = callback;
+  pool.context = context;
+  pool.workers = workers;
+  pool.ranges = mem_alloc(CCLI_MEMORY_OTHER, sizeof(task_range) * workers);
+  pool.outputs = mem_alloc(CCLI_MEMORY_OTHER, sizeof(ccli_buffer) * count);
+  pool.done = mem_calloc(CCLI_MEMORY_OTHER, count, sizeof(bool));
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.task_done, NULL);
+
+  for (size_t i = 0; i < count; i++) {
+    buffer_init(&pool.outputs[i]);
+  }
+
+  for (int i = 0; i < workers; i++) {
+    pthread_mutex_init(&pool.ranges[i].lock, NULL);
+    pool.ranges[i].next = count * i / workers;
+    pool.ranges[i].end = count * (i + 1) / workers;
+  }
+
+  task_worker *contexts = mem_alloc(CCLI_MEMORY_OTHER, sizeof(task_worker) * workers);
+  pthread_t *threads = mem_alloc(CCLI_MEMORY_OTHER, sizeof(pthread_t) * workers);
+  for (int i = 0; i < workers; i++) {
+    contexts[i].pool = &pool;
+    contexts[i].worker = i;
+    pthread_create(&threads[i], NULL, task_worker_run, &contexts[i]);
+  }
+
+  // flush each item's output as soon as everything before it is out
+  for (size_t i = 0; i < count; i++) {
+    pthread_mutex_lock(&pool.lock);
+    while (!pool.done[i]) pthread_cond_wait(&pool.task_done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+
+    output_write_buffer(interface, &pool.outputs[i]);
+    buffer_free(&pool.outputs[i]);
+  }
+
+  for (int i = 0; i < workers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  for (int i = 0; i < workers; i++) {
+    pthread_mutex_destroy(&pool.ranges[i].lock);
+  }
+
+  mem_free(threads);
+  mem_free(contexts);
+  mem_free(pool.ranges);
+  mem_free(pool.outputs);
+  mem_free(pool.done);
+  pthread_mutex_destroy(&pool.lock);
+  pthread_cond_destroy(&pool.task_done);
+}
+
+/******************** ccli plugins ********************/
+
+// a shared object from ccli_add_plugin_dir. until one of its commands is
+// dispatched, they're stubs made from its manifest, and it isn't loaded
+struct plugin_library {
+  char *path;
+  // the manifest section, NUL terminated. stub names and descriptions
+  // point into it
+  char *manifest;
+  // NULL until loaded
+  void *handle;
+};
+
+#define PLUGIN_ELF_CLASS ((sizeof(void *) == 8) ? ELFCLASS64 : ELFCLASS32)
+
+static ccli_command *find_command(ccli *interface, const char *name);
+
+// copies out the manifest section of the shared object at [path]. it's
+// read as a plain file, so none of the plugin's code is mapped or run.
+// NULL if it isn't a shared object with a manifest.
+static char *plugin_read_manifest(const char *path, size_t *length) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size >= sizeof(ElfW(Ehdr))) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) return NULL;
+
+  const unsigned char *file = map;
+  const ElfW(Ehdr) *header = map;
+  size_t size = st.st_size;
+  char *manifest = NULL;
+
+  // nothing past the header is trusted until it's known to be inside the file
+  bool valid = !memcmp(header->e_ident, ELFMAG, SELFMAG) && header->e_ident[EI_CLASS] == PLUGIN_ELF_CLASS &&
+               header->e_type == ET_DYN && header->e_shentsize == sizeof(ElfW(Shdr)) &&
+               header->e_shoff < size && header->e_shnum <= (size - header->e_shoff) / sizeof(ElfW(Shdr)) &&
+               header->e_shstrndx < header->e_shnum;
+  const ElfW(Shdr) *sections = valid ? (const ElfW(Shdr) *)(file + header->e_shoff) : NULL;
+  const ElfW(Shdr) *names = valid ? &sections[header->e_shstrndx] : NULL;
+  if (valid && names->sh_offset <= size && names->sh_size <= size - names->sh_offset) {
+    for (int i = 0; i < header->e_shnum; i++) {
+      const ElfW(Shdr) *section = &sections[i];
+      if (section->sh_type == SHT_NOBITS || section->sh_name >= names->sh_size ||
+          names->sh_size - section->sh_name < sizeof(CCLI_PLUGIN_SECTION) ||
+          memcmp(file + names->sh_offset + section->sh_name, CCLI_PLUGIN_SECTION, sizeof(CCLI_PLUGIN_SECTION))) {
+        continue;
+      }
+
+      if (section->sh_offset <= size && section->sh_size <= size - section->sh_offset) {
+        manifest = mem_alloc(CCLI_MEMORY_SCHEMA, section->sh_size + 1);
+        memcpy(manifest, file + section->sh_offset, section->sh_size);
+        manifest[section->sh_size] = '\0';
+        *length = section->sh_size;
+      }
+      break;
+    }
+  }
+
+  munmap(map, size);
+  return manifest;
+}
+
+// adds a stub for each 'name\0description\0' entry in the manifest
+static void plugin_add_stubs(ccli *interface, plugin_library *plugin, size_t length) {
+  char *manifest = plugin->manifest;
+
+  for (size_t at = 0; at < length;) {
+    // the compiler can pad entries apart with NULs
+    if (!manifest[at]) {
+      at++;
+      continue;
+    }
+
+    char *name = manifest + at;
+    at += strlen(name) + 1;
+    char *description = (at < length) ? manifest + at : "";
+    at += strlen(description) + 1;
+
+    if (find_command(interface, name)) {
+      ccli_log(interface, WARN, "plugin '%s' can't add '%s', there's already a command by that name", plugin->path, name);
+      continue;
+    }
+
+    ccli_command *command = ccli_add_command(interface, name, NULL);
+    if (*description) command->description = description;
+    command->plugin = plugin;
+  }
+}
+
+static int compare_plugin_names(const void *a, const void *b) {
+  return strcmp(*(char **)a, *(char **)b);
+}
+
+int ccli_add_plugin_dir(ccli *interface, const char *dir) {
+  DIR *directory = opendir(dir);
+  // nothing installed
+  if (!directory) return 0;
+
+  value_vector files;
+  value_vector_init(&files, sizeof(char *));
+  struct dirent *entry;
+  while ((entry = readdir(directory))) {
+    size_t length = strlen(entry->d_name);
+    if (length > 3 && !strcmp(entry->d_name + length - 3, ".so")) path_list_add(&files, entry->d_name);
+  }
+  closedir(directory);
+
+  // in name order, so commands are listed the same way every time
+  char **names = value_vector_items(&files);
+  qsort(names, files.size, sizeof(char *), compare_plugin_names);
+
+  int found = 0;
+  for (int i = 0; i < files.size; i++) {
+    char *path = mem_alloc(CCLI_MEMORY_SCHEMA, strlen(dir) + strlen(names[i]) + 2);
+    sprintf(path, "%s/%s", dir, names[i]);
+
+    size_t length = 0;
+    char *manifest = plugin_read_manifest(path, &length);
+    if (!manifest) {
+      ccli_log(interface, WARN, "skipping '%s', it has no command manifest", path);
+      mem_free(path);
+      continue;
+    }
+
+    plugin_library *plugin = mem_alloc(CCLI_MEMORY_SCHEMA, sizeof(plugin_library));
+    plugin->path = path;
+    plugin->manifest = manifest;
+    plugin->handle = NULL;
+    value_vector_add(&interface->plugins, &plugin);
+    plugin_add_stubs(interface, plugin, length);
+    found++;
+  }
+
+  path_list_free(&files);
+  return found;
+}
+
+// loads the plugin behind [command], if it isn't yet, and has it
+// register its commands, which fills in their stubs
+static void plugin_load(ccli *interface, ccli_command *command) {
+  plugin_library *plugin = command->plugin;
+
+  if (!plugin->handle) {
+    plugin->handle = dlopen(plugin->path, RTLD_NOW | RTLD_LOCAL);
+    if (!plugin->handle) {
+      ccli_runtime_error(interface, "can't load plugin: %s.", dlerror());
+    }
+
+    ccli_plugin_register_fn register_commands = (ccli_plugin_register_fn)dlsym(plugin->handle, CCLI_PLUGIN_REGISTER);
+    if (!register_commands) {
+      ccli_runtime_error(interface, "plugin '%s' has no %s function.", plugin->path, CCLI_PLUGIN_REGISTER);
+    }
+
+    interface->loading_plugin = plugin;
+    register_commands(interface);
+    interface->loading_plugin = NULL;
+  }
+
+  if (!command->callback) {
+    ccli_runtime_error(interface, "plugin '%s' didn't register '%s'.", plugin->path, command->command);
+  }
+}
+
+static void plugins_free(ccli *interface) {
+  plugin_library **plugins = value_vector_items(&interface->plugins);
+  for (int i = 0; i < interface->plugins.size; i++) {
+    if (plugins[i]->handle) dlclose(plugins[i]->handle);
+    mem_free(plugins[i]->path);
+    mem_free(plugins[i]->manifest);
+    mem_free(plugins[i]);
+  }
+  value_vector_free(&interface->plugins);
+}
+
+/******************** ccli multi-call ********************/
+
+void ccli_set_multi_call(ccli *interface, bool enabled) {
+  interface->multi_call = enabled;
+}
+
+// the command named by argv[0], if there is one. either way, the run
+// goes by the name it was invoked under from here on.
+static ccli_command *get_command_by_name(ccli *interface) {
+  if (interface->argc < 1 || !interface->argv[0]) return NULL;
+
+  char *name = strrchr(interface->argv[0], '/');
+  name = name ? name + 1 : interface->argv[0];
+  interface->exeName = name;
+
+  ccli_command *command = find_command(interface, name);
+  interface->called_by_name = (command != NULL);
+  return command;
+}
+
+int ccli_install_links(ccli *interface, const char *dir, const char *target) {
+  char self[PATH_MAX];
+  if (!target) {
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (length < 0) return -1;
+    self[length] = '\0';
+    target = self;
+  }
+
+  int made = 0;
+  for (int i = 0; i < interface->commands.size; i++) {
+    const char *name = interface->commands.commands[i]->command;
+    char *path = mem_alloc(CCLI_MEMORY_OTHER, strlen(dir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", dir, name);
+
+    bool linked = (symlink(target, path) == 0);
+    if (linked) {
+      made++;
+    } else if (errno == EEXIST) {
+      // fine if it's a link from an earlier install
+      char existing[PATH_MAX];
+      ssize_t length = readlink(path, existing, sizeof(existing));
+      linked = (length >= 0 && (size_t)length == strlen(target) && !memcmp(existing, target, length));
+      errno = EEXIST;
+    }
+
+    int saved_errno = errno;
+    mem_free(path);
+    if (!linked) {
+      errno = saved_errno;
+      return -1;
+    }
+  }
+
+  return made;
+}
+
+// '--ccli-install-links=DIR'
+static void install_links(ccli *interface) {
+  int made = ccli_install_links(interface, interface->install_dir, NULL);
+  if (made < 0) {
+    ccli_runtime_error(interface, "can't link commands into '%s': %s.", interface->install_dir, strerror(errno));
+  }
+
+  ccli_echo(interface, "linked %d of %d commands into %s", made, interface->commands.size, interface->install_dir);
+}
+
+/******************** ccli global interface API ********************/
+
+
+ccli_command *ccli_add_command(ccli *interface, char *command, ccli_command_callback callback) {
+  // a plugin being loaded fills in the stubs its manifest made
+  if (interface->loading_plugin) {
+    ccli_command *stub = find_command(interface, command);
+    if (stub && stub->plugin == interface->loading_plugin) {
+      stub->callback = callback;
+      return stub;
+    }
+  }
+
+  ccli_command *_command = ccli_command_new(command, callback);
+  ccli_command_add_option(_command, "--help", NULL, VAL_NULL);
+
+  command_array_add(&interface->commands, _command);
+  return _command;
+}
+
+void ccli_help(ccli *interface, ccli_command *command) {
+  if (!command) {
+    // global help
+    ccli_display(interface);
+    return;
+  }
+
+  ccli_command_display(interface, command);
+}
+
+static ccli_command *find_command(ccli *interface, const char *name) {
+  return command_array_find(&interface->commands, name);
+}
+
+static ccli_command *get_command(ccli *interface) {
+  ccli_command *command = find_command(interface, interface->argv[1]);
+  if (command) interface->current_arg++;
+  return command;
+}
+
+typedef struct {
+  char *name;
+  char *val;
+} parsed_option;
+
+// these helpers are mainly for readability
+#define parsed_option_new(arg, val) ((parsed_option){ arg, val })
+
+static void parsed_option_free(parsed_option *option) {
+  mem_free(option->name);
+}
+
+static char *copy_chars(char *chars, int length) {
+  char *string = mem_alloc(CCLI_MEMORY_PARSE, sizeof(char) * (length + 1));
+  strncpy(string, chars, length);
+  string[length] = '\0';
+  return string;
+}
+
+bool is_digit(char c) {
+  return (c >= '0' && c <= '9');
+}
+
+bool is_number(char *value) {
+  if (is_digit(value[0])) {
+    return true;
+  } else if (value[0] == '.') {
+    return (strlen(value) > 1 && is_digit(value[1]));
+  } else if (value[0] == '-') {
+    return (strlen(value) > 1 && is_digit(value[1])) ||
+           (strlen(value) > 2 && value[1] == '.' && is_digit(value[2]));
+  } else return false;
+}
+
+bool is_bool(char *value) {
+  return (!strcasecmp(value, "t") ||
+          !strcasecmp(value, "f") ||
+          !strcasecmp(value, "true") ||
+          !strcasecmp(value, "false"));
+}
+
+// returns the boolean represented by [value].
+// returns false if the value isn't valid.
+bool strtobool(char *value) {
+  return (!strcasecmp(value, "true") || !strcasecmp(value, "t"));
+}
+
+// parse a whole string as a double, in a single pass, in the "C" locale
+static bool parse_number(const char *value, double *number) {
+  // keep the old rules for how a number may start: no whitespace, '+', inf or nan
+  if (!is_number((char *)value)) return false;
+
+  char *end = NULL;
+  *number = strtod_l(value, &end, c_locale());
+  return end != value && *end == '\0';
+}
+
+typedef struct {
+  const char *suffix;
+  uint64_t scale;
+} unit_suffix;
+
+static const unit_suffix byte_suffixes[] = {
+  { "B", 1 },
+  { "K", 1ull << 10 }, { "k", 1ull << 10 }, { "KiB", 1ull << 10 }, { "KB", 1000ull },
+  { "M", 1ull << 20 }, { "MiB", 1ull << 20 }, { "MB", 1000000ull },
+  { "G", 1ull << 30 }, { "GiB", 1ull << 30 }, { "GB", 1000000000ull },
+  { "T", 1ull << 40 }, { "TiB", 1ull << 40 }, { "TB", 1000000000000ull },
+  { "P", 1ull << 50 }, { "PiB", 1ull << 50 }, { "PB", 1000000000000000ull },
+  { "E", 1ull << 60 }, { "EiB", 1ull << 60 }, { "EB", 1000000000000000000ull },
+  { NULL, 0 }
+};
+
+// durations are stored in nanoseconds
+static const unit_suffix duration_suffixes[] = {
+  { "ns", 1 },
+  { "us", 1000ull },
+  { "ms", 1000000ull },
+  { "s",  1000000000ull },
+  { "m",  60 * 1000000000ull },
+  { "h",  60 * 60 * 1000000000ull },
+  { "d",  24 * 60 * 60 * 1000000000ull },
+  { NULL, 0 }
+};
+
+static int digit_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return 16;
+}
+
+// parse an integer in one pass: an optional sign, an optional 0x/0o/0b
+// prefix, digits, and a unit suffix if [unit] allows one. the magnitude
+// is checked for overflow as it's built up.
+//
+// returns NULL on success, or the reason [chars] was rejected.
+static const char *parse_integer(const char *chars, ccli_unit unit, uint64_t *magnitude, bool *negative) {
+  const char *c = chars;
+
+  *negative = (*c == '-');
+  if (*c == '-' || *c == '+') c++;
+
+  uint64_t base = 10;
+  if (c[0] == '0' && (c[1] == 'x' || c[1] == 'X')) base = 16;
+  else if (c[0] == '0' && (c[1] == 'o' || c[1] == 'O')) base = 8;
+  else if (c[0] == '0' && (c[1] == 'b' || c[1] == 'B')) base = 2;
+  if (base != 10) c += 2;
+
+  const char *digits = c;
+  uint64_t result = 0;
+  for (;; c++) {
+    uint64_t digit = digit_value(*c);
+    if (digit >= base) break;
+    if (__builtin_mul_overflow(result, base, &result) ||
+        __builtin_add_overflow(result, digit, &result)) return "out of range";
+  }
+
+  if (c == digits) return "expected digits";
+
+  if (*c != '\0') {
+    const unit_suffix *suffixes = NULL;
+    if (unit == CCLI_UNIT_BYTES) suffixes = byte_suffixes;
+    else if (unit == CCLI_UNIT_DURATION) suffixes = duration_suffixes;
+    if (!suffixes) return "unexpected characters after the number";
+
+    for (; suffixes->suffix && strcmp(suffixes->suffix, c); suffixes++);
+    if (!suffixes->suffix) return "unknown unit suffix";
+    if (__builtin_mul_overflow(result, suffixes->scale, &result)) return "out of range";
+
+  } else if (unit == CCLI_UNIT_DURATION && result != 0) {
+    return "a duration needs a unit (ns, us, ms, s, m, h, d)";
+  }
+
+  *magnitude = result;
+  return NULL;
+}
+
+static const char *parse_int64(const char *chars, ccli_unit unit, int64_t *value) {
+  uint64_t magnitude;
+  bool negative;
+  const char *reason = parse_integer(chars, unit, &magnitude, &negative);
+  if (reason) return reason;
+
+  if (negative) {
+    if (magnitude > (uint64_t)INT64_MAX + 1) return "out of range";
+    *value = (magnitude == (uint64_t)INT64_MAX + 1) ? INT64_MIN : -(int64_t)magnitude;
+  } else {
+    if (magnitude > (uint64_t)INT64_MAX) return "out of range";
+    *value = (int64_t)magnitude;
+  }
+
+  return NULL;
+}
+
+static const char *parse_uint64(const char *chars, ccli_unit unit, uint64_t *value) {
+  uint64_t magnitude;
+  bool negative;
+  const char *reason = parse_integer(chars, unit, &magnitude, &negative);
+  if (reason) return reason;
+  if (negative && magnitude != 0) return "must not be negative";
+
+  *value = magnitude;
+  return NULL;
+}
+
+static void check_option_pattern(ccli *interface, ccli_command *command, ccli_option *option, char *name, char *value) {
+  if (!option->pattern || value_pattern_match(option->pattern, value)) return;
+
+  ccli_detailed_command_display(interface, command);
+  ccli_runtime_error(interface, "invalid value for '%s': '%s' (doesn't match '%s').", name, value, option->pattern->source);
+}
+
+void set_option_value(ccli *interface, ccli_command *command, ccli_option *option, char *name, char *value) {
+  if (!value) {
+    if (option->type == VAL_NULL) {
+      option->value = BOOL_VAL(true);
+      return;
+    } else if (option->type == VAL_COUNTER) {
+      option->value = NUM_VAL(AS_DOUBLE(option->value) + 1);
+      return;
+    } else {
+      ccli_detailed_command_display(interface, command);
+      ccli_runtime_error(interface, "missing option parameter: '%s'.", name);
+    }
+  }
+
+  switch (option->type) {
+    case VAL_NULL:
+    case VAL_COUNTER: {
+      ccli_detailed_command_display(interface, command);
+      ccli_runtime_error(interface, "option doesn't take parameter: '%s=%s'.", name, value);
+    }
+    case VAL_BOOL: {
+      if (is_bool(value)) {
+        option->value = BOOL_VAL(strtobool(value));
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid boolean: '%s'.", value);
+      }
+      break;
+    }
+    case VAL_NUM: {
+      double number;
+      if (parse_number(value, &number)) {
+        option->value = NUM_VAL(number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid number: '%s'.", value);
+      }
+      break;
+    }
+    case VAL_INT64: {
+      int64_t number;
+      const char *reason = parse_int64(value, option->unit, &number);
+      if (!reason) {
+        option->value = INT64_VAL(number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid integer: '%s' (%s).", value, reason);
+      }
+      break;
+    }
+    case VAL_UINT64: {
+      uint64_t number;
+      const char *reason = parse_uint64(value, option->unit, &number);
+      if (!reason) {
+        option->value = UINT64_VAL(number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid integer: '%s' (%s).", value, reason);
+      }
+      break;
+    }
+    case VAL_STRING: {
+      check_option_pattern(interface, command, option, name, value);
+      option->value = STRING_VAL(value);
+      break;
+    }
+    case VAL_CHOICE: {
+      int choice = choice_table_find(&option->choices, value);
+      if (choice >= 0) {
+        option->value = CHOICE_VAL(choice);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid choice for '%s': '%s'.", name, value);
+      }
+      break;
+    }
+    case VAL_FILE: {
+      ccli_file *file = file_open(value);
+      if (file) {
+        if (IS_FILE(option->value)) file_free(AS_FILE(option->value));
+        option->value = FILE_VAL(file);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "can't open '%s': %s.", value, strerror(errno));
+      }
+      break;
+    }
+    case VAL_TYPED: {
+      typed_slot *slot = option->slot;
+      memset(slot->data, 0, slot->type->size);
+      const char *reason = slot->type->parse(value, slot->data);
+      if (!reason) {
+        option->value = TYPED_VAL(slot);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid %s: '%s' (%s).", slot->type->name, value, reason);
+      }
+      break;
+    }
+    case VAL_RANGE_LIST: {
+      const char *reason = NULL;
+      ccli_range_list *ranges = range_list_parse(value, &reason);
+      if (ranges) {
+        // the last occurrence wins, like any other single-valued option
+        if (IS_RANGE(option->value)) range_list_free(AS_RANGE(option->value));
+        option->value = RANGE_VAL(ranges);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid range list: '%s' (%s).", value, reason);
+      }
+      break;
+    }
+    case VAL_STRING_LIST: {
+      check_option_pattern(interface, command, option, name, value);
+      value_vector_add(&option->values, &value);
+      break;
+    }
+    case VAL_NUM_LIST: {
+      double number;
+      if (parse_number(value, &number)) {
+        value_vector_add(&option->values, &number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid number: '%s'.", value);
+      }
+      break;
+    }
+    default:
+      ccli_runtime_error(interface, "unrecognized value type: %d\n", option->type);
+      // TODO: handle this more gracefully?
+  }
+}
+
+parsed_option parse_option(char *arg) {
+  if (arg[0] != '-') return parsed_option_new(NULL, NULL);
+
+  int name_len = 0;
+
+  // TODO: handle short options
+  name_len++; name_len++;
+
+  while (arg[name_len] != '\0' && arg[name_len] != '=') {
+    name_len++;
+  }
+
+  if (arg[name_len] == '=') {
+    return parsed_option_new(copy_chars(arg, name_len), &arg[name_len + 1]);
+  } else {
+    return parsed_option_new(copy_chars(arg, name_len), NULL);
+  }
+}
+
+#undef parsed_option_new
+
+// expand bundled short flags, like '-vvv' or '-xv'. only applies if every
+// letter names a flag or counter, otherwise the token is left alone.
+static bool parse_short_flags(ccli *interface, ccli_command *command, parsed_option *p_option) {
+  char *name = p_option->name;
+  if (name[1] == '-' || p_option->val) return false;
+
+  char flag[3] = { '-', '\0', '\0' };
+  for (int i = 1; name[i] != '\0'; i++) {
+    flag[1] = name[i];
+    ccli_option *option = ccli_table_find_option(&command->options, flag);
+    if (!option || (option->type != VAL_NULL && option->type != VAL_COUNTER)) return false;
+  }
+
+  for (int i = 1; name[i] != '\0'; i++) {
+    flag[1] = name[i];
+    ccli_option *option = ccli_table_find_option(&command->options, flag);
+    set_option_value(interface, command, option, flag, NULL);
+    bitset_set(&command->present, option->index);
+  }
+
+  return true;
+}
+
+// negative numbers ('-5', '-.5') are arguments, not options
+static bool is_option_token(char *arg) {
+  return arg[0] == '-' && arg[1] != '\0' && !is_digit(arg[1]) &&
+         !(arg[1] == '.' && is_digit(arg[2]));
+}
+
+void parse_options(ccli *interface, ccli_command *command) {
+  parsed_option p_option;
+  for (; interface->current_arg < interface->argc &&
+         is_option_token(interface->argv[interface->current_arg]);
+         interface->current_arg++) {
+    // '--' ends the options, everything after it is an argument
+    if (!strcmp(interface->argv[interface->current_arg], "--")) {
+      interface->current_arg++;
+      return;
+    }
+
+    p_option = parse_option(interface->argv[interface->current_arg]);
+
+    if (!p_option.name) return;
+    interface->parsing_name = p_option.name;
+
+    ccli_option *option = NULL;
+    // TODO: finish parsing options
+    table_string *string = ccli_table_find_string(&command->options, p_option.name);
+    if (string && ccli_table_get(&command->options, string, &option)) {
+      // option was used
+      set_option_value(interface, command, option, p_option.name, p_option.val);
+      bitset_set(&command->present, option->index);
+    } else {
+      parse_short_flags(interface, command, &p_option);
+    }
+
+    parsed_option_free(&p_option);
+    interface->parsing_name = NULL;
+  }
+}
+
+static ccli_option *first_missing_option(ccli_bitset *present, ccli_bitset *mask, option_array *options) {
+  for (int i = 0; i < options->size; i++) {
+    if (bitset_test(mask, i) && !bitset_test(present, i)) return options->options[i];
+  }
+
+  return NULL;
+}
+
+// check the parsed options against the command's compiled constraints
+static void validate_options(ccli *interface, ccli_command *command) {
+  ccli_bitset *present = &command->present;
+  option_array *options = &command->option_list;
+
+  if (!bitset_covers(present, &command->required)) {
+    ccli_option *missing = first_missing_option(present, &command->required, options);
+    ccli_detailed_command_display(interface, command);
+    ccli_runtime_error(interface, "missing required option: '%s'.", missing->long_option);
+  }
+
+  for (int i = 0; i < command->constraints.size; i++) {
+    option_constraint *constraint = &command->constraints.constraints[i];
+
+    switch (constraint->type) {
+      case CONSTRAINT_EXCLUSIVE: {
+        if (bitset_count_common(present, &constraint->mask) <= 1) break;
+
+        // report the first two offenders
+        ccli_option *first = NULL;
+        for (int j = 0; j < options->size; j++) {
+          if (!bitset_test(&constraint->mask, j) || !bitset_test(present, j)) continue;
+          if (!first) {
+            first = options->options[j];
+            continue;
+          }
+
+          ccli_detailed_command_display(interface, command);
+          ccli_runtime_error(interface, "options '%s' and '%s' can't be used together.",
+                             first->long_option, options->options[j]->long_option);
+        }
+        break;
+      }
+      case CONSTRAINT_REQUIRES: {
+        if (!bitset_test(present, constraint->option) || bitset_covers(present, &constraint->mask)) break;
+
+        ccli_option *missing = first_missing_option(present, &constraint->mask, options);
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "option '%s' requires '%s'.",
+                           options->options[constraint->option]->long_option, missing->long_option);
+      }
+    }
+  }
+}
+
+static void parse_arg(ccli *interface, ccli_command *command, ccli_arg *arg, char *value) {
+  switch (arg->type) {
+    case VAL_NUM: {
+      double number;
+      if (parse_number(value, &number)) {
+        arg->value = NUM_VAL(number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid number: '%s'.", value);
+      }
+      break;
+    }
+    case VAL_INT64: {
+      int64_t number;
+      const char *reason = parse_int64(value, arg->unit, &number);
+      if (!reason) {
+        arg->value = INT64_VAL(number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid integer: '%s' (%s).", value, reason);
+      }
+      break;
+    }
+    case VAL_UINT64: {
+      uint64_t number;
+      const char *reason = parse_uint64(value, arg->unit, &number);
+      if (!reason) {
+        arg->value = UINT64_VAL(number);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid integer: '%s' (%s).", value, reason);
+      }
+      break;
+    }
+
+    case VAL_BOOL: {
+      if (is_bool(value)) {
+        arg->value = BOOL_VAL(strtobool(value));
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid boolean: '%s'.", value);
+      }
+      break;
+    }
+    case VAL_STRING: {
+      arg->value = STRING_VAL(value);
+      break;
+    }
+    case VAL_FILE: {
+      ccli_file *file = file_open(value);
+      if (file) {
+        arg->value = FILE_VAL(file);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "can't open '%s': %s.", value, strerror(errno));
+      }
+      break;
+    }
+    case VAL_TYPED: {
+      typed_slot *slot = arg->slot;
+      memset(slot->data, 0, slot->type->size);
+      const char *reason = slot->type->parse(value, slot->data);
+      if (!reason) {
+        arg->value = TYPED_VAL(slot);
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid %s: '%s' (%s).", slot->type->name, value, reason);
+      }
+      break;
+    }
+    case VAL_RANGE_LIST: {
+      const char *reason = NULL;
+      ccli_range_list *ranges = range_list_parse(value, &reason);
+      if (ranges) {
+        arg->value = RANGE_VAL(ranges);
+
+      } else {
+        ccli_detailed_command_display(interface, command);
+        ccli_runtime_error(interface, "invalid range list: '%s' (%s).", value, reason);
+      }
+      break;
+    }
+    default: {
+
+      // Should be unreachable
+      ccli_detailed_command_display(interface, command);
+      ccli_runtime_error(interface, "invalid value type: %d.", arg->type);
+      break;
+    }
+  }
+}
+
+static void parse_args(ccli *interface, ccli_command *command) {
+  // short-circuit for commands with no arguments
+  if (command->args.size == 0) return;
+
+  int num_ccli_args = 0;
+  for (; interface->current_arg < interface->argc && num_ccli_args < command->args.size;
+         interface->current_arg++, num_ccli_args++) {
+    ccli_arg *arg = command->args.args[num_ccli_args];
+    char *value = interface->argv[interface->current_arg];
+    parse_arg(interface, command, arg, value);
+  }
+
+  if (num_ccli_args < command->args.size) {
+    // arguments are required
+    ccli_detailed_command_display(interface, command);
+    ccli_runtime_error(interface, "command requires %d arguments, but %d were specified.",
+               command->args.size, num_ccli_args);
+  }
+}
+
+static void parse_command(ccli *interface) {
+
+}
+
+// '--ccli-bench=N[,warmup=M]'
+static void parse_bench_flag(ccli *interface, char *value) {
+  char runs[32];
+  char *warmup = value ? strchr(value, ',') : NULL;
+  size_t length = warmup ? (size_t)(warmup - value) : (value ? strlen(value) : 0);
+  if (length == 0 || length >= sizeof(runs)) {
+    ccli_runtime_error(interface, "'--ccli-bench' needs a run count: '--ccli-bench=1000[,warmup=100]'.");
+  }
+
+  memcpy(runs, value, length);
+  runs[length] = '\0';
+  const char *reason = parse_uint64(runs, CCLI_UNIT_NONE, &interface->bench_runs);
+  if (reason || interface->bench_runs == 0) {
+    ccli_runtime_error(interface, "invalid run count for '--ccli-bench': '%s'.", runs);
+  }
+
+  interface->bench_warmup = 0;
+  if (warmup && (strncmp(warmup, ",warmup=", strlen(",warmup=")) ||
+                 parse_uint64(warmup + strlen(",warmup="), CCLI_UNIT_NONE, &interface->bench_warmup))) {
+    ccli_runtime_error(interface, "invalid warmup for '--ccli-bench': '%s'.", warmup + 1);
+  }
+}
+
+// '--ccli-watch[=DEBOUNCE_MS]'
+static void parse_watch_flag(ccli *interface, char *value) {
+  interface->watch = true;
+  interface->watch_debounce_ms = WATCH_DEFAULT_DEBOUNCE_MS;
+  if (value && parse_uint64(value, CCLI_UNIT_NONE, &interface->watch_debounce_ms)) {
+    ccli_runtime_error(interface, "invalid debounce for '--ccli-watch': '%s' (milliseconds).", value);
+  }
+}
+
+// '--ccli-output=FORMAT'
+static void parse_output_flag(ccli *interface, char *value) {
+  for (int i = 0; value && i < 4; i++) {
+    if (!strcmp(value, output_formats[i])) {
+      interface->output_format = i;
+      return;
+    }
+  }
+  ccli_runtime_error(interface, "invalid format for '--ccli-output': '%s' (text, json, ndjson or csv).", value ? value : "");
+}
+
+static void parse_framework_flag(ccli *interface, char *flag) {
+  char *value = strchr(flag, '=');
+  size_t length = value ? (size_t)(value - flag) : strlen(flag);
+  if (value) value++;
+
+  if (length == strlen("--ccli-trace") && !strncmp(flag, "--ccli-trace", length)) {
+    if (!value || !*value) ccli_runtime_error(interface, "'--ccli-trace' needs a file: '--ccli-trace=out.json'.");
+    ccli_trace_start(interface, value);
+  } else if (length == strlen("--ccli-bench") && !strncmp(flag, "--ccli-bench", length)) {
+    parse_bench_flag(interface, value);
+  } else if (length == strlen("--ccli-watch") && !strncmp(flag, "--ccli-watch", length)) {
+    parse_watch_flag(interface, value);
+  } else if (length == strlen("--ccli-output") && !strncmp(flag, "--ccli-output", length)) {
+    parse_output_flag(interface, value);
+  } else if (length == strlen("--ccli-install-links") && !strncmp(flag, "--ccli-install-links", length)) {
+    if (!value || !*value) ccli_runtime_error(interface, "'--ccli-install-links' needs a directory: '--ccli-install-links=/usr/local/bin'.");
+    interface->install_dir = value;
+  } else {
+    ccli_runtime_error(interface, "unrecognized option: '%.*s'.", (int)length, flag);
+  }
+}
+
+// flags for ccli itself, like --ccli-trace=out.json, can go anywhere
+// before a '--'. they're taken out of argv before the command sees it.
+static void parse_framework_flags(ccli *interface) {
+  int kept = 1;
+  bool passthrough = false;
+  for (int i = 1; i < interface->argc; i++) {
+    char *arg = interface->argv[i];
+    if (!strcmp(arg, "--")) passthrough = true;
+
+    if (!passthrough && !strncmp(arg, "--ccli-", strlen("--ccli-"))) parse_framework_flag(interface, arg);
+    else interface->argv[kept++] = arg;
+  }
+
+  if (kept < interface->argc) interface->argv[kept] = NULL;
+  interface->argc = kept;
+}
+
+void ccli_run(ccli *interface) {
+  parse_framework_flags(interface);
+
+  if (interface->install_dir) {
+    install_links(interface);
+    return;
+  }
+
+  // a multi-call binary run under a command's name runs that command
+  ccli_command *command = interface->multi_call ? get_command_by_name(interface) : NULL;
+
+  if (!command && (interface->argc <= 1 || !strcmp(interface->argv[interface->current_arg], "--help"))) {
+    ccli_help(interface, NULL);
+    return;
+  }
+
+  ccli_trace_begin(interface, "dispatch");
+  if (!command) command = get_command(interface);
+  if (command && command->plugin) plugin_load(interface, command);
+  ccli_trace_end(interface);
+  if (!command) {
+    ccli_echo_color(interface, COLOR_RED, "Error: Unrecognized command -> '%s'\n", interface->argv[1]);
+    ccli_display_commands(interface);
+    ccli_print(interface, "\n");
+    return;
+  }
+
+  interface->invoked_command = command;
+  register_log_options(interface, command);
+  ccli_trace_begin(interface, "parse_options");
+  parse_options(interface, command);
+  set_log_level(interface, command);
+  ccli_trace_end(interface);
+
+  if (ccli_option_exists(interface, "--help")) {
+    ccli_detailed_command_display(interface, command);
+    return;
+  }
+
+  ccli_trace_begin(interface, "validate_options");
+  validate_options(interface, command);
+  ccli_trace_end(interface);
+  ccli_trace_begin(interface, "parse_args");
+  parse_args(interface, command);
+  ccli_trace_end(interface);
+
+  if (interface->bench_runs) {
+    run_bench(interface);
+    return;
+  }
+  if (interface->watch) {
+    run_watch(interface);
+    return;
+  }
+
+  ccli_trace_begin(interface, "callback");
+  if (!cache_replay(interface)) {
+    cache_begin(interface);
+    interface->invoked_command->callback(interface);
+    finish_records(interface);
+    cache_finish(interface, 0);
+  }
+  ccli_trace_end(interface);
+}
+
+// forget everything the last run parsed, so the next one starts clean
+static void reset_parse_state(ccli *interface) {
+  for (int i = 0; i < interface->commands.size; i++) {
+    ccli_command *command = interface->commands.commands[i];
+    bitset_clear(&command->present);
+    for (int j = 0; j < command->option_list.size; j++) {
+      ccli_option_reset(command->option_list.options[j]);
+    }
+
+    for (int j = 0; j < command->args.size; j++) {
+      ccli_arg *arg = command->args.args[j];
+      if (IS_RANGE(arg->value)) range_list_free(AS_RANGE(arg->value));
+      if (IS_FILE(arg->value)) file_free(AS_FILE(arg->value));
+      arg->value = NULL_VAL;
+    }
+  }
+
+  interface->current_arg = 1;
+  interface->invoked_command = NULL;
+  interface->output_format = CCLI_OUTPUT_TEXT;
+  interface->records_started = false;
+  interface->bench_runs = 0;
+  interface->bench_warmup = 0;
+  interface->watch = false;
+  path_list_clear(&interface->changed_paths);
+  interface->called_by_name = false;
+  interface->install_dir = NULL;
+  interface->record.size = 0;
+  interface->record.first_record = SIZE_MAX;
+  interface->record.first_record_body = SIZE_MAX;
+}
+
+// a command's parsed values, set aside while a nested run reuses the
+// command tables. they're moved out rather than copied, so the nested
+// run's reset can't free a file or range list the callback still holds.
+typedef struct {
+  ccli_value value;
+  value_vector values;
+  typed_slot *slot;
+} saved_value;
+
+// the state of a run whose callback is still going
+typedef struct {
+  ccli_command *command;
+  ccli_bitset present;
+  saved_value *options;
+  saved_value *args;
+  int current_arg;
+  ccli_output_format output_format;
+  bool records_started;
+  ccli_buffer record;
+  int log_level;
+  uint64_t bench_runs;
+  uint64_t bench_warmup;
+  bool watch;
+  value_vector changed_paths;
+  bool called_by_name;
+  char *install_dir;
+  ccli_buffer cache_key;
+  ccli_buffer *tee;
+  ccli_buffer cache_output;
+  pthread_t cache_thread;
+} parse_snapshot;
+
+static void save_value(saved_value *saved, ccli_value *value, ccli_value reset, value_vector *values, typed_slot **slot) {
+  saved->value = *value;
+  *value = reset;
+  if (values) {
+    saved->values = *values;
+    value_vector_init(values, values->item_size);
+  }
+  // the nested run parses into a slot of its own
+  saved->slot = *slot;
+  if (*slot) *slot = typed_slot_new((*slot)->type);
+}
+
+static void restore_value(saved_value *saved, ccli_value *value, value_vector *values, typed_slot **slot) {
+  *value = saved->value;
+  if (values) {
+    value_vector_free(values);
+    *values = saved->values;
+  }
+  mem_free(*slot);
+  *slot = saved->slot;
+}
+
+static void snapshot_save(ccli *interface, parse_snapshot *snapshot) {
+  ccli_command *command = interface->invoked_command;
+  snapshot->command = command;
+  snapshot->present = command->present;
+  bitset_init(&command->present);
+
+  snapshot->options = mem_alloc(CCLI_MEMORY_PARSE, sizeof(saved_value) * (command->option_list.size + 1));
+  for (int i = 0; i < command->option_list.size; i++) {
+    ccli_option *option = command->option_list.options[i];
+    save_value(&snapshot->options[i], &option->value, option->default_value, &option->values, &option->slot);
+  }
+  snapshot->args = mem_alloc(CCLI_MEMORY_PARSE, sizeof(saved_value) * (command->args.size + 1));
+  for (int i = 0; i < command->args.size; i++) {
+    ccli_arg *arg = command->args.args[i];
+    save_value(&snapshot->args[i], &arg->value, NULL_VAL, NULL, &arg->slot);
+  }
+
+  snapshot->current_arg = interface->current_arg;
+  snapshot->output_format = interface->output_format;
+  snapshot->records_started = interface->records_started;
+  snapshot->record = interface->record;
+  buffer_init(&interface->record);
+  snapshot->log_level = interface->log_level;
+  snapshot->bench_runs = interface->bench_runs;
+  snapshot->bench_warmup = interface->bench_warmup;
+  snapshot->watch = interface->watch;
+  snapshot->changed_paths = interface->changed_paths;
+  value_vector_init(&interface->changed_paths, sizeof(char *));
+  snapshot->called_by_name = interface->called_by_name;
+  snapshot->install_dir = interface->install_dir;
+  snapshot->cache_key = interface->cache_key;
+  buffer_init(&interface->cache_key);
+  snapshot->tee = interface->tee;
+  interface->tee = NULL;
+  snapshot->cache_output = interface->cache_output;
+  buffer_init(&interface->cache_output);
+  snapshot->cache_thread = interface->cache_thread;
+}
+
+// release what the nested run left behind, and put the outer run back
+static void snapshot_restore(ccli *interface, parse_snapshot *snapshot) {
+  reset_parse_state(interface);
+
+  ccli_command *command = snapshot->command;
+  bitset_free(&command->present);
+  command->present = snapshot->present;
+  for (int i = 0; i < command->option_list.size; i++) {
+    ccli_option *option = command->option_list.options[i];
+    restore_value(&snapshot->options[i], &option->value, &option->values, &option->slot);
+  }
+  for (int i = 0; i < command->args.size; i++) {
+    ccli_arg *arg = command->args.args[i];
+    restore_value(&snapshot->args[i], &arg->value, NULL, &arg->slot);
+  }
+  mem_free(snapshot->options);
+  mem_free(snapshot->args);
+
+  interface->invoked_command = command;
+  interface->current_arg = snapshot->current_arg;
+  interface->output_format = snapshot->output_format;
+  interface->records_started = snapshot->records_started;
+  buffer_free(&interface->record);
+  interface->record = snapshot->record;
+  interface->log_level = snapshot->log_level;
+  interface->bench_runs = snapshot->bench_runs;
+  interface->bench_warmup = snapshot->bench_warmup;
+  interface->watch = snapshot->watch;
+  path_list_free(&interface->changed_paths);
+  interface->changed_paths = snapshot->changed_paths;
+  interface->called_by_name = snapshot->called_by_name;
+  interface->install_dir = snapshot->install_dir;
+  buffer_free(&interface->cache_key);
+  interface->cache_key = snapshot->cache_key;
+  interface->tee = snapshot->tee;
+  buffer_free(&interface->cache_output);
+  interface->cache_output = snapshot->cache_output;
+  interface->cache_thread = snapshot->cache_thread;
+}
+
+// run [argv] from a clean parse state, with an error exit returning its
+// status instead. runs can nest, e.g. a repl started from a callback:
+// the outer run's state is set aside, and put back afterwards.
+static int run_in_process(ccli *interface, int argc, char **argv, bool capture) {
+  int saved_argc = interface->argc;
+  char **saved_argv = interface->argv;
+  bool saved_capturing = interface->capturing;
+  jmp_buf *saved_exit = interface->invoke_exit;
+  pthread_t saved_thread = interface->invoke_thread;
+  int saved_status = interface->invoke_status;
+  // a multi-call run names itself after argv[0], which belongs to the caller
+  char *saved_name = interface->exeName;
+  jmp_buf exit_point;
+
+  // a command is only still invoked while its callback runs, since a
+  // run that isn't nested clears it on the way out
+  parse_snapshot snapshot;
+  bool nested = interface->invoked_command != NULL;
+  if (nested) snapshot_save(interface, &snapshot);
+
+  reset_parse_state(interface);
+  interface->argc = argc;
+  interface->argv = argv;
+  interface->capturing = capture;
+  interface->invoke_exit = &exit_point;
+  interface->invoke_thread = pthread_self();
+  interface->invoke_status = 0;
+
+  if (!setjmp(exit_point)) {
+    ccli_run(interface);
+  } else {
+    mem_free(interface->parsing_name);
+    interface->parsing_name = NULL;
+  }
+
+  int status = interface->invoke_status;
+  interface->capturing = saved_capturing;
+  interface->invoke_exit = saved_exit;
+  interface->invoke_thread = saved_thread;
+  interface->invoke_status = saved_status;
+  interface->argc = saved_argc;
+  interface->argv = saved_argv;
+  interface->exeName = saved_name;
+  if (nested) snapshot_restore(interface, &snapshot);
+  else interface->invoked_command = NULL;
+  return status;
+}
+
+int ccli_invoke(ccli *interface, int argc, char **argv, ccli_result *result) {
+  // a nested invoke captures separately from the run around it
+  ccli_buffer outer = interface->capture;
+  buffer_init(&interface->capture);
+  result->status = run_in_process(interface, argc, argv, true);
+
+  // hand the captured output over, NUL-terminated
+  buffer_append(&interface->capture, "", 1);
+  result->output = interface->capture.chars;
+  result->length = interface->capture.size - 1;
+  interface->capture = outer;
+  return result->status;
+}
+
+void ccli_result_free(ccli_result *result) {
+  mem_free(result->output);
+  result->output = NULL;
+  result->length = 0;
+}
+
+/******************** ccli repl ********************/
+
+#define REPL_HISTORY_MAX 1000
+#define REPL_MAX_ARGS 256
+
+// keys past the range of a byte
+enum {
+  KEY_NONE = 1000,
+  KEY_UP,
+  KEY_DOWN,
+  KEY_LEFT,
+  KEY_RIGHT,
+  KEY_HOME,
+  KEY_END,
+  KEY_DELETE,
+};
+
+#define CTRL_KEY(c) ((c) & 0x1f)
+
+typedef struct {
+  int size;
+  int capacity;
+  char **lines;
+} repl_history;
+
+static void history_init(repl_history *history) {
+  history->size = 0;
+  history->capacity = 0;
+  history->lines = NULL;
+}
+
+static void history_free(repl_history *history) {
+  for (int i = 0; i < history->size; i++) mem_free(history->lines[i]);
+  mem_free(history->lines);
+  history_init(history);
+}
+
+// a line repeated right away is only kept once
+static void history_add(repl_history *history, const char *line) {
+  if (history->size > 0 && !strcmp(history->lines[history->size - 1], line)) return;
+
+  if (history->size == REPL_HISTORY_MAX) {
+    mem_free(history->lines[0]);
+    memmove(history->lines, history->lines + 1, sizeof(char *) * --history->size);
+  }
+
+  if (history->size + 1 > history->capacity) {
+    history->capacity = GROW_ARRAY_CAPACITY(history->capacity);
+    history->lines = mem_realloc(CCLI_MEMORY_OTHER, history->lines, sizeof(char *) * history->capacity);
+  }
+
+  history->lines[history->size++] = mem_strdup(CCLI_MEMORY_OTHER, line);
+}
+
+static void history_load(repl_history *history, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return;
+
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &capacity, fp)) > 0) {
+    if (line[length - 1] == '\n') line[--length] = '\0';
+    if (length > 0) history_add(history, line);
+  }
+
+  // getline's buffer comes from the C library, not the allocator
+  free(line);
+  fclose(fp);
+}
+
+// the history can hold anything typed at the prompt, so it's created
+// readable by its owner alone
+static FILE *history_open(const char *path, int flags, const char *mode) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0600);
+  if (fd < 0) return NULL;
+
+  FILE *fp = fdopen(fd, mode);
+  if (!fp) close(fd);
+  return fp;
+}
+
+// lines are appended as they're entered, so a crash keeps them. the file
+// is cut back down to what's in memory when the repl ends.
+static void history_append(const char *path, const char *line) {
+  FILE *fp = history_open(path, O_APPEND, "a");
+  if (!fp) return;
+  fprintf(fp, "%s\n", line);
+  fclose(fp);
+}
+
+static void history_save(repl_history *history, const char *path) {
+  FILE *fp = history_open(path, O_TRUNC, "w");
+  if (!fp) return;
+  for (int i = 0; i < history->size; i++) fprintf(fp, "%s\n", history->lines[i]);
+  fclose(fp);
+}
+
+typedef struct {
+  ccli *interface;
+  char *prompt;
+  // the line being edited, always NUL-terminated
+  ccli_buffer line;
+  size_t cursor;
+  repl_history history;
+  // the history entry on screen, [history.size] for the line being edited
+  int history_index;
+  // the line being edited, kept while browsing history
+  char *draft;
+  struct termios cooked;
+} repl;
+
+static void repl_write(const char *chars, size_t length) {
+  size_t written = 0;
+  while (written < length) {
+    ssize_t result = write(STDOUT_FILENO, chars + written, length - written);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) break;
+    written += result;
+  }
+}
+
+static void repl_raw_mode(repl *repl) {
+  struct termios raw = repl->cooked;
+  // keystrokes come through one at a time, unechoed, with ^C and ^D as
+  // plain keys. output processing is left alone.
+  raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+  raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+  raw.c_cc[VMIN] = 1;
+  raw.c_cc[VTIME] = 0;
+  tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+}
+
+static void repl_cooked_mode(repl *repl) {
+  tcsetattr(STDIN_FILENO, TCSADRAIN, &repl->cooked);
+}
+
+static int repl_read_byte(void) {
+  unsigned char c;
+  for (;;) {
+    ssize_t result = read(STDIN_FILENO, &c, 1);
+    if (result == 1) return c;
+    if (result < 0 && errno == EINTR) continue;
+    return -1;
+  }
+}
+
+// a key, with escape sequences for the arrows and such decoded. -1 at
+// the end of input.
+static int repl_read_key(void) {
+  int c = repl_read_byte();
+  if (c != '\033') return c;
+
+  int kind = repl_read_byte();
+  int code = repl_read_byte();
+  if (kind == '[' && code >= '0' && code <= '9') {
+    if (repl_read_byte() != '~') return KEY_NONE;
+    switch (code) {
+      case '1': case '7': return KEY_HOME;
+      case '4': case '8': return KEY_END;
+      case '3':           return KEY_DELETE;
+      default:            return KEY_NONE;
+    }
+  }
+
+  if (kind != '[' && kind != 'O') return KEY_NONE;
+  switch (code) {
+    case 'A': return KEY_UP;
+    case 'B': return KEY_DOWN;
+    case 'C': return KEY_RIGHT;
+    case 'D': return KEY_LEFT;
+    case 'H': return KEY_HOME;
+    case 'F': return KEY_END;
+    default:  return KEY_NONE;
+  }
+}
+
+// redraw the prompt and line, and put the cursor back
+static void repl_refresh(repl *repl) {
+  ccli_buffer screen;
+  buffer_init(&screen);
+  buffer_printf(&screen, "\r%s%s\033[K\r", repl->prompt, repl->line.chars);
+  size_t column = strlen(repl->prompt) + repl->cursor;
+  if (column > 0) buffer_printf(&screen, "\033[%zuC", column);
+  repl_write(screen.chars, screen.size);
+  buffer_free(&screen);
+}
+
+static void repl_insert(repl *repl, const char *chars, size_t length) {
+  buffer_reserve(&repl->line, length + 1);
+  char *at = repl->line.chars + repl->cursor;
+  memmove(at + length, at, repl->line.size - repl->cursor + 1);
+  memcpy(at, chars, length);
+  repl->line.size += length;
+  repl->cursor += length;
+}
+
+// remove [from, to) and leave the cursor where it was
+static void repl_erase(repl *repl, size_t from, size_t to) {
+  char *chars = repl->line.chars;
+  memmove(chars + from, chars + to, repl->line.size - to + 1);
+  repl->line.size -= to - from;
+  repl->cursor = from;
+}
+
+static void repl_set_line(repl *repl, const char *chars) {
+  repl->line.size = 0;
+  repl->cursor = 0;
+  buffer_reserve(&repl->line, 1);
+  repl->line.chars[0] = '\0';
+  repl_insert(repl, chars, strlen(chars));
+}
+
+static void repl_browse(repl *repl, int direction) {
+  int index = repl->history_index + direction;
+  if (index < 0 || index > repl->history.size) return;
+
+  if (repl->history_index == repl->history.size) {
+    mem_free(repl->draft);
+    repl->draft = mem_strdup(CCLI_MEMORY_OTHER, repl->line.chars);
+  }
+  repl->history_index = index;
+  repl_set_line(repl, (index == repl->history.size) ? repl->draft : repl->history.lines[index]);
+}
+
+typedef struct {
+  const char *text;
+  // what goes after a completed word: ' ', or '=' for an option's value
+  char suffix;
+} repl_candidate;
+
+typedef struct {
+  int size;
+  int capacity;
+  repl_candidate *candidates;
+} candidate_array;
+
+// keep [text] if it completes [word]
+static void candidate_add(candidate_array *array, const char *word, size_t length, const char *text, char suffix) {
+  if (!text || strncmp(text, word, length)) return;
+
+  if (array->size + 1 > array->capacity) {
+    array->capacity = GROW_ARRAY_CAPACITY(array->capacity);
+    array->candidates = mem_realloc(CCLI_MEMORY_OTHER, array->candidates, sizeof(repl_candidate) * array->capacity);
+  }
+  array->candidates[array->size++] = (repl_candidate){ text, suffix };
+}
+
+// what the word at [start] in [line] could complete to: a command name,
+// one of the command's options, or a choice after a choice option's '='
+static const char *repl_candidates(repl *repl, size_t start, candidate_array *array) {
+  ccli *interface = repl->interface;
+  char *line = repl->line.chars;
+  const char *word = line + start;
+  size_t length = repl->cursor - start;
+
+  size_t first = strspn(line, " ");
+  if (start <= first) {
+    candidate_add(array, word, length, "help", ' ');
+    candidate_add(array, word, length, "exit", ' ');
+    for (int i = 0; i < interface->commands.size; i++) {
+      candidate_add(array, word, length, interface->commands.commands[i]->command, ' ');
+    }
+    return word;
+  }
+
+  char name[256];
+  size_t name_length = strcspn(line + first, " ");
+  if (name_length >= sizeof(name) || word[0] != '-') return word;
+  memcpy(name, line + first, name_length);
+  name[name_length] = '\0';
+  ccli_command *command = find_command(interface, name);
+  if (!command) return word;
+
+  const char *equals = memchr(word, '=', length);
+  if (equals) {
+    size_t option_length = equals - word;
+    if (option_length >= sizeof(name)) return word;
+    memcpy(name, word, option_length);
+    name[option_length] = '\0';
+
+    ccli_option *option = ccli_table_find_option(&command->options, name);
+    if (!option || option->type != VAL_CHOICE) return word;
+    for (int i = 0; i < option->choices.count; i++) {
+      candidate_add(array, equals + 1, repl->cursor - (start + option_length + 1), option->choices.choices[i], ' ');
+    }
+    return equals + 1;
+  }
+
+  for (int i = 0; i < command->option_list.size; i++) {
+    ccli_option *option = command->option_list.options[i];
+    char suffix = (option->type == VAL_NULL || option->type == VAL_COUNTER) ? ' ' : '=';
+    candidate_add(array, word, length, option->long_option, suffix);
+    candidate_add(array, word, length, option->short_option, suffix);
+  }
+  return word;
+}
+
+// complete the word before the cursor as far as its candidates agree,
+// listing them if that doesn't get any further
+static void repl_complete(repl *repl) {
+  size_t start = repl->cursor;
+  while (start > 0 && repl->line.chars[start - 1] != ' ') start--;
+
+  candidate_array array = { 0, 0, NULL };
+  const char *word = repl_candidates(repl, start, &array);
+  size_t length = repl->line.chars + repl->cursor - word;
+
+  if (array.size == 0) {
+    repl_write("\a", 1);
+  } else if (array.size == 1) {
+    repl_candidate *candidate = &array.candidates[0];
+    repl_insert(repl, candidate->text + length, strlen(candidate->text) - length);
+    repl_insert(repl, &candidate->suffix, 1);
+  } else {
+    size_t common = strlen(array.candidates[0].text);
+    for (int i = 1; i < array.size; i++) {
+      size_t j = 0;
+      while (j < common && array.candidates[i].text[j] == array.candidates[0].text[j]) j++;
+      common = j;
+    }
+
+    if (common > length) {
+      repl_insert(repl, array.candidates[0].text + length, common - length);
+    } else {
+      ccli_buffer list;
+      buffer_init(&list);
+      buffer_append(&list, "\r\n", 2);
+      for (int i = 0; i < array.size; i++) buffer_printf(&list, "%s  ", array.candidates[i].text);
+      buffer_append(&list, "\r\n", 2);
+      repl_write(list.chars, list.size);
+      buffer_free(&list);
+    }
+  }
+
+  mem_free(array.candidates);
+}
+
+// edit a line on the terminal. false at the end of input.
+static bool repl_edit_line(repl *repl) {
+  repl_set_line(repl, "");
+  repl->history_index = repl->history.size;
+  repl_raw_mode(repl);
+  repl_refresh(repl);
+
+  bool done = false, entered = false;
+  while (!done) {
+    int key = repl_read_key();
+    switch (key) {
+      case -1:
+        done = true;
+        break;
+      case '\r':
+      case '\n':
+        done = entered = true;
+        break;
+      case CTRL_KEY('d'):
+        if (repl->line.size > 0) {
+          if (repl->cursor < repl->line.size) repl_erase(repl, repl->cursor, repl->cursor + 1);
+        } else {
+          done = true;
+        }
+        break;
+      case CTRL_KEY('c'):
+        // drop the line, like a shell
+        repl_write("^C", 2);
+        repl_set_line(repl, "");
+        done = entered = true;
+        break;
+      case 127:
+      case CTRL_KEY('h'):
+        if (repl->cursor > 0) repl_erase(repl, repl->cursor - 1, repl->cursor);
+        break;
+      case KEY_DELETE:
+        if (repl->cursor < repl->line.size) repl_erase(repl, repl->cursor, repl->cursor + 1);
+        break;
+      case KEY_LEFT:
+      case CTRL_KEY('b'):
+        if (repl->cursor > 0) repl->cursor--;
+        break;
+      case KEY_RIGHT:
+      case CTRL_KEY('f'):
+        if (repl->cursor < repl->line.size) repl->cursor++;
+        break;
+      case KEY_HOME:
+      case CTRL_KEY('a'):
+        repl->cursor = 0;
+        break;
+      case KEY_END:
+      case CTRL_KEY('e'):
+        repl->cursor = repl->line.size;
+        break;
+      case KEY_UP:
+      case CTRL_KEY('p'):
+        repl_browse(repl, -1);
+        break;
+      case KEY_DOWN:
+      case CTRL_KEY('n'):
+        repl_browse(repl, 1);
+        break;
+      case CTRL_KEY('u'):
+        repl_erase(repl, 0, repl->cursor);
+        break;
+      case CTRL_KEY('k'):
+        repl_erase(repl, repl->cursor, repl->line.size);
+        repl->cursor = repl->line.size;
+        break;
+      case CTRL_KEY('w'): {
+        size_t start = repl->cursor;
+        while (start > 0 && repl->line.chars[start - 1] == ' ') start--;
+        while (start > 0 && repl->line.chars[start - 1] != ' ') start--;
+        repl_erase(repl, start, repl->cursor);
+        break;
+      }
+      case CTRL_KEY('l'):
+        repl_write("\033[H\033[2J", 7);
+        break;
+      case '\t':
+        repl_complete(repl);
+        break;
+      default:
+        if (key >= ' ' && key < 256) {
+          char c = key;
+          repl_insert(repl, &c, 1);
+        }
+        break;
+    }
+
+    if (!done) repl_refresh(repl);
+  }
+
+  repl_write("\r\n", 2);
+  repl_cooked_mode(repl);
+  return entered;
+}
+
+// read a line from input that isn't a terminal, like a script
+static bool repl_read_line(repl *repl) {
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length = getline(&line, &capacity, stdin);
+  // getline's buffer comes from the C library, not the allocator
+  if (length < 0) {
+    free(line);
+    return false;
+  }
+
+  while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+  repl_set_line(repl, line);
+  free(line);
+  return true;
+}
+
+// split [line] into words in place. quotes keep spaces inside a word.
+// returns -1 if there are more than [max] words.
+static int repl_split(char *line, char **words, int max) {
+  int count = 0;
+  char *read = line, *write = line;
+  for (;;) {
+    while (*read == ' ' || *read == '\t') read++;
+    if (!*read) break;
+    if (count == max) return -1;
+
+    words[count++] = write;
+    char quote = '\0';
+    for (; *read && (quote || (*read != ' ' && *read != '\t')); read++) {
+      if (quote ? *read == quote : (*read == '"' || *read == '\'')) quote = quote ? '\0' : *read;
+      else *write++ = *read;
+    }
+
+    // the terminator can land on the space that ended the word
+    char *end = write;
+    if (*read) read++;
+    *end = '\0';
+    write = end + 1;
+  }
+
+  return count;
+}
+
+// run one line. false when it asks to leave.
+static bool repl_dispatch(repl *repl, char *line) {
+  ccli *interface = repl->interface;
+  char *argv[REPL_MAX_ARGS + 3];
+  argv[0] = interface->exeName;
+  int count = repl_split(line, argv + 1, REPL_MAX_ARGS);
+  if (count < 0) {
+    ccli_echo_color(interface, COLOR_RED, "Error: more than %d words on a line.", REPL_MAX_ARGS);
+    return true;
+  }
+  if (count == 0) return true;
+
+  int argc = count + 1;
+  if (!strcmp(argv[1], "exit") || !strcmp(argv[1], "quit")) return false;
+  if (!strcmp(argv[1], "help")) {
+    // 'help' for the overview, 'help COMMAND' for one command
+    if (argc == 2) {
+      argc = 1;
+    } else {
+      argv[1] = argv[2];
+      argv[2] = "--help";
+      argc = 3;
+    }
+  }
+
+  argv[argc] = NULL;
+  // lines always start with the command, whatever the program's called
+  bool multi_call = interface->multi_call;
+  interface->multi_call = false;
+  run_in_process(interface, argc, argv, false);
+  interface->multi_call = multi_call;
+  fflush(interface->fp);
+  return true;
+}
+
+void ccli_repl(ccli *interface) {
+  repl repl;
+  repl.interface = interface;
+  buffer_init(&repl.line);
+  repl.cursor = 0;
+  history_init(&repl.history);
+  repl.history_index = 0;
+  repl.draft = NULL;
+
+  bool interactive = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) &&
+                     tcgetattr(STDIN_FILENO, &repl.cooked) == 0;
+
+  const char *name = strrchr(interface->exeName, '/');
+  name = name ? name + 1 : interface->exeName;
+  size_t prompt_length = strlen(name) + 3;
+  repl.prompt = mem_alloc(CCLI_MEMORY_OTHER, prompt_length);
+  snprintf(repl.prompt, prompt_length, "%s> ", name);
+
+  char *history_path = NULL;
+  const char *home = getenv("HOME");
+  if (interactive && home) {
+    size_t path_length = strlen(home) + strlen(name) + strlen("/._history") + 1;
+    history_path = mem_alloc(CCLI_MEMORY_OTHER, path_length);
+    snprintf(history_path, path_length, "%s/.%s_history", home, name);
+    history_load(&repl.history, history_path);
+  }
+
+  for (;;) {
+    fflush(interface->fp);
+    if (!(interactive ? repl_edit_line(&repl) : repl_read_line(&repl))) break;
+    if (repl.line.size == 0) continue;
+
+    if (history_path) {
+      history_add(&repl.history, repl.line.chars);
+      history_append(history_path, repl.line.chars);
+    }
+
+    // the words point into the line, which isn't touched again until
+    // the command is done
+    if (!repl_dispatch(&repl, repl.line.chars)) break;
+  }
+
+  if (history_path) history_save(&repl.history, history_path);
+  mem_free(history_path);
+  mem_free(repl.prompt);
+  mem_free(repl.draft);
+  history_free(&repl.history);
+  buffer_free(&repl.line);
+}
@@ -1,70 +1,519 @@
-#ifndef ccli_h
-#define ccli_h
-
-#include <stdio.h>
-#include <stdbool.h>
-
-typedef enum {
-  COLOR_RED,
-  COLOR_GREEN,
-  COLOR_YELLOW,
-  COLOR_BLUE,
-  COLOR_MAGENTA,
-  COLOR_CYAN
-} ccli_color;
-
-typedef struct ccli         ccli;
-typedef struct ccli_command ccli_command;
-typedef struct ccli_arg     ccli_arg;
-typedef struct ccli_option  ccli_option;
-
-typedef void (*ccli_command_callback)(ccli *interface);
-
-ccli *ccli_init(char *exeName, int argc, char **argv);
-void ccli_free(ccli *interface);
-void ccli_run(ccli *interface);
-void ccli_set_description(ccli *interface, char *description);
-void ccli_set_output_stream(ccli *interface, FILE *fp);
-
-// functions for retrieving option values in a [ccli_command_callback].
-//
-// returns true if the option was specified on the command line,
-// and is of the appropriate type
-bool ccli_option_exists(ccli *interface, char *option);
-bool ccli_get_int_option(ccli *interface, char *option, int *value);
-bool ccli_get_double_option(ccli *interface, char *option, double *value);
-bool ccli_get_bool_option(ccli *interface, char *option, bool *value);
-bool ccli_get_string_option(ccli *interface, char *option, char **value);
-
-// functions for retrieving argument values in a [ccli_command_callback].
-//
-// fails if you try to get an inappropriate type from an argument.
-int ccli_get_int_arg(ccli *interface, int index);
-double ccli_get_double_arg(ccli *interface, int index);
-bool ccli_get_bool_arg(ccli *interface, int index);
-char *ccli_get_string_arg(ccli *interface, int index);
-
-ccli_command *ccli_add_command(ccli *interface, char *command, ccli_command_callback callback);
-void ccli_command_set_description(ccli_command *command, char *description);
-
-ccli_arg *ccli_command_add_number_arg(ccli_command *command, char *name);
-ccli_arg *ccli_command_add_bool_arg(ccli_command *command, char *name);
-ccli_arg *ccli_command_add_string_arg(ccli_command *command, char *name);
-void ccli_arg_set_description(ccli_arg *arg, char *description);
-ccli_option *ccli_add_number_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option);
-ccli_option *ccli_add_bool_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option);
-ccli_option *ccli_add_string_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option);
-ccli_option *ccli_add_empty_option(ccli *interface, ccli_command *command,
-                                    char *double_dash_option, char *single_dash_option);
-void ccli_option_set_description(ccli_option *option, char *description);
-void ccli_option_set_default_number(ccli_option *option, double value);
-void ccli_option_set_default_bool(ccli_option *option, bool value);
-void ccli_option_set_default_string(ccli_option *option, char *value);
-
-void ccli_echo(ccli *interface, const char *format, ...);
-void ccli_echo_color(ccli *interface, ccli_color color, const char *format, ...);
-
+#ifndef ccli_h
+#define ccli_h
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sched.h>
+
+typedef enum {
+  COLOR_RED,
+  COLOR_GREEN,
+  COLOR_YELLOW,
+  COLOR_BLUE,
+  COLOR_MAGENTA,
+  COLOR_CYAN
+} ccli_color;
+
+// suffixes accepted by int64/uint64 options and arguments.
+//
+// CCLI_UNIT_BYTES:    B, K/KiB, M/MiB, ... (powers of 1024), KB, MB, ... (powers of 1000)
+// CCLI_UNIT_DURATION: ns, us, ms, s, m, h, d. the value is in nanoseconds,
+//                     and anything but 0 must have a suffix.
+typedef enum {
+  CCLI_UNIT_NONE,
+  CCLI_UNIT_BYTES,
+  CCLI_UNIT_DURATION
+} ccli_unit;
+
+// what [ccli_set_async_output] does when the writer can't keep up.
+//
+// CCLI_BACKPRESSURE_BLOCK: wait for the writer to free up room.
+// CCLI_BACKPRESSURE_GROW:  keep buffering in memory, without bound.
+// CCLI_BACKPRESSURE_DROP:  discard the output, see [ccli_async_dropped].
+typedef enum {
+  CCLI_BACKPRESSURE_BLOCK,
+  CCLI_BACKPRESSURE_GROW,
+  CCLI_BACKPRESSURE_DROP
+} ccli_backpressure;
+
+// the format of emitted records, picked by --ccli-output=FORMAT on any
+// command line:
+//
+// CCLI_OUTPUT_TEXT:   one line of name=value pairs per record (default)
+// CCLI_OUTPUT_JSON:   one array of objects
+// CCLI_OUTPUT_NDJSON: one object per line
+// CCLI_OUTPUT_CSV:    a header row, then one row per record
+typedef enum {
+  CCLI_OUTPUT_TEXT,
+  CCLI_OUTPUT_JSON,
+  CCLI_OUTPUT_NDJSON,
+  CCLI_OUTPUT_CSV
+} ccli_output_format;
+
+// what a [ccli_table_writer] does with a cell wider than its column
+typedef enum {
+  CCLI_OVERFLOW_TRUNCATE,
+  CCLI_OVERFLOW_GROW
+} ccli_overflow;
+
+// what ccli's memory is used for, see [ccli_memory_stats].
+//
+// CCLI_MEMORY_SCHEMA: the interface, commands, options, arguments
+// CCLI_MEMORY_KEYS:   the option name lookup tables
+// CCLI_MEMORY_PARSE:  parsed values, input files read into memory
+// CCLI_MEMORY_OUTPUT: output buffers, records, tables, logs
+// CCLI_MEMORY_OTHER:  tracing, caching, watching, the repl
+typedef enum {
+  CCLI_MEMORY_SCHEMA,
+  CCLI_MEMORY_KEYS,
+  CCLI_MEMORY_PARSE,
+  CCLI_MEMORY_OUTPUT,
+  CCLI_MEMORY_OTHER,
+  CCLI_MEMORY_CATEGORIES
+} ccli_memory_category;
+
+typedef struct {
+  size_t live_bytes;
+  size_t peak_bytes;
+  // every allocation made, including ones since freed
+  uint64_t allocations;
+} ccli_memory_usage;
+
+typedef void *(*ccli_malloc_fn)(void *context, size_t size);
+typedef void *(*ccli_realloc_fn)(void *context, void *pointer, size_t size);
+typedef void (*ccli_free_fn)(void *context, void *pointer);
+
+typedef struct ccli         ccli;
+typedef struct ccli_command ccli_command;
+typedef struct ccli_arg     ccli_arg;
+typedef struct ccli_option  ccli_option;
+typedef struct ccli_range_list ccli_range_list;
+typedef struct ccli_file    ccli_file;
+typedef struct ccli_table_writer ccli_table_writer;
+typedef struct ccli_progress ccli_progress;
+typedef struct ccli_type    ccli_type;
+
+typedef void (*ccli_command_callback)(ccli *interface);
+// called for each line by [ccli_for_each_line]. [line] isn't NUL terminated,
+// and doesn't include its newline.
+typedef void (*ccli_line_callback)(ccli *interface, const char *line, size_t length, void *context);
+
+// called for each item by [ccli_parallel_for]
+typedef void (*ccli_task_callback)(ccli *interface, size_t index, void *context);
+
+// converts [text] into the type's value at [value], which is zeroed and
+// the size given to [ccli_register_type]. returns NULL on success, or a
+// short reason the text isn't valid.
+typedef const char *(*ccli_parse_fn)(const char *text, void *value);
+// writes [value] as text into [buffer], snprintf style
+typedef int (*ccli_format_fn)(const void *value, char *buffer, size_t size);
+
+typedef struct {
+  // worker threads, 0 for the command's --jobs option, or one per online cpu
+  int threads;
+  // bytes of input per unit of work, 0 for the default of 1 MiB
+  size_t chunk_size;
+  // passed through to the callback
+  void *context;
+} ccli_line_options;
+
+// route all of ccli's allocations through these, each called with
+// [context]. has to be called before anything else is allocated, so
+// before [ccli_init]. NULL functions restore the C library's.
+void ccli_set_allocator(ccli_malloc_fn malloc_fn, ccli_realloc_fn realloc_fn, ccli_free_fn free_fn, void *context);
+// what ccli has allocated, across every interface, one entry per category
+void ccli_memory_stats(ccli_memory_usage usage[CCLI_MEMORY_CATEGORIES]);
+
+ccli *ccli_init(char *exeName, int argc, char **argv);
+void ccli_free(ccli *interface);
+void ccli_run(ccli *interface);
+void ccli_set_description(ccli *interface, char *description);
+void ccli_set_output_stream(ccli *interface, FILE *fp);
+
+// what a ccli_invoke run printed, and the status it would have exited with
+typedef struct {
+  int status;
+  // NUL-terminated, owned by the caller (see ccli_result_free)
+  char *output;
+  size_t length;
+} ccli_result;
+
+// run [argv] like ccli_run would, in-process: everything the run prints
+// is captured into [result] (without colors), and an error returns its
+// exit status instead of exiting. option and argument values from the
+// previous run are reset first, so one interface can be invoked over and
+// over. returns [result->status].
+int ccli_invoke(ccli *interface, int argc, char **argv, ccli_result *result);
+void ccli_result_free(ccli_result *result);
+
+// read command lines and run them one after another against the
+// registered commands, until 'exit' or the end of input. on a terminal,
+// lines can be edited, recalled from history (kept in ~/.NAME_history),
+// and tab-completed from the command, option and choice names. 'help'
+// and 'help COMMAND' show usage. a command's option and argument values
+// are reset before each line.
+void ccli_repl(ccli *interface);
+
+// plugins are shared objects that declare their commands with
+// CCLI_PLUGIN_COMMAND, and register them in a ccli_plugin_register
+// function. ccli_add_plugin_dir reads only the declarations of each .so
+// in [dir], so help and completion list the commands without loading
+// anything. the first time one of a plugin's commands is dispatched the
+// plugin is dlopen'd, and its ccli_plugin_register adds its commands
+// with ccli_add_command as usual. plugins call back into ccli from the
+// executable, which has to be linked with -rdynamic. returns the number
+// of plugins found.
+int ccli_add_plugin_dir(ccli *interface, const char *dir);
+
+#define CCLI_PLUGIN_SECTION "ccli_plugin_manifest"
+#define CCLI_PLUGIN_REGISTER "ccli_plugin_register"
+typedef void (*ccli_plugin_register_fn)(ccli *interface);
+
+// in a plugin, at file scope: CCLI_PLUGIN_COMMAND("name", "description");
+#define CCLI_PLUGIN_COMMAND(name, description)                        \
+  __attribute__((used, section(CCLI_PLUGIN_SECTION), aligned(1)))     \
+  static const char CCLI_PLUGIN_ID(ccli_plugin_command_, __COUNTER__)[] = name "\0" description
+#define CCLI_PLUGIN_ID(prefix, counter) CCLI_PLUGIN_ID_(prefix, counter)
+#define CCLI_PLUGIN_ID_(prefix, counter) prefix##counter
+
+// for one binary installed under many names, like busybox: when
+// [enabled], a program name (the basename of argv[0]) that's one of
+// the commands runs that command, with its options and arguments from
+// argv[1] on. under any other name the command comes from argv[1] as
+// usual. either way, help and usage show the name that was invoked.
+void ccli_set_multi_call(ccli *interface, bool enabled);
+// symlinks [target] (NULL for the running executable) into [dir] under
+// each command's name. links already there from an earlier install are
+// kept. returns the number of links made, or -1 with errno set if one
+// couldn't be. '--ccli-install-links=DIR' does the same from the
+// command line.
+int ccli_install_links(ccli *interface, const char *dir, const char *target);
+
+// hand output to a background thread that writes it to the output stream,
+// so callbacks don't wait on a slow reader. [ring_bytes] bounds what's
+// queued (0 for 1 MiB) before [policy] kicks in. everything queued is
+// written by [ccli_free], or before the process exits on an error.
+void ccli_set_async_output(ccli *interface, ccli_backpressure policy, size_t ring_bytes);
+// writes discarded under CCLI_BACKPRESSURE_DROP
+uint64_t ccli_async_dropped(ccli *interface);
+
+// where cacheable commands keep their results: [dir] (NULL for
+// $XDG_CACHE_HOME/NAME or ~/.cache/NAME), holding at most [max_bytes]
+// (0 for 64 MiB) before the least recently used results are dropped
+void ccli_set_cache(ccli *interface, const char *dir, size_t max_bytes);
+
+// functions for retrieving option values in a [ccli_command_callback].
+//
+// returns true if the option was specified on the command line,
+// and is of the appropriate type
+bool ccli_option_exists(ccli *interface, char *option);
+bool ccli_get_int_option(ccli *interface, char *option, int *value);
+bool ccli_get_double_option(ccli *interface, char *option, double *value);
+bool ccli_get_bool_option(ccli *interface, char *option, bool *value);
+bool ccli_get_string_option(ccli *interface, char *option, char **value);
+bool ccli_get_int64_option(ccli *interface, char *option, int64_t *value);
+bool ccli_get_uint64_option(ccli *interface, char *option, uint64_t *value);
+// returns the index of the given choice in the array passed to [ccli_add_choice_option]
+bool ccli_get_choice_option(ccli *interface, char *option, int *value);
+// list options hand back every value given, in command line order.
+// [values] points into the option's own storage and stays valid until
+// the interface is freed. counter options are read with [ccli_get_int_option].
+bool ccli_get_string_list_option(ccli *interface, char *option, char ***values, int *count);
+bool ccli_get_number_list_option(ccli *interface, char *option, double **values, int *count);
+bool ccli_get_range_option(ccli *interface, char *option, ccli_range_list **value);
+bool ccli_get_file_option(ccli *interface, char *option, ccli_file **value);
+// [value] points at the option's own copy, valid until the next run.
+// returns false if the option isn't of [type].
+bool ccli_get_typed_option(ccli *interface, char *option, ccli_type *type, const void **value);
+
+// functions for retrieving argument values in a [ccli_command_callback].
+//
+// fails if you try to get an inappropriate type from an argument.
+int ccli_get_int_arg(ccli *interface, int index);
+double ccli_get_double_arg(ccli *interface, int index);
+bool ccli_get_bool_arg(ccli *interface, int index);
+char *ccli_get_string_arg(ccli *interface, int index);
+int64_t ccli_get_int64_arg(ccli *interface, int index);
+uint64_t ccli_get_uint64_arg(ccli *interface, int index);
+ccli_range_list *ccli_get_range_arg(ccli *interface, int index);
+ccli_file *ccli_get_file_arg(ccli *interface, int index);
+const void *ccli_get_typed_arg(ccli *interface, int index, ccli_type *type);
+
+ccli_command *ccli_add_command(ccli *interface, char *command, ccli_command_callback callback);
+void ccli_command_set_description(ccli_command *command, char *description);
+// for commands whose output depends only on their options, arguments and
+// input files: a run with the same values, and unchanged files (by size
+// and mtime), replays the stored output and exit status instead of
+// calling the callback. not used under --ccli-bench or --ccli-watch, or
+// for input on stdin.
+void ccli_command_set_cacheable(ccli_command *command, bool cacheable);
+
+ccli_arg *ccli_command_add_number_arg(ccli_command *command, char *name);
+ccli_arg *ccli_command_add_bool_arg(ccli_command *command, char *name);
+ccli_arg *ccli_command_add_string_arg(ccli_command *command, char *name);
+// integers accept 0x, 0o and 0b prefixes, and unit suffixes if a unit is set
+ccli_arg *ccli_command_add_int64_arg(ccli_command *command, char *name);
+ccli_arg *ccli_command_add_uint64_arg(ccli_command *command, char *name);
+ccli_arg *ccli_command_add_range_arg(ccli_command *command, char *name);
+// file arguments and options must name a readable file, or '-' for stdin
+ccli_arg *ccli_command_add_file_arg(ccli_command *command, char *name);
+ccli_arg *ccli_command_add_typed_arg(ccli_command *command, char *name, ccli_type *type);
+void ccli_arg_set_description(ccli_arg *arg, char *description);
+void ccli_arg_set_unit(ccli_arg *arg, ccli_unit unit);
+ccli_option *ccli_add_number_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_bool_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_string_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_empty_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_int64_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_uint64_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_file_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+// a value type for options and arguments: each value is converted by
+// [parse] once, while the command line is parsed, and handed to the
+// callback by pointer. [name] is shown in help, and [format] (optional)
+// shows defaults there. values are copied byte for byte, so they
+// shouldn't point at anything.
+ccli_type *ccli_register_type(ccli *interface, char *name, size_t size,
+                              ccli_parse_fn parse, ccli_format_fn format);
+ccli_option *ccli_add_typed_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option,
+                                    ccli_type *type);
+// a range list is a set of non-negative integers, like '0-511,600,700-1023'
+ccli_option *ccli_add_range_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+// repeatable options: '--tag=a --tag=b' collects both values, and
+// each '-v' in '-v -v' or '-vv' bumps a counter by one
+ccli_option *ccli_add_string_list_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_number_list_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+ccli_option *ccli_add_counter_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option);
+// [choices] isn't copied, and must outlive the interface
+ccli_option *ccli_add_choice_option(ccli *interface, ccli_command *command,
+                                    char *double_dash_option, char *single_dash_option,
+                                    char **choices, int count);
+void ccli_option_set_description(ccli_option *option, char *description);
+void ccli_option_set_default_number(ccli_option *option, double value);
+void ccli_option_set_default_bool(ccli_option *option, bool value);
+void ccli_option_set_default_string(ccli_option *option, char *value);
+void ccli_option_set_default_choice(ccli_option *option, int choice);
+void ccli_option_set_default_int64(ccli_option *option, int64_t value);
+void ccli_option_set_default_uint64(ccli_option *option, uint64_t value);
+// copies the type's size in bytes from [value]
+void ccli_option_set_default_typed(ccli_option *option, const void *value);
+void ccli_option_set_unit(ccli_option *option, ccli_unit unit);
+// every value of a string or string list option has to match [pattern]
+// in full, or parsing fails. patterns have literals, '.', [sets] (with
+// ranges and '^'), \d \w \s and their negations, (groups), '|', and the
+// * + ? {n} {n,} {n,m} repeats. an invalid pattern is an error here.
+void ccli_option_set_pattern(ccli_option *option, char *pattern);
+
+// option constraints, checked after a command's options are parsed.
+//
+// all options passed to one constraint must belong to the same command.
+void ccli_option_set_required(ccli_option *option, bool required);
+void ccli_options_conflict(ccli_option *a, ccli_option *b);
+void ccli_option_requires(ccli_option *option, ccli_option *required);
+// at most one of [options] may be given
+void ccli_options_exclusive(ccli_option **options, int count);
+
+// range lists are owned by the option or argument they were parsed for
+bool ccli_range_list_contains(ccli_range_list *list, uint64_t value);
+// saturates at UINT64_MAX, one short of the full range's 2^64 members
+uint64_t ccli_range_list_count(ccli_range_list *list);
+// finds the smallest member >= [from]
+bool ccli_range_list_next(ccli_range_list *list, uint64_t from, uint64_t *value);
+// finds the smallest member > [value], for in-order iteration that
+// stops after UINT64_MAX instead of wrapping:
+//
+//   for (bool more = ccli_range_list_next(list, 0, &v); more; more = ccli_range_list_after(list, v, &v))
+bool ccli_range_list_after(ccli_range_list *list, uint64_t value, uint64_t *next);
+#ifdef CPU_SETSIZE
+// fails if the list has a member past CPU_SETSIZE
+bool ccli_range_list_to_cpu_set(ccli_range_list *list, cpu_set_t *set);
+#endif
+
+// files are owned by the option or argument they were opened for, and are
+// closed (and unmapped) by [ccli_free].
+//
+// returns a read-only view of the whole file, mapping it in on first use.
+// returns NULL, with errno set, if it can't be read.
+const char *ccli_file_data(ccli_file *file, size_t *length);
+char *ccli_file_path(ccli_file *file);
+
+// under --ccli-watch[=DEBOUNCE_MS], the callback runs again whenever a
+// file argument or option, or a path given here (a file or a directory),
+// changes. file values are opened again before each run. can be called
+// from the callback, for inputs it finds on its own.
+void ccli_watch_path(ccli *interface, const char *path);
+// the paths that changed since the callback last ran under --ccli-watch.
+// false on the first run, which has to do all of the work.
+bool ccli_get_changed_paths(ccli *interface, char ***paths, int *count);
+
+// run [callback] over every line of [source], splitting it into
+// newline-aligned chunks that are handed out to worker threads.
+//
+// anything a callback prints with ccli_echo* is buffered per chunk, and
+// the chunks are written out in input order, so the output matches a
+// single-threaded run. [options] may be NULL. returns false if the
+// input couldn't be read.
+bool ccli_for_each_line(ccli *interface, ccli_file *source, ccli_line_callback callback, ccli_line_options *options);
+
+// run [callback] for items 0..count-1 on a work-stealing pool, sized by the
+// invoked command's --jobs option if given, or one thread per online cpu.
+//
+// output from ccli_echo* is buffered per item and written in item order,
+// so it doesn't depend on how the items were scheduled.
+void ccli_parallel_for(ccli *interface, size_t count, ccli_task_callback callback, void *context);
+
+void ccli_echo(ccli *interface, const char *format, ...);
+void ccli_echo_color(ccli *interface, ccli_color color, const char *format, ...);
+
+// log levels, for [ccli_log]. they're plain numbers so the preprocessor
+// can compare them.
+#define CCLI_LOG_TRACE 0
+#define CCLI_LOG_DEBUG 1
+#define CCLI_LOG_INFO  2
+#define CCLI_LOG_WARN  3
+#define CCLI_LOG_ERROR 4
+
+// logs below this level are compiled out. define it before including
+// ccli.h, e.g. -DCCLI_LOG_MIN_LEVEL=CCLI_LOG_INFO.
+#ifndef CCLI_LOG_MIN_LEVEL
+#define CCLI_LOG_MIN_LEVEL CCLI_LOG_TRACE
+#endif
+
+// ccli_log(interface, DEBUG, "loaded %d rules", count);
+//
+// writes a line to stderr, buffered apart from the output stream. at
+// runtime WARN and up are logged, one level more for each -v/--verbose
+// and one less for each -q/--quiet, which every command takes. the
+// arguments of a disabled log aren't evaluated.
+#define ccli_log(interface, level, ...) CCLI_LOG_AT_##level(interface, __VA_ARGS__)
+
+#define CCLI_LOG_IF(interface, level, ...)                                                 \
+  do {                                                                                     \
+    if (ccli_log_enabled(interface, level)) ccli_log_write(interface, level, __VA_ARGS__); \
+  } while (0)
+
+#if CCLI_LOG_MIN_LEVEL <= CCLI_LOG_TRACE
+#define CCLI_LOG_AT_TRACE(interface, ...) CCLI_LOG_IF(interface, CCLI_LOG_TRACE, __VA_ARGS__)
+#else
+#define CCLI_LOG_AT_TRACE(interface, ...) ((void)0)
+#endif
+#if CCLI_LOG_MIN_LEVEL <= CCLI_LOG_DEBUG
+#define CCLI_LOG_AT_DEBUG(interface, ...) CCLI_LOG_IF(interface, CCLI_LOG_DEBUG, __VA_ARGS__)
+#else
+#define CCLI_LOG_AT_DEBUG(interface, ...) ((void)0)
+#endif
+#if CCLI_LOG_MIN_LEVEL <= CCLI_LOG_INFO
+#define CCLI_LOG_AT_INFO(interface, ...) CCLI_LOG_IF(interface, CCLI_LOG_INFO, __VA_ARGS__)
+#else
+#define CCLI_LOG_AT_INFO(interface, ...) ((void)0)
+#endif
+#if CCLI_LOG_MIN_LEVEL <= CCLI_LOG_WARN
+#define CCLI_LOG_AT_WARN(interface, ...) CCLI_LOG_IF(interface, CCLI_LOG_WARN, __VA_ARGS__)
+#else
+#define CCLI_LOG_AT_WARN(interface, ...) ((void)0)
+#endif
+#if CCLI_LOG_MIN_LEVEL <= CCLI_LOG_ERROR
+#define CCLI_LOG_AT_ERROR(interface, ...) CCLI_LOG_IF(interface, CCLI_LOG_ERROR, __VA_ARGS__)
+#else
+#define CCLI_LOG_AT_ERROR(interface, ...) ((void)0)
+#endif
+
+bool ccli_log_enabled(ccli *interface, int level);
+void ccli_log_write(ccli *interface, int level, const char *format, ...);
+// overrides the level from -v/-q
+void ccli_log_set_level(ccli *interface, int level);
+// prefix records with the local time, to the millisecond
+void ccli_log_set_timestamps(ccli *interface, bool timestamps);
+// write out buffered records. done by ccli_free, and before an error exit
+void ccli_log_flush(ccli *interface);
+
+// tracing, turned on with --ccli-trace=out.json on any command line (or
+// ccli_trace_start) and written out by ccli_free, or before an error
+// exit, as Chrome trace event json for Perfetto. ccli's own phases show
+// up as spans: dispatch, parse_options, validate_options, parse_args,
+// callback and flush.
+//
+// any thread can record. spans nest, and end in the reverse order they
+// began on each thread. [name] isn't copied, and must outlive the
+// interface; a string literal is best. without tracing, these return
+// right away.
+void ccli_trace_start(ccli *interface, const char *path);
+void ccli_trace_begin(ccli *interface, const char *name);
+void ccli_trace_end(ccli *interface);
+void ccli_trace_instant(ccli *interface, const char *name);
+
+// typed writes for hot output loops, with no format string to parse.
+// each goes wherever ccli_print would, and adds no newline.
+void ccli_write_str(ccli *interface, const char *chars);
+void ccli_write_strn(ccli *interface, const char *chars, size_t length);
+void ccli_write_i64(ccli *interface, int64_t value);
+void ccli_write_u64(ccli *interface, uint64_t value);
+// lowercase, without a 0x prefix
+void ccli_write_u64_hex(ccli *interface, uint64_t value);
+// the shortest decimal that reads back as the same double
+void ccli_write_f64(ccli *interface, double value);
+
+// structured output. a record is a ccli_emit_begin, its fields, and a
+// ccli_emit_end, and is written in the --ccli-output format as it's emitted,
+// so any number of records takes the same memory. records from
+// [ccli_for_each_line] and [ccli_parallel_for] callbacks come out in
+// order like any other output; elsewhere, emit from one thread at a time.
+//
+// csv columns come from the first record's field names.
+void ccli_emit_begin(ccli *interface);
+void ccli_emit_field_int(ccli *interface, const char *name, int64_t value);
+void ccli_emit_field_uint(ccli *interface, const char *name, uint64_t value);
+void ccli_emit_field_double(ccli *interface, const char *name, double value);
+void ccli_emit_field_bool(ccli *interface, const char *name, bool value);
+// a NULL [value] is json's null, or empty otherwise
+void ccli_emit_field_str(ccli *interface, const char *name, const char *value);
+void ccli_emit_field_strn(ccli *interface, const char *name, const char *value, size_t length);
+void ccli_emit_end(ccli *interface);
+ccli_output_format ccli_get_output_format(ccli *interface);
+
+// aligned columns, written a row at a time like `ps` does.
+//
+// widths come from the headers, any width hints, and the first
+// [sample_rows] rows, which are held back until they've been measured.
+// no other rows are kept. a later cell that doesn't fit its column is cut
+// short with an ellipsis, or widens the column from then on, per [overflow].
+ccli_table_writer *ccli_table_writer_new(ccli *interface, int sample_rows, ccli_overflow overflow);
+// returns the column's index. [width] of 0 sizes it from the sampled rows.
+// [header] isn't copied, and must outlive the writer.
+int ccli_table_writer_add_column(ccli_table_writer *writer, char *header, int width);
+void ccli_table_writer_set_color(ccli_table_writer *writer, int column, ccli_color color);
+void ccli_table_writer_set_align_right(ccli_table_writer *writer, int column, bool align_right);
+// fill the next cell of the current row
+void ccli_table_writer_cell(ccli_table_writer *writer, const char *format, ...);
+void ccli_table_writer_end_row(ccli_table_writer *writer);
+// writes out any rows still held back, and frees the writer
+void ccli_table_writer_end(ccli_table_writer *writer);
+
+// a progress bar (or, with a [total] of 0, a spinner and a count) with
+// the rate and time left, redrawn by a background thread 10 times a
+// second. any thread can add to it. output printed in the meantime
+// erases the bar, which is drawn again on the next line.
+//
+// it's only drawn when the output stream is stdout and a terminal;
+// otherwise it just counts.
+ccli_progress *ccli_progress_start(ccli *interface, const char *label, uint64_t total);
+void ccli_progress_add(ccli_progress *progress, uint64_t amount);
+void ccli_progress_set_total(ccli_progress *progress, uint64_t total);
+uint64_t ccli_progress_done(ccli_progress *progress);
+// draws the final frame, with the average rate and time taken, and frees
+// the progress
+void ccli_progress_finish(ccli_progress *progress);
+
 #endif
\ No newline at end of file
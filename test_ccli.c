@@ -1,60 +1,1028 @@
-#include "ccli.h"
-
-void hello_callback(ccli *interface) {
-  ccli_echo_color(interface, COLOR_GREEN, "Hello!");
-  int number;
-  bool boolean;
-  char *string;
-  if (ccli_get_int_option(interface, "--number", &number)) {
-    ccli_echo_color(interface, COLOR_YELLOW, "number: %d", number);
-  }
-  if (ccli_get_bool_option(interface, "--bool", &boolean)) {
-    ccli_echo_color(interface, COLOR_BLUE, "bool: %s", boolean ? "true" : "false");
-  }
-  if (ccli_option_exists(interface, "--flag")) {
-    ccli_echo_color(interface, COLOR_CYAN, "flag exists");
-  }
-  if (ccli_get_string_option(interface, "--string", &string)) {
-    ccli_echo(interface, "string: %s", string);
-  }
-
-  ccli_echo(interface, "test_arg: %s", ccli_get_bool_arg(interface, 0) ? "true" : "false");
-}
-
-void hello_command(ccli *interface) {
-  ccli_command *hello = ccli_add_command(interface, "hello", hello_callback);
-  ccli_command_set_description(hello, "Say hello, and use some random options!");
-
-  ccli_option *number = ccli_add_number_option(interface, hello, "--number", NULL);
-  ccli_option_set_default_number(number, 3);
-  ccli_option *string = ccli_add_string_option(interface, hello, "--string", NULL);
-  ccli_option_set_default_string(string, "default string");
-  ccli_add_bool_option(interface, hello, "--bool", NULL);
-  ccli_add_empty_option(interface, hello, "--flag", NULL);
-
-  ccli_command_add_bool_arg(hello, "test_arg");
-}
-
-void goodbye_callback(ccli *interface) {
-    ccli_echo_color(interface, COLOR_MAGENTA, "Goodbye, %s :'(", ccli_get_string_arg(interface, 0));
-}
-
-void goodbye_command(ccli *interface) {
-    ccli_command *goodbye = ccli_add_command(interface, "goodbye", goodbye_callback);
-    ccli_arg *name = ccli_command_add_string_arg(goodbye, "name");
-    ccli_arg_set_description(name, "Your name (no spaces)");
-}
-
-int main(int argc, char **argv) {
-  ccli *interface = ccli_init("test_ccli", argc, argv);
-  ccli_set_description(interface, "Some description for a command line interface.");
-
-  hello_command(interface);
-  goodbye_command(interface);
-
-  ccli_run(interface);
-
-  ccli_free(interface);
-
-  return 0;
-}
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+
+#include "ccli.h"
+
+enum { MODE_FAST, MODE_SAFE, MODE_PARANOID };
+static char *modes[] = { "fast", "safe", "paranoid" };
+
+// a custom type: dotted-quad addresses, parsed once into 4 bytes
+typedef struct { unsigned char octets[4]; } ipv4_address;
+static ccli_type *ipv4_type;
+
+static const char *parse_ipv4(const char *text, void *value) {
+  ipv4_address *address = value;
+  for (int i = 0; i < 4; i++) {
+    if (i > 0 && *text++ != '.') return "expected four numbers separated by dots";
+    if (*text < '0' || *text > '9') return "expected four numbers separated by dots";
+
+    int octet = 0;
+    for (int digits = 0; *text >= '0' && *text <= '9'; digits++) {
+      if (digits == 3) return "a number is too long";
+      octet = octet * 10 + (*text++ - '0');
+    }
+    if (octet > 255) return "each number must be at most 255";
+    address->octets[i] = octet;
+  }
+
+  return *text ? "unexpected text after the address" : NULL;
+}
+
+static int format_ipv4(const void *value, char *buffer, size_t size) {
+  const ipv4_address *address = value;
+  return snprintf(buffer, size, "%d.%d.%d.%d", address->octets[0], address->octets[1],
+                  address->octets[2], address->octets[3]);
+}
+
+void hello_callback(ccli *interface) {
+  ccli_log(interface, INFO, "saying hello");
+  ccli_echo_color(interface, COLOR_GREEN, "Hello!");
+  int number;
+  int mode;
+  bool boolean;
+  char *string;
+  if (ccli_get_int_option(interface, "--number", &number)) {
+    ccli_echo_color(interface, COLOR_YELLOW, "number: %d", number);
+  }
+  const void *bind;
+  if (ccli_get_typed_option(interface, "--bind", ipv4_type, &bind)) {
+    char text[16];
+    format_ipv4(bind, text, sizeof(text));
+    ccli_echo(interface, "bind: %s", text);
+  }
+  if (ccli_get_bool_option(interface, "--bool", &boolean)) {
+    ccli_echo_color(interface, COLOR_BLUE, "bool: %s", boolean ? "true" : "false");
+  }
+  if (ccli_option_exists(interface, "--flag")) {
+    ccli_echo_color(interface, COLOR_CYAN, "flag exists");
+  }
+  if (ccli_get_string_option(interface, "--string", &string)) {
+    ccli_echo(interface, "string: %s", string);
+  }
+  char **tags;
+  int tag_count, verbosity;
+  if (ccli_get_string_list_option(interface, "--tag", &tags, &tag_count)) {
+    for (int i = 0; i < tag_count; i++) {
+      ccli_echo(interface, "tag %d: %s", i, tags[i]);
+    }
+  }
+  if (ccli_get_int_option(interface, "--verbose", &verbosity) && verbosity > 0) {
+    ccli_echo(interface, "verbosity: %d", verbosity);
+  }
+  ccli_range_list *shards;
+  if (ccli_get_range_option(interface, "--shards", &shards)) {
+    uint64_t shard;
+    ccli_echo(interface, "shards: %llu selected, 42 is %s", (unsigned long long)ccli_range_list_count(shards),
+              ccli_range_list_contains(shards, 42) ? "in" : "out");
+    // the first few, which a wrap past UINT64_MAX would repeat
+    int shown = 0;
+    for (bool more = ccli_range_list_next(shards, 0, &shard); more && shown < 5; more = ccli_range_list_after(shards, shard, &shard)) {
+      ccli_echo(interface, "  shard %llu", (unsigned long long)shard);
+      shown++;
+    }
+  }
+  int64_t offset;
+  uint64_t count, size, timeout;
+  if (ccli_get_int64_option(interface, "--offset", &offset)) {
+    ccli_echo(interface, "offset: %lld", (long long)offset);
+  }
+  if (ccli_get_uint64_option(interface, "--count", &count)) {
+    ccli_echo(interface, "count: %llu", (unsigned long long)count);
+  }
+  if (ccli_get_uint64_option(interface, "--size", &size)) {
+    ccli_echo(interface, "size: %llu bytes", (unsigned long long)size);
+  }
+  if (ccli_get_uint64_option(interface, "--timeout", &timeout)) {
+    ccli_echo(interface, "timeout: %llu ns", (unsigned long long)timeout);
+  }
+  ccli_range_list *cpus;
+  if (ccli_get_range_option(interface, "--cpus", &cpus)) {
+    cpu_set_t set;
+    if (ccli_range_list_to_cpu_set(cpus, &set)) {
+      ccli_echo(interface, "cpus: %d in set, cpu 8 is %s", CPU_COUNT(&set), CPU_ISSET(8, &set) ? "in" : "out");
+    } else {
+      ccli_echo(interface, "cpus: past CPU_SETSIZE");
+    }
+  }
+  if (ccli_get_choice_option(interface, "--mode", &mode)) {
+    switch (mode) {
+      case MODE_FAST:     ccli_echo(interface, "mode: going fast"); break;
+      case MODE_SAFE:     ccli_echo(interface, "mode: playing it safe"); break;
+      case MODE_PARANOID: ccli_echo(interface, "mode: trusting no one"); break;
+    }
+  }
+
+  ccli_echo(interface, "test_arg: %s", ccli_get_bool_arg(interface, 0) ? "true" : "false");
+}
+
+void hello_command(ccli *interface) {
+  ccli_command *hello = ccli_add_command(interface, "hello", hello_callback);
+  ccli_command_set_description(hello, "Say hello, and use some random options!");
+
+  ccli_option *number = ccli_add_number_option(interface, hello, "--number", NULL);
+  ccli_option_set_default_number(number, 3);
+  ccli_option *string = ccli_add_string_option(interface, hello, "--string", NULL);
+  ccli_option_set_default_string(string, "default string");
+  ccli_add_bool_option(interface, hello, "--bool", NULL);
+  ccli_add_empty_option(interface, hello, "--flag", NULL);
+  ccli_option *mode = ccli_add_choice_option(interface, hello, "--mode", NULL, modes, 3);
+  ccli_option_set_default_choice(mode, MODE_SAFE);
+  ccli_option *tag = ccli_add_string_list_option(interface, hello, "--tag", NULL);
+  ccli_option_set_pattern(tag, "[a-z][a-z0-9-]{0,31}");
+  ccli_add_range_option(interface, hello, "--shards", NULL);
+  ccli_add_range_option(interface, hello, "--cpus", NULL);
+  ccli_add_int64_option(interface, hello, "--offset", NULL);
+  ccli_add_uint64_option(interface, hello, "--count", NULL);
+  ccli_option *size = ccli_add_uint64_option(interface, hello, "--size", NULL);
+  ccli_option_set_unit(size, CCLI_UNIT_BYTES);
+  ccli_option *timeout = ccli_add_uint64_option(interface, hello, "--timeout", NULL);
+  ccli_option_set_unit(timeout, CCLI_UNIT_DURATION);
+  ipv4_type = ccli_register_type(interface, "IPV4", sizeof(ipv4_address), parse_ipv4, format_ipv4);
+  ccli_option *bind = ccli_add_typed_option(interface, hello, "--bind", NULL, ipv4_type);
+  ccli_option_set_default_typed(bind, &(ipv4_address){ { 127, 0, 0, 1 } });
+
+  ccli_add_counter_option(interface, hello, "--verbose", "-v");
+
+  ccli_command_add_bool_arg(hello, "test_arg");
+}
+
+void goodbye_callback(ccli *interface) {
+    ccli_echo_color(interface, COLOR_MAGENTA, "Goodbye, %s :'(", ccli_get_string_arg(interface, 0));
+    if (ccli_option_exists(interface, "--wave")) {
+      ccli_echo(interface, "*waves*");
+    } else if (ccli_option_exists(interface, "--hug")) {
+      ccli_echo(interface, "*hugs*");
+    }
+}
+
+void goodbye_command(ccli *interface) {
+    ccli_command *goodbye = ccli_add_command(interface, "goodbye", goodbye_callback);
+    ccli_arg *name = ccli_command_add_string_arg(goodbye, "name");
+    ccli_arg_set_description(name, "Your name (no spaces)");
+
+    ccli_option *wave = ccli_add_empty_option(interface, goodbye, "--wave", NULL);
+    ccli_option *hug = ccli_add_empty_option(interface, goodbye, "--hug", NULL);
+    ccli_options_conflict(wave, hug);
+}
+
+void ship_callback(ccli *interface) {
+  char *to;
+  ccli_get_string_option(interface, "--to", &to);
+  const char *by = ccli_option_exists(interface, "--air") ? "air"
+                 : ccli_option_exists(interface, "--sea") ? "sea" : "road";
+  ccli_echo(interface, "shipping to %s by %s", to, by);
+
+  double value;
+  if (ccli_option_exists(interface, "--insure") && ccli_get_double_option(interface, "--value", &value)) {
+    ccli_write_str(interface, "insured for ");
+    ccli_write_f64(interface, value);
+    ccli_write_str(interface, "\n");
+  }
+}
+
+void ship_command(ccli *interface) {
+  ccli_command *ship = ccli_add_command(interface, "ship", ship_callback);
+  ccli_command_set_description(ship, "Ship a parcel, to show option constraints.");
+
+  ccli_option *to = ccli_add_string_option(interface, ship, "--to", NULL);
+  ccli_option_set_required(to, true);
+
+  ccli_option *insure = ccli_add_empty_option(interface, ship, "--insure", NULL);
+  ccli_option *value = ccli_add_number_option(interface, ship, "--value", NULL);
+  ccli_option_requires(insure, value);
+
+  ccli_option *modes[] = {
+    ccli_add_empty_option(interface, ship, "--road", NULL),
+    ccli_add_empty_option(interface, ship, "--air", NULL),
+    ccli_add_empty_option(interface, ship, "--sea", NULL),
+  };
+  ccli_options_exclusive(modes, 3);
+}
+
+void lines_callback(ccli *interface) {
+  ccli_file *file = ccli_get_file_arg(interface, 0);
+  char **changed;
+  int changed_count;
+  if (ccli_get_changed_paths(interface, &changed, &changed_count)) {
+    for (int i = 0; i < changed_count; i++) ccli_echo(interface, "changed: %s", changed[i]);
+  }
+
+  size_t length;
+  const char *data = ccli_file_data(file, &length);
+  if (!data) {
+    ccli_echo_color(interface, COLOR_RED, "couldn't read %s", ccli_file_path(file));
+    return;
+  }
+
+  size_t lines = 0;
+  for (const char *c = data; (c = memchr(c, '\n', data + length - c)); c++) lines++;
+  ccli_echo(interface, "%s: %zu lines, %zu bytes", ccli_file_path(file), lines, length);
+}
+
+void lines_command(ccli *interface) {
+  ccli_command *lines = ccli_add_command(interface, "lines", lines_callback);
+  ccli_command_set_description(lines, "Count the lines in a file ('-' for stdin).");
+  ccli_command_add_file_arg(lines, "file");
+}
+
+void grep_line(ccli *interface, const char *line, size_t length, void *context) {
+  char *pattern = context;
+  if (memmem(line, length, pattern, strlen(pattern))) {
+    ccli_echo(interface, "%.*s", (int)length, line);
+  }
+}
+
+void grep_callback(ccli *interface) {
+  ccli_line_options options = { 0 };
+  ccli_get_int_option(interface, "--jobs", &options.threads);
+  uint64_t chunk_size;
+  if (ccli_get_uint64_option(interface, "--chunk-size", &chunk_size)) options.chunk_size = chunk_size;
+  options.context = ccli_get_string_arg(interface, 0);
+  ccli_log(interface, DEBUG, "searching %s for '%s' with %d jobs",
+           ccli_file_path(ccli_get_file_arg(interface, 1)), (char *)options.context, options.threads);
+
+  if (!ccli_for_each_line(interface, ccli_get_file_arg(interface, 1), grep_line, &options)) {
+    ccli_echo_color(interface, COLOR_RED, "couldn't read %s", ccli_file_path(ccli_get_file_arg(interface, 1)));
+  }
+}
+
+void grep_command(ccli *interface) {
+  ccli_command *grep = ccli_add_command(interface, "grep", grep_callback);
+  ccli_command_set_description(grep, "Print the lines of a file that contain a string.");
+  ccli_add_number_option(interface, grep, "--jobs", "-j");
+  ccli_option *chunk_size = ccli_add_uint64_option(interface, grep, "--chunk-size", NULL);
+  ccli_option_set_unit(chunk_size, CCLI_UNIT_BYTES);
+  ccli_command_add_string_arg(grep, "pattern");
+  ccli_command_add_file_arg(grep, "file");
+}
+
+void square_item(ccli *interface, size_t index, void *context) {
+  ccli_trace_begin(interface, "square");
+  ccli_emit_begin(interface);
+  ccli_emit_field_uint(interface, "n", index);
+  ccli_emit_field_uint(interface, "square", index * index);
+  ccli_emit_field_bool(interface, "even", index % 2 == 0);
+  ccli_emit_end(interface);
+  if (context) ccli_progress_add(context, 1);
+  ccli_trace_end(interface);
+}
+
+void squares_callback(ccli *interface) {
+  size_t count = ccli_get_uint64_arg(interface, 0);
+  ccli_progress *progress = NULL;
+  if (ccli_option_exists(interface, "--progress")) progress = ccli_progress_start(interface, "squaring", count);
+
+  ccli_parallel_for(interface, count, square_item, progress);
+  if (progress) ccli_progress_finish(progress);
+}
+
+void squares_command(ccli *interface) {
+  ccli_command *squares = ccli_add_command(interface, "squares", squares_callback);
+  ccli_command_set_description(squares, "Square the first n numbers in parallel.");
+  ccli_add_number_option(interface, squares, "--jobs", "-j");
+  ccli_add_empty_option(interface, squares, "--progress", NULL);
+  ccli_command_add_uint64_arg(squares, "n");
+}
+
+static char *number_names[] = { "zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine" };
+
+void powers_callback(ccli *interface) {
+  uint64_t count = ccli_get_uint64_arg(interface, 0);
+  ccli_overflow overflow = ccli_option_exists(interface, "--grow") ? CCLI_OVERFLOW_GROW : CCLI_OVERFLOW_TRUNCATE;
+
+  // columns are sized from the first 8 rows
+  ccli_table_writer *table = ccli_table_writer_new(interface, 8, overflow);
+  int n = ccli_table_writer_add_column(table, "N", 0);
+  int square = ccli_table_writer_add_column(table, "SQUARE", 0);
+  int cube = ccli_table_writer_add_column(table, "CUBE", 0);
+  int name = ccli_table_writer_add_column(table, "NAME", 12);
+  ccli_table_writer_set_align_right(table, n, true);
+  ccli_table_writer_set_align_right(table, square, true);
+  ccli_table_writer_set_align_right(table, cube, true);
+  ccli_table_writer_set_color(table, name, COLOR_CYAN);
+
+  for (uint64_t i = 0; i < count; i++) {
+    ccli_table_writer_cell(table, "%llu", (unsigned long long)i);
+    ccli_table_writer_cell(table, "%llu", (unsigned long long)(i * i));
+    ccli_table_writer_cell(table, "%llu", (unsigned long long)(i * i * i));
+    ccli_table_writer_cell(table, "%s-%s", number_names[i / 10 % 10], number_names[i % 10]);
+    ccli_table_writer_end_row(table);
+  }
+  ccli_table_writer_end(table);
+}
+
+void powers_command(ccli *interface) {
+  ccli_command *powers = ccli_add_command(interface, "powers", powers_callback);
+  ccli_command_set_description(powers, "Print a table of the first n squares and cubes.");
+  ccli_command_set_cacheable(powers, true);
+  ccli_add_empty_option(interface, powers, "--grow", NULL);
+  ccli_command_add_uint64_arg(powers, "n");
+}
+
+// counts the runs that weren't answered from the cache
+static int checksum_runs = 0;
+
+void checksum_callback(ccli *interface) {
+  ccli_file *file = ccli_get_file_arg(interface, 0);
+  size_t length;
+  const char *data = ccli_file_data(file, &length);
+  if (!data) {
+    ccli_echo_color(interface, COLOR_RED, "couldn't read %s", ccli_file_path(file));
+    return;
+  }
+
+  unsigned long long hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+  ccli_echo(interface, "%s: %016llx (run %d)", ccli_file_path(file), hash, ++checksum_runs);
+}
+
+void checksum_command(ccli *interface) {
+  ccli_command *checksum = ccli_add_command(interface, "checksum", checksum_callback);
+  ccli_command_set_description(checksum, "Hash a file, reusing the result until it changes.");
+  ccli_command_set_cacheable(checksum, true);
+  ccli_command_add_file_arg(checksum, "file");
+}
+
+void repl_callback(ccli *interface) {
+  ccli_repl(interface);
+}
+
+void repl_command(ccli *interface) {
+  ccli_command *repl = ccli_add_command(interface, "repl", repl_callback);
+  ccli_command_set_description(repl, "Run commands one line at a time.");
+}
+
+void nest_callback(ccli *interface) {
+  char *label;
+  int depth;
+  ccli_get_string_option(interface, "--label", &label);
+  ccli_get_int_option(interface, "--depth", &depth);
+
+  if (depth > 0) {
+    char depth_option[32];
+    snprintf(depth_option, sizeof(depth_option), ccli_option_exists(interface, "--fail") ? "--depth=x" : "--depth=%d", depth - 1);
+    char *argv[] = { "test_ccli", "nest", "--label=inner", depth_option, "ccli.h" };
+    ccli_result result;
+    int status = ccli_invoke(interface, 5, argv, &result);
+    if (status) ccli_echo(interface, "inner exited %d", status);
+    else ccli_echo(interface, "%.*s", (int)result.length - 1, result.output);
+    ccli_result_free(&result);
+  }
+
+  // the nested run mustn't have touched this run's values
+  ccli_file *file = ccli_get_file_arg(interface, 0);
+  size_t length;
+  ccli_echo(interface, "%s at depth %d: %s, %s", label, depth, ccli_file_path(file),
+            ccli_file_data(file, &length) ? "readable" : "unreadable");
+}
+
+void nest_command(ccli *interface) {
+  ccli_command *nest = ccli_add_command(interface, "nest", nest_callback);
+  ccli_command_set_description(nest, "Invoke this command again from its own callback.");
+  ccli_option *label = ccli_add_string_option(interface, nest, "--label", NULL);
+  ccli_option_set_default_string(label, "nest");
+  ccli_option *depth = ccli_add_number_option(interface, nest, "--depth", NULL);
+  ccli_option_set_default_number(depth, 0);
+  ccli_add_empty_option(interface, nest, "--fail", NULL);
+  ccli_command_add_file_arg(nest, "file");
+}
+
+#ifdef CCLI_INVOKE_TESTS
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <stdatomic.h>
+
+// each case runs a command line through ccli_invoke, and checks the exit
+// status and what it printed
+typedef struct {
+  char *command_line;
+  int status;
+  // must appear in the output
+  char *expected;
+  // must not, or NULL
+  char *unexpected;
+} invoke_case;
+
+static invoke_case invoke_cases[] = {
+  { "",                                       0, "Usage: ./test_ccli [command]",        NULL },
+  { "--help",                                 0, "hello",                               NULL },
+  { "hello true",                             0, "Hello!\nnumber: 3",                   "\033[" },
+  { "hello --number=5 true",                  0, "number: 5",                           NULL },
+  { "hello --number=abc true",                1, "invalid number: 'abc'",               NULL },
+  { "hello --string=x --flag true",           0, "flag exists\nstring: x",              NULL },
+  // the last case's values don't leak into this one
+  { "hello true",                             0, "string: default string",              "flag exists" },
+  { "hello --mode=fast false",                0, "mode: going fast\ntest_arg: false",   NULL },
+  { "hello --mode=slow true",                 1, "invalid choice for '--mode': 'slow'", NULL },
+  { "hello -vvv true",                        0, "verbosity: 3",                        NULL },
+  { "hello --bind=10.0.0.255 true",           0, "bind: 10.0.0.255",                    NULL },
+  { "hello true",                             0, "bind: 127.0.0.1",                     NULL },
+  { "hello --bind=10.0.256.1 true",           1, "invalid IPV4: '10.0.256.1' (each number must be at most 255)", NULL },
+  { "hello --tag=a --tag=b true",             0, "tag 0: a\ntag 1: b",                  NULL },
+  { "hello true",                             0, "test_arg: true",                      "tag 0" },
+  { "hello --tag=ok --tag=Not-ok true",       1, "invalid value for '--tag': 'Not-ok' (doesn't match", NULL },
+  { "hello --shards=1-3,42 true",             0, "shards: 4 selected, 42 is in",        NULL },
+  { "hello --shards=3-1 true",                1, "invalid range list",                  NULL },
+  { "hello --shards=0-18446744073709551615 true", 0, "shards: 18446744073709551615 selected, 42 is in", NULL },
+  { "hello --shards=5,0-18446744073709551615 true", 0, "shards: 18446744073709551615 selected", NULL },
+  { "hello --shards=18446744073709551616 true", 1, "invalid range list",                NULL },
+  { "hello --shards=18446744073709551614-18446744073709551615 true", 0,
+    "  shard 18446744073709551614\n  shard 18446744073709551615\nmode:", NULL },
+  { "hello --count=18446744073709551615 true", 0, "count: 18446744073709551615",        NULL },
+  { "hello --count=18446744073709551616 true", 1, "'18446744073709551616' (out of range)", NULL },
+  { "hello --count=12abc true",               1, "'12abc' (unexpected characters after the number)", NULL },
+  { "hello --count=x true",                   1, "'x' (expected digits)",               NULL },
+  { "hello --count=0x true",                  1, "'0x' (expected digits)",              NULL },
+  { "hello --count=0xff true",                0, "count: 255",                          NULL },
+  { "hello --count=0o17 true",                0, "count: 15",                           NULL },
+  { "hello --count=0b101 true",               0, "count: 5",                            NULL },
+  { "hello --count=-1 true",                  1, "'-1' (must not be negative)",         NULL },
+  { "hello --count=-0 true",                  0, "count: 0",                            NULL },
+  { "hello --offset=-9223372036854775808 true", 0, "offset: -9223372036854775808",      NULL },
+  { "hello --offset=-9223372036854775809 true", 1, "(out of range)",                    NULL },
+  { "hello --offset=9223372036854775808 true", 1, "(out of range)",                     NULL },
+  { "hello --offset=-0x10 true",              0, "offset: -16",                         NULL },
+  { "hello --size=4K true",                   0, "size: 4096 bytes",                    NULL },
+  { "hello --size=2GiB true",                 0, "size: 2147483648 bytes",              NULL },
+  { "hello --size=3XB true",                  1, "'3XB' (unknown unit suffix)",         NULL },
+  { "hello --size=16EiB true",                1, "'16EiB' (out of range)",              NULL },
+  { "hello --timeout=500ms true",             0, "timeout: 500000000 ns",               NULL },
+  { "hello --timeout=500 true",               1, "'500' (a duration needs a unit (ns, us, ms, s, m, h, d))", NULL },
+  { "hello --timeout=0 true",                 0, "timeout: 0 ns",                       NULL },
+  { "hello --cpus=0-3,8 true",                0, "cpus: 5 in set, cpu 8 is in",         NULL },
+  { "hello --cpus=8,1000 true",               0, "cpus: 2 in set, cpu 8 is in",         NULL },
+  { "hello --cpus=0,1023 true",               0, "cpus: 2 in set, cpu 8 is out",        NULL },
+  { "hello --cpus=0,1024 true",               0, "cpus: past CPU_SETSIZE",              NULL },
+  { "hello --help",                           0, "Usage: ./test_ccli hello [OPTIONS]",  "Hello!" },
+  { "hello",                                  1, "requires 1 arguments, but 0",         NULL },
+  { "goodbye --wave bob",                     0, "Goodbye, bob :'(\n*waves*",           NULL },
+  { "goodbye --wave --hug bob",               1, "can't be used together",              NULL },
+  { "ship --to=oslo",                         0, "shipping to oslo by road",            NULL },
+  { "ship --air",                             1, "missing required option: '--to'",     NULL },
+  { "ship --to=oslo --insure --value=20",     0, "shipping to oslo by road\ninsured for 20", NULL },
+  { "ship --to=oslo --insure --value=1e300",  0, "insured for 1e+300\n",                NULL },
+  { "ship --to=oslo --value=20",              0, "shipping to oslo by road",            "insured" },
+  { "ship --to=oslo --insure",                1, "option '--insure' requires '--value'", NULL },
+  { "ship --to=oslo --sea",                   0, "shipping to oslo by sea",             NULL },
+  { "ship --to=oslo --road --sea",            1, "options '--road' and '--sea' can't be used together", NULL },
+  { "ship --to=oslo --air --sea",             1, "options '--air' and '--sea' can't be used together", NULL },
+  { "ship --to=oslo --road --air --sea",      1, "options '--road' and '--air' can't be used together", NULL },
+  { "lines test_ccli.c",                      0, "test_ccli.c: ",                       NULL },
+  { "lines /no/such/file",                    1, "can't open",                          NULL },
+  { "squares --ccli-output=csv 3",            0, "n,square,even\n0,0,true\n1,1,false", NULL },
+  { "squares --ccli-output=json -j=2 2",      0, "[\n{\"n\":0",                         NULL },
+  { "squares 2",                              0, "n=1 square=1 even=false",             "[" },
+  { "--ccli-output=ndjson squares 1",         0, "{\"n\":0,\"square\":0,\"even\":true}\n", NULL },
+  { "squares --ccli-output=xml 2",            1, "invalid format for '--ccli-output': 'xml'", NULL },
+  { "powers 3",                               0, "SQUARE",                              NULL },
+  { "nest --label=outer --depth=1 test_ccli.c", 0, "inner at depth 0: ccli.h, readable\nouter at depth 1: test_ccli.c, readable", NULL },
+  { "nest --label=outer --depth=2 test_ccli.c", 0, "inner at depth 0: ccli.h, readable\ninner at depth 1: ccli.h, readable\nouter at depth 2: test_ccli.c, readable", NULL },
+  { "nest --label=outer --depth=1 --fail test_ccli.c", 0, "inner exited 1\nouter at depth 1: test_ccli.c, readable", NULL },
+  // and nothing of the nested runs is left over
+  { "nest test_ccli.c",                       0, "nest at depth 0: test_ccli.c",        "inner" },
+  { "nope",                                   0, "Unrecognized command -> 'nope'",      NULL },
+  { "--help",                                 0, "shout -> Repeat a word, loudly",      NULL },
+  { "shout -n=2 hey",                         0, "HEY!\nHEY!\n",                        NULL },
+  { "whisper HeLLo",                          0, "hello...",                            NULL },
+  { "shout --help",                           0, "how many times to say it",            NULL },
+  { "--ccli-bench=0 hello true",              1, "invalid run count for '--ccli-bench'", NULL },
+  { "--ccli-nope hello true",                 1, "unrecognized option: '--ccli-nope'",  NULL },
+  // multi-call: the program name picks the command
+  { "@hello true",                            0, "Hello!\nnumber: 3",                   NULL },
+  { "@/usr/local/bin/hello false",            0, "test_arg: false",                     NULL },
+  { "@hello --help",                          0, "Usage: ./hello [OPTIONS] <test_arg>", NULL },
+  { "@hello",                                 1, "requires 1 arguments, but 0",         NULL },
+  { "@shout hey",                             0, "HEY!",                                NULL },
+  { "@other --help",                          0, "Usage: ./other [command]",            NULL },
+  { "@other hello true",                      0, "Hello!",                              NULL },
+  // and the name goes back to test_ccli afterwards
+  { "",                                       0, "Usage: ./test_ccli [command]",        NULL },
+};
+
+#define INVOKE_CASE_COUNT ((int)(sizeof(invoke_cases) / sizeof(invoke_cases[0])))
+#define INVOKE_ROUNDS 200
+
+// split [line] on spaces, in place. a first word of '@NAME' runs the
+// line as if the program were called NAME.
+static int split_command_line(char *line, char **argv, int max) {
+  int argc = 0;
+  argv[argc++] = "test_ccli";
+  for (char *token = strtok(line, " "); token && argc < max - 1; token = strtok(NULL, " ")) {
+    if (argc == 1 && token[0] == '@') argv[0] = token + 1;
+    else argv[argc++] = token;
+  }
+  argv[argc] = NULL;
+  return argc;
+}
+
+static bool run_invoke_case(ccli *interface, invoke_case *test, bool report) {
+  char line[256], *argv[32];
+  snprintf(line, sizeof(line), "%s", test->command_line);
+  int argc = split_command_line(line, argv, 32);
+
+  ccli_result result;
+  ccli_invoke(interface, argc, argv, &result);
+  bool passed = result.status == test->status && strstr(result.output, test->expected) &&
+                !(test->unexpected && strstr(result.output, test->unexpected));
+  if (!passed && report) {
+    printf("FAIL '%s': status %d (expected %d), output:\n%s\n", test->command_line,
+           result.status, test->status, result.output);
+  }
+
+  ccli_result_free(&result);
+  return passed;
+}
+
+// files the cases below read and write, removed when they're done
+static char scratch_dir[] = "/tmp/ccli_test.XXXXXX";
+
+static void scratch_path(char *path, size_t size, const char *name) {
+  snprintf(path, size, "%s/%s", scratch_dir, name);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+  return remove(path);
+}
+
+static void remove_scratch(void) {
+  nftw(scratch_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// lines of all lengths, some longer than a chunk, and no final newline
+static void write_lines_file(const char *path) {
+  FILE *fp = fopen(path, "w");
+  for (int i = 0; i < 3000; i++) {
+    fprintf(fp, "line %d", i);
+    if (i % 97 == 0) {
+      for (int j = 0; j < 2500; j++) fputc('x', fp);
+    }
+    fputc('\n', fp);
+  }
+  fprintf(fp, "the last line, 7, has no newline");
+  fclose(fp);
+}
+
+// run a command line made from [format], and return a copy of its output
+static char *invoke_output(ccli *interface, const char *format, ...) {
+  char line[256], *argv[32];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  int argc = split_command_line(line, argv, 32);
+
+  ccli_result result;
+  ccli_invoke(interface, argc, argv, &result);
+  char *output = strdup(result.output);
+  ccli_result_free(&result);
+  return output;
+}
+
+// a parallel run, split into many chunks or items, against a serial one.
+// the output has to match byte for byte.
+typedef struct {
+  char *parallel;
+  char *serial;
+} ordering_case;
+
+static ordering_case ordering_cases[] = {
+  { "grep --jobs=4 --chunk-size=1K 7 %s/lines.txt",   "grep --jobs=1 7 %s/lines.txt" },
+  { "grep --jobs=3 --chunk-size=100 x %s/lines.txt",  "grep --jobs=1 x %s/lines.txt" },
+  { "squares --jobs=4 3000",                          "squares --jobs=1 3000" },
+  { "squares --jobs=7 --ccli-output=csv 1001",        "squares --jobs=1 --ccli-output=csv 1001" },
+};
+
+#define ORDERING_CASE_COUNT ((int)(sizeof(ordering_cases) / sizeof(ordering_cases[0])))
+
+// start ./test_ccli with [argv], its stdout and stderr going to the pipe
+// returned in [output]
+static pid_t spawn_test_ccli(char **argv, int *output) {
+  int fds[2];
+  if (pipe(fds) != 0) return -1;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv("./test_ccli", argv);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  *output = fds[0];
+  return pid;
+}
+
+// run ./test_ccli with a command line made from [format] until it exits,
+// and return everything it printed, logs included
+static char *run_test_ccli(const char *format, ...) {
+  char line[256], *argv[32];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  split_command_line(line, argv, 32);
+
+  int fd;
+  pid_t pid = spawn_test_ccli(argv, &fd);
+  if (pid < 0) return strdup("");
+
+  size_t size = 0, capacity = 4096;
+  char *output = malloc(capacity);
+  ssize_t length;
+  while ((length = read(fd, output + size, capacity - size - 1)) > 0) {
+    size += length;
+    if (capacity - size < 1024) output = realloc(output, capacity *= 2);
+  }
+  output[size] = '\0';
+  close(fd);
+  waitpid(pid, NULL, 0);
+  return output;
+}
+
+// logs go to stderr, and a test run fixes their level, so these run in a
+// child process
+static invoke_case log_cases[] = {
+  { "hello true",                0, "test_arg: true",      "saying hello" },
+  { "hello -v true",             0, "INFO  saying hello",  NULL },
+  { "hello -v -q true",          0, "test_arg: true",      "saying hello" },
+  { "grep -v x %s/lines.txt",    0, "line 0",              "DEBUG" },
+  { "grep -vv x %s/lines.txt",   0, "DEBUG searching",     NULL },
+  { "grep -vv -q x %s/lines.txt", 0, "line 0",             "DEBUG" },
+};
+
+#define LOG_CASE_COUNT ((int)(sizeof(log_cases) / sizeof(log_cases[0])))
+
+// just enough of a json parser to tell whether [json] is well formed.
+// returns the end of the value at [json], or NULL.
+static const char *skip_json(const char *json) {
+  json += strspn(json, " \t\r\n");
+  if (*json == '{' || *json == '[') {
+    char close = (*json == '{') ? '}' : ']';
+    json += strspn(json + 1, " \t\r\n") + 1;
+    if (*json == close) return json + 1;
+
+    for (;;) {
+      if (close == '}') {
+        json = skip_json(json);
+        if (!json || *(json += strspn(json, " \t\r\n")) != ':') return NULL;
+        json++;
+      }
+      json = skip_json(json);
+      if (!json) return NULL;
+      json += strspn(json, " \t\r\n");
+      if (*json == close) return json + 1;
+      if (*json++ != ',') return NULL;
+    }
+  } else if (*json == '"') {
+    for (json++; *json != '"'; json++) {
+      if (*json == '\0' || (unsigned char)*json < 0x20) return NULL;
+      if (*json == '\\' && *++json == '\0') return NULL;
+    }
+    return json + 1;
+  } else if (!strncmp(json, "true", 4) || !strncmp(json, "null", 4)) {
+    return json + 4;
+  } else if (!strncmp(json, "false", 5)) {
+    return json + 5;
+  }
+
+  char *end;
+  strtod(json, &end);
+  return (end == json) ? NULL : end;
+}
+
+static int count_string(const char *haystack, const char *needle) {
+  int count = 0;
+  for (const char *at = haystack; (at = strstr(at, needle)); at++) count++;
+  return count;
+}
+
+// read from [fd] into [output] until [needle] shows up, giving up after
+// [timeout_ms] without any output
+static bool read_until(int fd, char *output, size_t size, size_t *length, const char *needle, int timeout_ms) {
+  while (!strstr(output, needle)) {
+    struct pollfd poll_fd = { fd, POLLIN, 0 };
+    if (poll(&poll_fd, 1, timeout_ms) <= 0 || *length + 1 >= size) return false;
+
+    ssize_t result = read(fd, output + *length, size - *length - 1);
+    if (result <= 0) return false;
+    *length += result;
+    output[*length] = '\0';
+  }
+  return true;
+}
+
+// under --ccli-watch, changing the file has to run the command again,
+// with the new contents and the changed path
+static int run_watch_case(void) {
+  char path[128], line[256], *argv[32];
+  scratch_path(path, sizeof(path), "watched.txt");
+  FILE *fp = fopen(path, "w");
+  fprintf(fp, "one\ntwo\n");
+  fclose(fp);
+
+  snprintf(line, sizeof(line), "lines --ccli-watch=20 %s", path);
+  split_command_line(line, argv, 32);
+  int fd;
+  pid_t pid = spawn_test_ccli(argv, &fd);
+
+  char output[4096] = "";
+  size_t length = 0;
+  char first[192], changed[300];
+  snprintf(first, sizeof(first), "%s: 2 lines", path);
+  snprintf(changed, sizeof(changed), "changed: %s\n%s: 3 lines", path, path);
+
+  const char *problem = NULL;
+  if (pid < 0 || !read_until(fd, output, sizeof(output), &length, first, 5000)) {
+    problem = "didn't run the first time";
+  } else {
+    fp = fopen(path, "a");
+    fprintf(fp, "three\n");
+    fclose(fp);
+    if (!read_until(fd, output, sizeof(output), &length, changed, 5000)) problem = "didn't run again on a change";
+  }
+
+  if (pid > 0) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(fd);
+  }
+  if (problem) printf("FAIL the watched command %s, output:\n%s\n", problem, output);
+  printf("%d/1 watch cases passed\n", problem ? 0 : 1);
+  return problem ? 1 : 0;
+}
+
+static bool expect_output(ccli *interface, const char *expected, const char *command_line, const char *path) {
+  char *output = invoke_output(interface, command_line, path);
+  bool passed = strstr(output, expected) != NULL;
+  if (!passed) printf("FAIL '%s' on %s, expected '%s', output:\n%s\n", command_line, path, expected, output);
+  free(output);
+  return passed;
+}
+
+// the number of entries in a cache directory, and the size of the last
+static int cache_entries(const char *path, off_t *size) {
+  DIR *dir = opendir(path);
+  if (!dir) return 0;
+
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    struct stat st;
+    if (entry->d_name[0] == '.' || fstatat(dirfd(dir), entry->d_name, &st, 0) < 0) continue;
+    *size = st.st_size;
+    count++;
+  }
+  closedir(dir);
+  return count;
+}
+
+// a cached result is replayed until the file's mtime changes, and the
+// least recently used entries go once the cache is over its bound.
+// checksum's run count shows whether the callback really ran.
+static int run_cache_cases(ccli *interface) {
+  char cache[128], evict[128], a[128], b[128];
+  scratch_path(cache, sizeof(cache), "cache");
+  scratch_path(evict, sizeof(evict), "evict");
+  scratch_path(a, sizeof(a), "a.txt");
+  scratch_path(b, sizeof(b), "b.txt");
+  FILE *fp = fopen(a, "w");
+  fprintf(fp, "alpha\n");
+  fclose(fp);
+  fp = fopen(b, "w");
+  fprintf(fp, "bravo\n");
+  fclose(fp);
+
+  int failed = 0, cases = 0;
+  failed += !expect_output(interface, "(run 1)", "checksum %s", a); cases++;
+  failed += !expect_output(interface, "(run 1)", "checksum %s", a); cases++;
+
+  // same contents, older mtime: a new key
+  struct timespec times[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+  utimensat(AT_FDCWD, a, times, 0);
+  failed += !expect_output(interface, "(run 2)", "checksum %s", a); cases++;
+  failed += !expect_output(interface, "(run 2)", "checksum %s", a); cases++;
+
+  // room for one entry and a half: storing a second drops the first
+  off_t entry_size = 0;
+  ccli_set_cache(interface, evict, 0);
+  failed += !expect_output(interface, "(run 3)", "checksum %s", b); cases++;
+  cache_entries(evict, &entry_size);
+  ccli_set_cache(interface, evict, entry_size * 3 / 2);
+  // file times move in clock ticks, so one passes between uses, or the
+  // least recently used entry could be either
+  usleep(20000);
+  failed += !expect_output(interface, "(run 4)", "checksum %s", a); cases++;
+  failed += !expect_output(interface, "(run 4)", "checksum %s", a); cases++;
+  usleep(20000);
+  failed += !expect_output(interface, "(run 5)", "checksum %s", b); cases++;
+  failed += !expect_output(interface, "(run 5)", "checksum %s", b); cases++;
+
+  off_t size;
+  cases++;
+  if (cache_entries(evict, &size) != 1) {
+    printf("FAIL the cache kept %d entries, with room for one\n", cache_entries(evict, &size));
+    failed++;
+  }
+
+  ccli_set_cache(interface, cache, 0);
+  printf("%d/%d cache cases passed\n", cases - failed, cases);
+  return failed;
+}
+
+// a traced parallel run has to write well formed json, with every span
+// closed, ccli's own phases, and one span per item from the workers
+static int run_trace_case(void) {
+  char path[128];
+  scratch_path(path, sizeof(path), "trace.json");
+  free(run_test_ccli("squares --jobs=4 --ccli-trace=%s 64", path));
+
+  FILE *fp = fopen(path, "r");
+  char *json = calloc(1, 1 << 20);
+  if (fp) {
+    fread(json, 1, (1 << 20) - 1, fp);
+    fclose(fp);
+  }
+
+  const char *end = skip_json(json);
+  const char *problem = NULL;
+  if (!end || end[strspn(end, " \t\r\n")] != '\0') problem = "isn't well formed json";
+  else if (!strstr(json, "\"traceEvents\":[")) problem = "has no traceEvents";
+  else if (count_string(json, "\"ph\":\"B\"") != count_string(json, "\"ph\":\"E\"")) problem = "has unclosed spans";
+  else if (count_string(json, "\"name\":\"square\"") != 64) problem = "doesn't have a span per item";
+  else if (!strstr(json, "\"name\":\"dispatch\"") || !strstr(json, "\"name\":\"callback\"")) problem = "is missing ccli's phases";
+  else if (count_string(json, "\"name\":\"thread_name\"") < 2) problem = "has no worker threads";
+
+  free(json);
+  if (problem) printf("FAIL the trace %s\n", problem);
+  printf("%d/1 trace cases passed\n", problem ? 0 : 1);
+  return problem ? 1 : 0;
+}
+
+static int run_log_cases(void) {
+  int failed = 0;
+  for (int i = 0; i < LOG_CASE_COUNT; i++) {
+    invoke_case *test = &log_cases[i];
+    char *output = run_test_ccli(test->command_line, scratch_dir);
+    if (!strstr(output, test->expected) || (test->unexpected && strstr(output, test->unexpected))) {
+      printf("FAIL '%s', output:\n%.2000s\n", test->command_line, output);
+      failed++;
+    }
+    free(output);
+  }
+
+  printf("%d/%d log cases passed\n", LOG_CASE_COUNT - failed, LOG_CASE_COUNT);
+  return failed;
+}
+
+static int run_ordering_cases(ccli *interface) {
+  char path[128];
+  scratch_path(path, sizeof(path), "lines.txt");
+  write_lines_file(path);
+
+  int failed = 0;
+  for (int i = 0; i < ORDERING_CASE_COUNT; i++) {
+    ordering_case *test = &ordering_cases[i];
+    char *parallel = invoke_output(interface, test->parallel, scratch_dir);
+    char *serial = invoke_output(interface, test->serial, scratch_dir);
+    // an empty run would match trivially
+    if (strcmp(parallel, serial) || strlen(serial) < 1000) {
+      printf("FAIL '%s' printed %zu bytes, '%s' printed %zu\n", test->parallel, strlen(parallel),
+             test->serial, strlen(serial));
+      failed++;
+    }
+    free(parallel);
+    free(serial);
+  }
+
+  printf("%d/%d ordering cases passed\n", ORDERING_CASE_COUNT - failed, ORDERING_CASE_COUNT);
+  return failed;
+}
+
+static int run_invoke_tests(ccli *interface) {
+  // -v would otherwise log every hello to stderr
+  ccli_log_set_level(interface, CCLI_LOG_ERROR);
+  int failed = 0;
+
+  // cached results go here rather than in ~/.cache
+  if (!mkdtemp(scratch_dir)) {
+    printf("FAIL can't make a scratch directory\n");
+    return 1;
+  }
+  char cache[128];
+  scratch_path(cache, sizeof(cache), "cache");
+  ccli_set_cache(interface, cache, 0);
+
+  // listed from its manifest, but not loaded until one of its commands runs
+  void *plugin = dlopen("plugins/test_plugin.so", RTLD_NOW | RTLD_NOLOAD);
+  if (plugin) {
+    printf("FAIL test_plugin.so was loaded before any of its commands ran\n");
+    dlclose(plugin);
+    failed++;
+  }
+
+  for (int i = 0; i < INVOKE_CASE_COUNT; i++) {
+    if (!run_invoke_case(interface, &invoke_cases[i], true)) failed++;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < INVOKE_ROUNDS; round++) {
+    for (int i = 0; i < INVOKE_CASE_COUNT; i++) run_invoke_case(interface, &invoke_cases[i], false);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d/%d invoke cases passed, %.0f cases/s\n", INVOKE_CASE_COUNT - failed, INVOKE_CASE_COUNT,
+         INVOKE_ROUNDS * INVOKE_CASE_COUNT / seconds);
+
+  failed += run_ordering_cases(interface);
+  failed += run_log_cases();
+  failed += run_trace_case();
+  failed += run_watch_case();
+  failed += run_cache_cases(interface);
+  remove_scratch();
+  return failed ? 1 : 0;
+}
+
+// counts the blocks ccli holds, to check everything is handed back.
+// worker threads allocate too, so the count is atomic.
+static void *counting_malloc(void *context, size_t size) {
+  atomic_fetch_add((_Atomic long *)context, 1);
+  return malloc(size);
+}
+
+static void *counting_realloc(void *context, void *pointer, size_t size) {
+  return realloc(pointer, size);
+}
+
+static void counting_free(void *context, void *pointer) {
+  atomic_fetch_sub((_Atomic long *)context, 1);
+  free(pointer);
+}
+
+static _Atomic long outstanding_blocks = 0;
+
+static int check_memory_returned(void) {
+  static const char *categories[] = { "schema", "keys", "parse", "output", "other" };
+  ccli_memory_usage usage[CCLI_MEMORY_CATEGORIES];
+  ccli_memory_stats(usage);
+
+  size_t live = 0;
+  for (int i = 0; i < CCLI_MEMORY_CATEGORIES; i++) {
+    printf("%-7s %8zu bytes peak, %8llu allocations\n", categories[i], usage[i].peak_bytes,
+           (unsigned long long)usage[i].allocations);
+    live += usage[i].live_bytes;
+  }
+
+  if (live == 0 && outstanding_blocks == 0) return 0;
+  printf("FAIL %zu bytes in %ld blocks still allocated\n", live, atomic_load(&outstanding_blocks));
+  return 1;
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifdef CCLI_INVOKE_TESTS
+  ccli_set_allocator(counting_malloc, counting_realloc, counting_free, &outstanding_blocks);
+#endif
+  ccli *interface = ccli_init("test_ccli", argc, argv);
+  ccli_set_description(interface, "Some description for a command line interface.");
+
+  hello_command(interface);
+  goodbye_command(interface);
+  ship_command(interface);
+  lines_command(interface);
+  grep_command(interface);
+  squares_command(interface);
+  powers_command(interface);
+  checksum_command(interface);
+  repl_command(interface);
+  nest_command(interface);
+  ccli_add_plugin_dir(interface, "plugins");
+  ccli_set_multi_call(interface, true);
+
+#ifdef CCLI_INVOKE_TESTS
+  int status = run_invoke_tests(interface);
+  ccli_free(interface);
+  return status | check_memory_returned();
+#else
+  ccli_run(interface);
+
+  ccli_free(interface);
+
+  return 0;
+#endif
+}
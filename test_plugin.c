@@ -0,0 +1,43 @@
+// a plugin for test_ccli, built into plugins/ by the Makefile.
+//
+// test_ccli lists these commands from the manifest below, and only
+// loads this file when one of them is run.
+#include <ctype.h>
+#include <string.h>
+
+#include "ccli.h"
+
+CCLI_PLUGIN_COMMAND("shout", "Repeat a word, loudly (from a plugin).");
+CCLI_PLUGIN_COMMAND("whisper", "Repeat a word, quietly (from a plugin).");
+
+static void say(ccli *interface, bool loud) {
+  char *word = ccli_get_string_arg(interface, 0);
+  int times = 1;
+  ccli_get_int_option(interface, "--times", &times);
+
+  char said[256];
+  size_t length = strlen(word) < sizeof(said) - 1 ? strlen(word) : sizeof(said) - 1;
+  for (size_t i = 0; i < length; i++) said[i] = loud ? toupper((unsigned char)word[i]) : tolower((unsigned char)word[i]);
+  said[length] = '\0';
+
+  for (int i = 0; i < times; i++) ccli_echo(interface, "%s%s", said, loud ? "!" : "...");
+}
+
+static void shout_callback(ccli *interface) {
+  say(interface, true);
+}
+
+static void whisper_callback(ccli *interface) {
+  say(interface, false);
+}
+
+void ccli_plugin_register(ccli *interface) {
+  ccli_command *shout = ccli_add_command(interface, "shout", shout_callback);
+  ccli_option *times = ccli_add_number_option(interface, shout, "--times", "-n");
+  ccli_option_set_description(times, "how many times to say it");
+  ccli_command_add_string_arg(shout, "word");
+
+  ccli_command *whisper = ccli_add_command(interface, "whisper", whisper_callback);
+  ccli_add_number_option(interface, whisper, "--times", "-n");
+  ccli_command_add_string_arg(whisper, "word");
+}